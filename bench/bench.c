@@ -0,0 +1,597 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Microbenchmark of libbase32
+ *
+ * Calls the encode and decode functions directly, without Lua, over a sweep
+ * of input sizes, and prints the results as JSON on the standard output.
+ *
+ *   bench [--min-size=N] [--max-size=N] [--engine=NAME[,NAME...]]
+ *         [--format=rfc|crockford] [--threads=N] [--time=MS] [--repeat=N]
+ */
+
+#include "base32.h"
+// include system headers
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+// Number of items of a batch for the "many" engine
+#define MANY_ITEMS   64
+// Largest input of the "many" engine
+#define MANY_MAXSIZE (64 * 1024)
+// Chunk size of the "incremental" engine
+#define INCR_CHUNK   (64 * 1024)
+
+typedef struct {
+    int decode;
+    int fmt;
+    // input and output of a single call
+    const char *src;
+    size_t srclen;
+    char *dst;
+    size_t dstlen;
+    // MANY_ITEMS copies for the "many" engine
+    b32_item_t items[MANY_ITEMS];
+} bench_case_t;
+
+typedef struct {
+    const char *name;
+    // largest input the engine is measured with, or 0 for no limit
+    size_t maxsize;
+    // number of conversions per call
+    size_t nconv;
+    // 1 if the engine uses the worker threads
+    int threads;
+    void (*run)(bench_case_t *c);
+} engine_t;
+
+static void run_memcpy(bench_case_t *c)
+{
+    memcpy(c->dst, c->src, c->srclen);
+}
+
+static void run_flags(bench_case_t *c, int flags)
+{
+    if (c->decode) {
+        b32_decode(c->dst, c->dstlen, c->src, c->srclen, c->fmt, flags, NULL);
+    } else {
+        b32_encode(c->dst, c->dstlen, c->src, c->srclen, c->fmt, flags);
+    }
+}
+
+static void run_serial(bench_case_t *c)
+{
+    run_flags(c, B32_NOTHREADS);
+}
+
+static void run_scalar(bench_case_t *c)
+{
+    run_flags(c, B32_NOTHREADS | B32_SCALAR);
+}
+
+static void run_block(bench_case_t *c)
+{
+    run_flags(c, B32_NOTHREADS | B32_BLOCK);
+}
+
+static void run_nontemporal(bench_case_t *c)
+{
+    run_flags(c, B32_NOTHREADS | B32_NONTEMPORAL);
+}
+
+static void run_threads(bench_case_t *c)
+{
+    run_flags(c, 0);
+}
+
+static void run_incremental(bench_case_t *c)
+{
+    char *dst = c->dst;
+
+    if (c->decode) {
+        b32_decoder_t dec;
+        b32_decoder_init(&dec, c->fmt);
+        for (size_t i = 0; i < c->srclen; i += INCR_CHUNK) {
+            size_t n = c->srclen - i < INCR_CHUNK ? c->srclen - i : INCR_CHUNK;
+            size_t m = b32_decoder_outlen(&dec, n);
+            ptrdiff_t rv =
+                b32_decoder_update(&dec, dst, m, c->src + i, n, NULL);
+            if (rv < 0) {
+                return;
+            }
+            dst += rv;
+        }
+        b32_decoder_final(&dec, dst, 8);
+    } else {
+        b32_encoder_t enc;
+        b32_encoder_init(&enc, c->fmt);
+        for (size_t i = 0; i < c->srclen; i += INCR_CHUNK) {
+            size_t n = c->srclen - i < INCR_CHUNK ? c->srclen - i : INCR_CHUNK;
+            dst += b32_encoder_update(&enc, dst, b32_encoder_outlen(&enc, n),
+                                      c->src + i, n);
+        }
+        b32_encoder_final(&enc, dst, 8);
+    }
+}
+
+static void run_many(bench_case_t *c)
+{
+    if (c->decode) {
+        b32_decode_many(c->items, MANY_ITEMS, c->fmt, B32_NOTHREADS);
+    } else {
+        b32_encode_many(c->items, MANY_ITEMS, c->fmt, B32_NOTHREADS);
+    }
+}
+
+static const engine_t Engines[] = {
+    {"serial",      0,            1,          0, run_serial     },
+    {"scalar",      0,            1,          0, run_scalar     },
+    {"block",       0,            1,          0, run_block      },
+    {"nontemporal", 0,            1,          0, run_nontemporal},
+    {"threads",     0,            1,          1, run_threads    },
+    {"incremental", 0,            1,          0, run_incremental},
+    {"many",        MANY_MAXSIZE, MANY_ITEMS, 0, run_many       },
+};
+
+/*
+ * Clocks
+ */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// file descriptor of the cycle counter of the calling thread, or -1
+static int PerfFd              = -1;
+static const char *CycleSource = "none";
+
+static void cycles_init(void)
+{
+#if defined(__linux__) && defined(__NR_perf_event_open)
+    struct perf_event_attr attr = {0};
+
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    // fails with EACCES if kernel.perf_event_paranoid forbids it, or with
+    // ENOENT in virtual machines without a PMU
+    PerfFd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (PerfFd != -1) {
+        CycleSource = "perf";
+        return;
+    }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    // reference cycles at the nominal frequency of the processor
+    CycleSource = "rdtsc";
+#endif
+}
+
+static uint64_t cycles_now(void)
+{
+    if (PerfFd != -1) {
+        uint64_t v = 0;
+        if (read(PerfFd, &v, sizeof(v)) == (ssize_t)sizeof(v)) {
+            return v;
+        }
+        return 0;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Measurement
+ */
+
+// Maximum number of repetitions of a measurement
+#define MAX_REPEAT 99
+
+typedef struct {
+    uint64_t ncalls;
+    uint64_t ns;
+    uint64_t cycles;
+} sample_t;
+
+typedef struct {
+    size_t n;
+    sample_t v[MAX_REPEAT];
+} samples_t;
+
+static sample_t sample(void (*run)(bench_case_t *c), bench_case_t *c,
+                       uint64_t n)
+{
+    sample_t s  = {.ncalls = n};
+    uint64_t t0 = now_ns();
+    uint64_t c0 = cycles_now();
+
+    for (uint64_t i = 0; i < n; i++) {
+        run(c);
+    }
+    s.cycles = cycles_now() - c0;
+    s.ns     = now_ns() - t0;
+    return s;
+}
+
+/**
+ * @brief Measure `nrepeat` times the time of calling `run` repeatedly for at
+ * least `mintime` nanoseconds.
+ *
+ * The number of calls is doubled until the total time exceeds `mintime`,
+ * so the clock is read only twice per round; the other repetitions make the
+ * same number of calls.
+ */
+static void measure(samples_t *s, void (*run)(bench_case_t *c),
+                    bench_case_t *c, uint64_t mintime, size_t nrepeat)
+{
+    // warm up the caches, the branch predictors and the thread pool
+    run(c);
+    s->n = 1;
+    for (uint64_t n = 1;; n *= 2) {
+        s->v[0] = sample(run, c, n);
+        if (s->v[0].ns >= mintime) {
+            break;
+        }
+    }
+    for (; s->n < nrepeat; s->n++) {
+        s->v[s->n] = sample(run, c, s->v[0].ncalls);
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sort `v` and return its median.
+static double median(double *v, size_t n)
+{
+    qsort(v, n, sizeof(*v), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static int Nresults = 0;
+
+/**
+ * @brief Print the medians of the samples of a measurement as a JSON object,
+ * with the median absolute deviation of the throughput.
+ *
+ * @param size Length of the data before encoding
+ * @param inlen Length of the input of a conversion; throughput is computed
+ *              from it
+ * @param nconv Number of conversions per call of the engine
+ */
+static void report(const char *op, const char *fmt, const char *engine,
+                   const char *input, size_t size, size_t inlen, size_t nconv,
+                   const samples_t *s)
+{
+    double nc = (double)nconv * (double)s->v[0].ncalls;
+    double ns[MAX_REPEAT];
+    double gbps[MAX_REPEAT];
+    double cpb[MAX_REPEAT];
+    double med = 0;
+
+    for (size_t i = 0; i < s->n; i++) {
+        double t = s->v[i].ns ? (double)s->v[i].ns : 1;
+        ns[i]    = t / nc;
+        gbps[i]  = (double)inlen * nc / t;
+        cpb[i]   = inlen ? (double)s->v[i].cycles / ((double)inlen * nc) : 0;
+    }
+    med = median(gbps, s->n);
+
+    printf("%s\n    {\"op\": \"%s\", \"format\": \"%s\", \"engine\": \"%s\", "
+           "\"input\": \"%s\", \"size\": %zu, \"calls\": %.0f, "
+           "\"repeat\": %zu, \"ns_per_call\": %.2f, \"gb_per_s\": %.4f, ",
+           Nresults++ ? "," : "", op, fmt, engine, input, size, nc, s->n,
+           median(ns, s->n), med);
+    for (size_t i = 0; i < s->n; i++) {
+        gbps[i] = gbps[i] > med ? gbps[i] - med : med - gbps[i];
+    }
+    printf("\"gb_per_s_mad\": %.4f, ", median(gbps, s->n));
+    if (strcmp(CycleSource, "none") != 0 && inlen > 0) {
+        printf("\"cycles_per_byte\": %.4f}", median(cpb, s->n));
+    } else {
+        printf("\"cycles_per_byte\": null}");
+    }
+    fflush(stdout);
+}
+
+/*
+ * Options
+ */
+
+typedef struct {
+    size_t minsize;
+    size_t maxsize;
+    const char *engines;
+    int fmts[2];
+    int nfmts;
+    int nthreads;
+    uint64_t mintime;
+    size_t nrepeat;
+} options_t;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: bench [--min-size=N] [--max-size=N] "
+            "[--engine=NAME[,NAME...]]\n"
+            "             [--format=rfc|crockford] [--threads=N] "
+            "[--time=MS] [--repeat=N]\n");
+    exit(EXIT_FAILURE);
+}
+
+static size_t optsize(const char *arg)
+{
+    char *end            = NULL;
+    unsigned long long v = strtoull(arg, &end, 10);
+
+    if (end == arg || v == 0) {
+        usage();
+    }
+    switch (*end) {
+    case 'K':
+    case 'k':
+        v <<= 10;
+        end++;
+        break;
+    case 'M':
+    case 'm':
+        v <<= 20;
+        end++;
+        break;
+    }
+    if (*end) {
+        usage();
+    }
+    return (size_t)v;
+}
+
+static int selected(const options_t *o, const char *name)
+{
+    size_t len = strlen(name);
+
+    if (!o->engines) {
+        return 1;
+    }
+    for (const char *p = o->engines; *p;) {
+        const char *end = strchr(p, ',');
+        size_t n        = end ? (size_t)(end - p) : strlen(p);
+        if (n == len && strncmp(p, name, n) == 0) {
+            return 1;
+        }
+        p += n + (end != NULL);
+    }
+    return 0;
+}
+
+static void parse_options(options_t *o, int argc, char *argv[])
+{
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    *o = (options_t){
+        .minsize  = 1,
+        .maxsize  = 256 * 1024 * 1024,
+        .fmts     = {B32_RFC, B32_CROCKFORD},
+        .nfmts    = 2,
+        .nthreads = ncpu > 1 ? (int)ncpu : 1,
+        .mintime  = 100 * 1000000u,
+        .nrepeat  = 1,
+    };
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (strncmp(a, "--min-size=", 11) == 0) {
+            o->minsize = optsize(a + 11);
+        } else if (strncmp(a, "--max-size=", 11) == 0) {
+            o->maxsize = optsize(a + 11);
+        } else if (strncmp(a, "--engine=", 9) == 0) {
+            o->engines = a + 9;
+        } else if (strcmp(a, "--format=rfc") == 0) {
+            o->fmts[0] = B32_RFC;
+            o->nfmts   = 1;
+        } else if (strcmp(a, "--format=crockford") == 0) {
+            o->fmts[0] = B32_CROCKFORD;
+            o->nfmts   = 1;
+        } else if (strncmp(a, "--threads=", 10) == 0) {
+            o->nthreads = atoi(a + 10);
+            if (o->nthreads < 1 || o->nthreads > B32_MAX_THREADS) {
+                usage();
+            }
+        } else if (strncmp(a, "--time=", 7) == 0) {
+            o->mintime = (uint64_t)optsize(a + 7) * 1000000u;
+        } else if (strncmp(a, "--repeat=", 9) == 0) {
+            o->nrepeat = optsize(a + 9);
+            if (o->nrepeat > MAX_REPEAT) {
+                usage();
+            }
+        } else {
+            usage();
+        }
+    }
+}
+
+/*
+ * Cases
+ */
+
+/**
+ * @brief Point the items of a "many" batch at the input of `c` and at
+ * consecutive output buffers.
+ */
+static void set_items(bench_case_t *c)
+{
+    for (size_t i = 0; i < MANY_ITEMS; i++) {
+        c->items[i] = (b32_item_t){
+            .src    = c->src,
+            .srclen = c->srclen,
+            .dst    = c->dst + i * c->dstlen,
+            .dstlen = c->dstlen,
+        };
+    }
+}
+
+static void bench_engine(const options_t *o, const engine_t *eng, int fmt,
+                         size_t size, const char *data, char *enc, char *out)
+{
+    const char *name = fmt == B32_RFC ? "rfc" : "crockford";
+    size_t enclen    = b32_encoded_len(size, fmt);
+    bench_case_t c   = {.fmt = fmt};
+    samples_t smp    = {0};
+    char saved       = 0;
+
+    if (eng->threads) {
+        b32_set_threads(o->nthreads, 0);
+    }
+
+    c.src    = data;
+    c.srclen = size;
+    c.dst    = out;
+    c.dstlen = enclen;
+    set_items(&c);
+    measure(&smp, eng->run, &c, o->mintime, o->nrepeat);
+    report("encode", name, eng->name, "valid", size, size, eng->nconv, &smp);
+
+    c.decode = 1;
+    c.src    = enc;
+    c.srclen = enclen;
+    c.dstlen = b32_decoded_maxlen(enclen);
+    set_items(&c);
+    measure(&smp, eng->run, &c, o->mintime, o->nrepeat);
+    report("decode", name, eng->name, "valid", size, enclen, eng->nconv, &smp);
+
+    // the conversion stops at an illegal character in the middle
+    saved           = enc[enclen / 2];
+    enc[enclen / 2] = '!';
+    measure(&smp, eng->run, &c, o->mintime, o->nrepeat);
+    report("decode", name, eng->name, "invalid", size, enclen, eng->nconv,
+           &smp);
+    enc[enclen / 2] = saved;
+
+    if (eng->threads) {
+        b32_set_threads(1, B32_PARALLEL_THRESHOLD);
+    }
+}
+
+static void bench_size(const options_t *o, size_t size, const char *data,
+                       char *enc, char *out)
+{
+    if (selected(o, "memcpy")) {
+        bench_case_t c = {.src = data, .srclen = size, .dst = out};
+        samples_t smp  = {0};
+        measure(&smp, run_memcpy, &c, o->mintime, o->nrepeat);
+        report("copy", "none", "memcpy", "valid", size, size, 1, &smp);
+    }
+
+    for (int f = 0; f < o->nfmts; f++) {
+        b32_encode(enc, b32_encoded_len(size, o->fmts[f]), data, size,
+                   o->fmts[f], 0);
+        for (size_t e = 0; e < sizeof(Engines) / sizeof(*Engines); e++) {
+            const engine_t *eng = Engines + e;
+            if (selected(o, eng->name) &&
+                (!eng->maxsize || size <= eng->maxsize) &&
+                (!eng->threads || o->nthreads > 1)) {
+                bench_engine(o, eng, o->fmts[f], size, data, enc, out);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    options_t o;
+    size_t manylen = 0;
+    size_t buflen  = 0;
+    char *data     = NULL;
+    char *enc      = NULL;
+    char *out      = NULL;
+    uint64_t x     = 0x9e3779b97f4a7c15u;
+
+    parse_options(&o, argc, argv);
+    cycles_init();
+
+    // the output buffer also holds the results of a "many" batch
+    manylen = o.maxsize < MANY_MAXSIZE ? o.maxsize : MANY_MAXSIZE;
+    buflen  = b32_encoded_len(o.maxsize, B32_RFC);
+    if (buflen < MANY_ITEMS * b32_encoded_len(manylen, B32_RFC)) {
+        buflen = MANY_ITEMS * b32_encoded_len(manylen, B32_RFC);
+    }
+    data = malloc(o.maxsize);
+    enc  = malloc(buflen);
+    out  = malloc(buflen);
+    if (!data || !enc || !out) {
+        fprintf(stderr, "bench: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    // fill the input with a xorshift sequence; touches every page too
+    for (size_t i = 0; i < o.maxsize; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data[i] = (char)x;
+    }
+    memset(enc, 0, buflen);
+    memset(out, 0, buflen);
+
+    printf("{\n  \"host\": {\"cpus\": %ld, \"threads\": %d, "
+           "\"cycles\": \"%s\", \"many_decode\": \"%s\"},\n"
+           "  \"results\": [",
+           sysconf(_SC_NPROCESSORS_ONLN), o.nthreads, CycleSource,
+           b32_decode_many_kernel());
+    for (size_t size = o.minsize; size <= o.maxsize; size *= 4) {
+        fprintf(stderr, "bench: %zu bytes\n", size);
+        bench_size(&o, size, data, enc, out);
+        if (size > o.maxsize / 4) {
+            break;
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    free(data);
+    free(enc);
+    free(out);
+    return EXIT_SUCCESS;
+}
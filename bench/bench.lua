@@ -0,0 +1,239 @@
+#!/usr/bin/env lua
+--
+-- End-to-end benchmark of the base32 module
+--
+-- Measures base32.encode and base32.decode as Lua code calls them, including
+-- the argument checks, the result strings and the garbage collector, over
+-- distributions of input sizes. The results are printed as JSON.
+--
+-- Each distribution also has a reference result, string.upper over the same
+-- inputs (op "upper", format "none"), that bench/compare.lua uses to compare
+-- runs on different hosts.
+--
+--   lua bench/bench.lua [--time=MS] [--dist=NAME[,NAME...]] [--repeat=N]
+--
+-- Under bench/lua_host, every allocation of the Lua state is counted.
+-- Under a plain interpreter, the allocated bytes are estimated from
+-- collectgarbage("count") and the time is the CPU time of os.clock().
+--
+local base32 = require("base32")
+local host = rawget(_G, "benchhost")
+
+local format = string.format
+local concat = table.concat
+
+-- size distributions: number of inputs and their size range
+local DISTS = {
+    {
+        name = "token",
+        count = 1024,
+        min = 16,
+        max = 64,
+    },
+    {
+        name = "kb",
+        count = 256,
+        min = 1024,
+        max = 16 * 1024,
+    },
+    {
+        name = "mb",
+        count = 8,
+        min = 1024 * 1024,
+        max = 4 * 1024 * 1024,
+    },
+}
+
+-- bytes that may be allocated while the garbage collector is stopped
+local NOGC_LIMIT = 64 * 1024 * 1024
+
+local now = host and host.now or function()
+    return os.clock() * 1e9
+end
+
+local function parse_args(args)
+    local opts = {
+        time = 200,
+        nrepeat = 1,
+    }
+    for _, a in ipairs(args) do
+        local k, v = a:match("^%-%-(%w+)=(.+)$")
+        if k == "time" and tonumber(v) then
+            opts.time = tonumber(v)
+        elseif k == "repeat" and tonumber(v) then
+            opts.nrepeat = tonumber(v)
+        elseif k == "dist" then
+            opts.dist = {}
+            for name in v:gmatch("[^,]+") do
+                opts.dist[name] = true
+            end
+        else
+            error(format("unknown option %q", a), 0)
+        end
+    end
+    return opts
+end
+
+-- build `count` inputs of random sizes from a random block, so that large
+-- inputs are not generated byte by byte
+local function make_inputs(dist)
+    local block = {}
+    for i = 1, 4096 do
+        block[i] = string.char(math.random(0, 255))
+    end
+    block = concat(block)
+
+    local inputs = {}
+    for i = 1, dist.count do
+        local len = math.random(dist.min, dist.max)
+        local off = math.random(1, #block)
+        local s = (block:sub(off) .. block:rep(math.ceil(len / #block)))
+        inputs[i] = s:sub(1, len)
+    end
+    return inputs
+end
+
+local function run(fn, inputs, fmt, ncalls)
+    local n = #inputs
+    for i = 0, ncalls - 1 do
+        fn(inputs[i % n + 1], fmt)
+    end
+end
+
+-- bytes allocated so far, and the number of allocations if they are counted
+local function allocated()
+    if host and host.allocs then
+        local nallocs, nbytes = host.allocs()
+        return nbytes, nallocs
+    end
+    return collectgarbage("count") * 1024
+end
+
+-- return the number of calls that take at least `mintime` nanoseconds
+local function calibrate(fn, inputs, fmt, mintime)
+    local ncalls = 1
+    while true do
+        local t = now()
+        run(fn, inputs, fmt, ncalls)
+        if now() - t >= mintime then
+            return ncalls
+        end
+        ncalls = ncalls * 2
+    end
+end
+
+-- sort `v` and return its median
+local function median(v)
+    table.sort(v)
+    local n = #v
+    if n % 2 == 1 then
+        return v[(n + 1) / 2]
+    end
+    return (v[n / 2] + v[n / 2 + 1]) / 2
+end
+
+local function measure(fn, inputs, fmt, outlen, mintime, nrepeat)
+    local ncalls = calibrate(fn, inputs, fmt, mintime)
+    local res = {
+        calls = ncalls,
+    }
+
+    -- with the garbage collector running as usual
+    local rates = {}
+    for i = 1, nrepeat do
+        collectgarbage("collect")
+        local t = now()
+        run(fn, inputs, fmt, ncalls)
+        rates[i] = ncalls * 1e9 / (now() - t)
+    end
+    res.calls_per_sec = median(rates)
+    res.ns_per_call = 1e9 / res.calls_per_sec
+    for i, r in ipairs(rates) do
+        rates[i] = math.abs(r - res.calls_per_sec)
+    end
+    res.calls_per_sec_mad = median(rates)
+
+    -- without the garbage collector, for the allocations and the time spent
+    -- outside of it; the number of calls is limited to bound the memory
+    local nogc = math.max(1, math.min(ncalls, math.floor(NOGC_LIMIT / outlen)))
+    collectgarbage("collect")
+    collectgarbage("stop")
+    local b, a = allocated()
+    local t = now()
+    run(fn, inputs, fmt, nogc)
+    t = now() - t
+    local b2, a2 = allocated()
+    collectgarbage("restart")
+
+    res.bytes_per_call = (b2 - b) / nogc
+    res.allocs_per_call = a and (a2 - a) / nogc
+    res.gc_ns_per_call = math.max(0, res.ns_per_call - t / nogc)
+    return res
+end
+
+local function json_number(v)
+    if v == nil then
+        return "null"
+    end
+    return format("%.2f", v)
+end
+
+local function json_result(op, fmt, dist, r)
+    return format('    {"op": "%s", "format": "%s", "dist": "%s", ' ..
+                      '"calls": %d, "ns_per_call": %s, "calls_per_sec": %s, ' ..
+                      '"calls_per_sec_mad": %s, "bytes_per_call": %s, ' ..
+                      '"allocs_per_call": %s, "gc_ns_per_call": %s}', op, fmt,
+                  dist, r.calls, json_number(r.ns_per_call),
+                  json_number(r.calls_per_sec),
+                  json_number(r.calls_per_sec_mad),
+                  json_number(r.bytes_per_call),
+                  json_number(r.allocs_per_call),
+                  json_number(r.gc_ns_per_call))
+end
+
+local opts = parse_args(arg or {})
+local results = {}
+
+math.randomseed(1)
+for _, dist in ipairs(DISTS) do
+    if not opts.dist or opts.dist[dist.name] then
+        local inputs = make_inputs(dist)
+        local total = 0
+        for _, s in ipairs(inputs) do
+            total = total + #s
+        end
+        io.stderr:write(format("bench.lua: %s\n", dist.name))
+
+        -- reference: a pass over the same bytes into a new string
+        local r = measure(string.upper, inputs, nil, total / #inputs,
+                          opts.time * 1e6, opts.nrepeat)
+        results[#results + 1] = json_result("upper", "none", dist.name, r)
+
+        for _, fmt in ipairs({
+            "rfc",
+            "crockford",
+        }) do
+            local encoded = {}
+            for i, s in ipairs(inputs) do
+                encoded[i] = base32.encode(s, fmt)
+            end
+            for _, op in ipairs({
+                "encode",
+                "decode",
+            }) do
+                local list = op == "encode" and inputs or encoded
+                -- average length of the results of a call
+                local outlen = (op == "encode" and total * 1.6 or total) /
+                                   #inputs
+                local r = measure(base32[op], list, fmt, outlen,
+                                  opts.time * 1e6, opts.nrepeat)
+                results[#results + 1] = json_result(op, fmt, dist.name, r)
+            end
+        end
+    end
+end
+
+print(format('{\n  "host": {"lua": "%s", "jit": %s, "allocs": "%s"},',
+             _VERSION, rawget(_G, "jit") and "true" or "false",
+             host and host.allocs and "counted" or "estimated"))
+print('  "results": [\n' .. concat(results, ",\n") .. "\n  ]\n}")
@@ -0,0 +1,178 @@
+#!/usr/bin/env lua
+--
+-- Compare benchmark results against a baseline
+--
+--   lua bench/compare.lua BASELINE CURRENT [TOLERANCE]
+--
+-- Reads the JSON output of bench/bench or bench/bench.lua. The results are
+-- matched by their string fields and their size. The throughputs are divided
+-- by a factor of their run, the geometric mean of its reference results, the
+-- memcpy rows of bench/bench and the string.upper rows of bench/bench.lua
+-- (format "none"), over the references that both files have, so that a
+-- baseline recorded on one host can be compared with a run on another. A
+-- result regresses if this relative throughput is lower than in the baseline
+-- by more than TOLERANCE percent (default 10), and by more than three times
+-- the sum of the median absolute deviations of both, so that noisy results
+-- do not fail the comparison. A result of the baseline that is missing from
+-- the current run is reported as missing. Exits with status 1 if any result
+-- regresses or is missing. A warning is printed if the host fields of both
+-- files differ, since the kernels or the Lua version may not be the same.
+--
+local format = string.format
+
+-- throughput fields, in order of preference
+local METRICS = {
+    "gb_per_s",
+    "calls_per_sec",
+}
+
+-- return the key, the throughput and its deviation of a result line, and
+-- whether it is a reference
+local function parse_result(line)
+    local parts = {}
+    for k, v in line:gmatch('"([%w_]+)": "([^"]*)"') do
+        parts[#parts + 1] = k .. "=" .. v
+    end
+    local size = line:match('"size": (%d+)')
+    if #parts == 0 then
+        return nil
+    elseif size then
+        parts[#parts + 1] = "size=" .. size
+    end
+    local isref = line:match('"format": "none"') ~= nil
+
+    for _, m in ipairs(METRICS) do
+        local v = tonumber(line:match('"' .. m .. '": ([%d%.eE+-]+)'))
+        if v then
+            local mad = tonumber(line:match('"' .. m .. '_mad": ([%d%.eE+-]+)'))
+            return table.concat(parts, " "), v, mad or 0, isref
+        end
+    end
+end
+
+local function load(path)
+    local f = assert(io.open(path, "r"))
+    local results = {}
+    local keys = {}
+    local refs = {}
+    local host
+    for line in f:lines() do
+        local key, v, mad, isref = parse_result(line)
+        if not host and line:match('^%s*"host":') then
+            host = line:match('"host": (%b{})')
+        elseif key then
+            local r = {
+                value = v,
+                mad = mad,
+            }
+            if isref then
+                refs[key] = r
+            else
+                results[key] = r
+                keys[#keys + 1] = key
+            end
+        end
+    end
+    f:close()
+    return {
+        results = results,
+        keys = keys,
+        refs = refs,
+        host = host,
+    }
+end
+
+-- return the geometric mean of the references of a run that are in `keys`,
+-- and its relative deviation
+local function ref_factor(run, keys)
+    local sum = 0
+    local dev = 0
+    for _, key in ipairs(keys) do
+        local r = run.refs[key]
+        sum = sum + math.log(r.value)
+        dev = dev + r.mad / r.value
+    end
+    return math.exp(sum / #keys), dev / #keys
+end
+
+-- divide the throughputs of both runs by the factors of their references
+local function normalize(baseline, current)
+    local keys = {}
+    for key, r in pairs(baseline.refs) do
+        if r.value > 0 and current.refs[key] and current.refs[key].value > 0 then
+            keys[#keys + 1] = key
+        end
+    end
+    if #keys == 0 then
+        print("warning: no common reference results, comparing " ..
+                  "absolute throughputs")
+        return
+    end
+
+    for _, run in ipairs({
+        baseline,
+        current,
+    }) do
+        local factor, dev = ref_factor(run, keys)
+        for _, r in pairs(run.results) do
+            r.mad = (r.mad + r.value * dev) / factor
+            r.value = r.value / factor
+        end
+    end
+end
+
+local function main(args)
+    if #args < 2 then
+        io.stderr:write(
+            "usage: lua bench/compare.lua BASELINE CURRENT [TOLERANCE]\n")
+        return 2
+    end
+    local tolerance = tonumber(args[3] or 10) / 100
+    local baserun = load(args[1])
+    local run = load(args[2])
+    local baseline, basekeys, basehost = baserun.results, baserun.keys,
+                                         baserun.host
+    local current, keys, host = run.results, run.keys, run.host
+    local nregressed = 0
+    local ncompared = 0
+    local nmissing = 0
+
+    if basehost ~= host then
+        print(format("warning: baseline host %s differs from %s",
+                     basehost or "unknown", host or "unknown"))
+    end
+    normalize(baserun, run)
+
+    for _, key in ipairs(keys) do
+        local base = baseline[key]
+        local cur = current[key]
+        if base and base.value > 0 then
+            local delta = cur.value - base.value
+            local noise = math.max(tolerance * base.value,
+                                   3 * (base.mad + cur.mad))
+            local status = "ok"
+            if delta < -noise then
+                status = "REGRESSED"
+                nregressed = nregressed + 1
+            elseif delta > noise then
+                status = "improved"
+            end
+            ncompared = ncompared + 1
+            print(format("%-9s %+7.1f%%  %s", status,
+                         delta / base.value * 100, key))
+        end
+    end
+
+    for _, key in ipairs(basekeys) do
+        if not current[key] then
+            nmissing = nmissing + 1
+            print(format("%-9s %8s  %s", "MISSING", "", key))
+        end
+    end
+
+    print(format("\n%d compared, %d regressed, %d missing, %d without baseline",
+                 ncompared, nregressed, nmissing, #keys - ncompared))
+    return (nregressed > 0 or nmissing > 0) and 1 or 0
+end
+
+os.exit(main(arg or {}))
@@ -0,0 +1,132 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Lua host of the end-to-end benchmark
+ *
+ * Runs a Lua script in a state whose allocator counts every allocation, and
+ * exposes the counters and a monotonic clock to the script as the global
+ * table `benchhost`.
+ *
+ *   lua_host script.lua [args...]
+ */
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+    // number of allocations, including reallocations that grow a block
+    double nallocs;
+    // number of bytes requested by them
+    double nbytes;
+} counter_t;
+
+static void *counting_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    counter_t *c = ud;
+
+    if (nsize == 0) {
+        free(ptr);
+        return NULL;
+    } else if (!ptr) {
+        // Lua 5.2 and later pass the type of the new object in `osize`
+        osize = 0;
+    }
+    if (nsize > osize) {
+        c->nallocs++;
+        c->nbytes += (double)(nsize - osize);
+    }
+    return realloc(ptr, nsize);
+}
+
+static int allocs_lua(lua_State *L)
+{
+    counter_t *c = lua_touserdata(L, lua_upvalueindex(1));
+
+    lua_pushnumber(L, c->nallocs);
+    lua_pushnumber(L, c->nbytes);
+    return 2;
+}
+
+static int now_lua(lua_State *L)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    lua_pushnumber(L, (lua_Number)ts.tv_sec * 1e9 + (lua_Number)ts.tv_nsec);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    counter_t counter = {0};
+    lua_State *L      = NULL;
+    int counting      = 1;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s script.lua [args...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    L = lua_newstate(counting_alloc, &counter);
+    if (!L) {
+        // LuaJIT without GC64 accepts only its own allocator on 64-bit hosts
+        L = luaL_newstate();
+        if (!L) {
+            fprintf(stderr, "%s: cannot create a Lua state\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        counting = 0;
+    }
+    luaL_openlibs(L);
+
+    lua_createtable(L, 0, 2);
+    if (counting) {
+        lua_pushlightuserdata(L, &counter);
+        lua_pushcclosure(L, allocs_lua, 1);
+        lua_setfield(L, -2, "allocs");
+    }
+    lua_pushcfunction(L, now_lua);
+    lua_setfield(L, -2, "now");
+    lua_setglobal(L, "benchhost");
+
+    // arg[0] is the script, as with the standalone interpreter
+    lua_createtable(L, argc - 2, 1);
+    for (int i = 1; i < argc; i++) {
+        lua_pushstring(L, argv[i]);
+        lua_rawseti(L, -2, i - 1);
+    }
+    lua_setglobal(L, "arg");
+
+    if (luaL_loadfile(L, argv[1]) != 0 || lua_pcall(L, 0, 0, 0) != 0) {
+        fprintf(stderr, "%s: %s\n", argv[0], lua_tostring(L, -1));
+        lua_close(L);
+        return EXIT_FAILURE;
+    }
+    lua_close(L);
+    return EXIT_SUCCESS;
+}
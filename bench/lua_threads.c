@@ -0,0 +1,253 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Thread scaling benchmark
+ *
+ * Starts N threads, each with its own Lua state that has loaded the base32
+ * module, and runs encode/decode round trips in all of them at once. With no
+ * shared state between the Lua states, the throughput scales linearly with
+ * the number of threads up to the number of cores; a lower efficiency points
+ * at false sharing or hidden global state in the module.
+ *
+ *   lua_threads [--threads=N[,N...]] [--size=N] [--format=rfc|crockford]
+ *               [--time=MS]
+ */
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+// include system headers
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Maximum number of threads
+#define MAX_THREADS 256
+// Number of round trips between checks of the stop flag
+#define BATCH       64
+
+// Run in every state: returns a function that runs `n` round trips
+static const char Script[] =
+    "local base32 = require('base32')\n"
+    "local size, fmt = ...\n"
+    "local t = {}\n"
+    "for i = 1, size do t[i] = string.char((i * 131) % 256) end\n"
+    "local s = table.concat(t)\n"
+    "local encode, decode = base32.encode, base32.decode\n"
+    "return function(n)\n"
+    "    for _ = 1, n do\n"
+    "        assert(decode(encode(s, fmt), fmt) == s)\n"
+    "    end\n"
+    "end\n";
+
+typedef struct {
+    pthread_t tid;
+    lua_State *L;
+    // number of round trips, written by the thread when it stops
+    unsigned long long count;
+    int failed;
+    // keep the counters of the threads on separate cache lines
+    char pad[64];
+} worker_t;
+
+static int Started = 0;
+static int Stop    = 0;
+
+static void *worker(void *arg)
+{
+    worker_t *w              = arg;
+    unsigned long long count = 0;
+
+    while (!__atomic_load_n(&Started, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    while (!__atomic_load_n(&Stop, __ATOMIC_RELAXED)) {
+        lua_pushvalue(w->L, -1);
+        lua_pushinteger(w->L, BATCH);
+        if (lua_pcall(w->L, 1, 0, 0) != 0) {
+            fprintf(stderr, "lua_threads: %s\n", lua_tostring(w->L, -1));
+            w->failed = 1;
+            break;
+        }
+        count += BATCH;
+    }
+    w->count = count;
+    return NULL;
+}
+
+/**
+ * @brief Create a Lua state that has loaded the module, with the round trip
+ * function on the top of its stack.
+ */
+static lua_State *new_state(size_t size, const char *fmt)
+{
+    lua_State *L = luaL_newstate();
+
+    if (!L) {
+        return NULL;
+    }
+    luaL_openlibs(L);
+    if (luaL_loadbuffer(L, Script, sizeof(Script) - 1, "=lua_threads") == 0) {
+        lua_pushinteger(L, (lua_Integer)size);
+        lua_pushstring(L, fmt);
+        if (lua_pcall(L, 2, 1, 0) == 0) {
+            return L;
+        }
+    }
+    fprintf(stderr, "lua_threads: %s\n", lua_tostring(L, -1));
+    lua_close(L);
+    return NULL;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Run `n` threads for `msec` milliseconds and return the number of
+ * round trips per second, or a negative value on failure.
+ */
+static double run(int n, size_t size, const char *fmt, int msec)
+{
+    static worker_t workers[MAX_THREADS];
+    struct timespec ts       = {0};
+    unsigned long long total = 0;
+    double elapsed           = 0;
+    int failed               = 0;
+    int i                    = 0;
+
+    ts.tv_sec  = msec / 1000;
+    ts.tv_nsec = (long)(msec % 1000) * 1000000;
+
+    __atomic_store_n(&Started, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Stop, 0, __ATOMIC_RELAXED);
+    for (i = 0; i < n; i++) {
+        workers[i] = (worker_t){.L = new_state(size, fmt)};
+        if (!workers[i].L ||
+            pthread_create(&workers[i].tid, NULL, worker, workers + i) != 0) {
+            if (workers[i].L) {
+                lua_close(workers[i].L);
+            }
+            failed = 1;
+            break;
+        }
+    }
+
+    // every state is ready; start them at once
+    elapsed = now_sec();
+    __atomic_store_n(&Started, 1, __ATOMIC_RELEASE);
+    if (!failed) {
+        nanosleep(&ts, NULL);
+    }
+    __atomic_store_n(&Stop, 1, __ATOMIC_RELAXED);
+    for (int j = 0; j < i; j++) {
+        pthread_join(workers[j].tid, NULL);
+    }
+    elapsed = now_sec() - elapsed;
+
+    for (int j = 0; j < i; j++) {
+        total += workers[j].count;
+        failed |= workers[j].failed;
+        lua_close(workers[j].L);
+    }
+    return failed ? -1 : (double)total / elapsed;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: lua_threads [--threads=N[,N...]] [--size=N] "
+                    "[--format=rfc|crockford] [--time=MS]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    long ncpu       = sysconf(_SC_NPROCESSORS_ONLN);
+    int counts[64]  = {0};
+    int ncounts     = 0;
+    size_t size     = 1024;
+    const char *fmt = "rfc";
+    int msec        = 1000;
+    double base     = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (strncmp(a, "--threads=", 10) == 0) {
+            ncounts = 0;
+            for (char *p = (char *)a + 10; *p && ncounts < 64;) {
+                long v = strtol(p, &p, 10);
+                if (v < 1 || v > MAX_THREADS || (*p && *p != ',')) {
+                    usage();
+                }
+                counts[ncounts++] = (int)v;
+                p += *p == ',';
+            }
+        } else if (strncmp(a, "--size=", 7) == 0) {
+            size = strtoul(a + 7, NULL, 10);
+        } else if (strcmp(a, "--format=rfc") == 0 ||
+                   strcmp(a, "--format=crockford") == 0) {
+            fmt = a + 9;
+        } else if (strncmp(a, "--time=", 7) == 0) {
+            msec = atoi(a + 7);
+        } else {
+            usage();
+        }
+    }
+    if (!size || msec < 1) {
+        usage();
+    }
+    if (!ncounts) {
+        // 1, 2, 4, ... up to twice the number of CPUs
+        for (int n = 1; n <= 2 * ncpu && n <= MAX_THREADS; n *= 2) {
+            counts[ncounts++] = n;
+        }
+    }
+
+    printf("{\n  \"host\": {\"cpus\": %ld, \"lua\": \"%s\"},\n"
+           "  \"size\": %zu, \"format\": \"%s\",\n  \"results\": [",
+           ncpu, LUA_VERSION, size, fmt);
+    for (int i = 0; i < ncounts; i++) {
+        double rate = run(counts[i], size, fmt, msec);
+        if (rate < 0) {
+            return EXIT_FAILURE;
+        } else if (i == 0) {
+            // throughput of a single thread, extrapolated if counts[0] > 1
+            base = rate / counts[0];
+        }
+        printf("%s\n    {\"threads\": %d, \"calls_per_sec\": %.0f, "
+               "\"mb_per_sec\": %.2f, \"efficiency\": %.3f}",
+               i ? "," : "", counts[i], rate, rate * (double)size / 1e6,
+               rate / (base * counts[i]));
+        fflush(stdout);
+    }
+    printf("\n  ]\n}\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,559 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * base32 command
+ *
+ * A coreutils-compatible base32(1) built on libbase32. The input is read in
+ * large blocks that are converted by the incremental encoder, or by
+ * b32_decode() once the newlines are removed, so large inputs are split
+ * across the worker threads set by --threads.
+ */
+
+#include "base32.h"
+// include system headers
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Size of the input buffer; a multiple of 40 so that only the last encoded
+// block has padding characters
+#define CLI_BUFSIZE  (40 * 64 * 1024)
+// Default number of characters per line
+#define CLI_WRAPCOLS 76
+// Size requested for the pipes of the standard input and output
+#define CLI_PIPESIZE (1024 * 1024)
+
+typedef struct {
+    int fd;
+    const char *name;
+    // number of characters written on the current line
+    size_t col;
+    size_t wrap;
+    // staging buffer for the wrapped lines
+    char *line;
+    size_t linelen;
+} output_t;
+
+static const char *Progname = "base32";
+
+static void usage(FILE *fp)
+{
+    fprintf(fp,
+            "Usage: %s [OPTION]... [FILE]\n"
+            "Base32 encode or decode FILE, or standard input, to standard "
+            "output.\n"
+            "\n"
+            "With no FILE, or when FILE is -, read standard input.\n"
+            "\n"
+            "  -d, --decode          decode data\n"
+            "  -i, --ignore-garbage  when decoding, ignore non-alphabet "
+            "characters\n"
+            "      --ignore-case     when decoding, accept lowercase RFC 4648 "
+            "input\n"
+            "  -w, --wrap=COLS       wrap encoded lines after COLS character "
+            "(default 76).\n"
+            "                          Use 0 to disable line wrapping\n"
+            "      --format=FORMAT   rfc (default) or crockford\n"
+            "      --threads=N       convert large blocks with N threads "
+            "(default 1)\n"
+            "      --help            display this help and exit\n",
+            Progname);
+}
+
+static void die(const char *name, int err)
+{
+    fprintf(stderr, "%s: %s: %s\n", Progname, name, strerror(err));
+    exit(EXIT_FAILURE);
+}
+
+static void fatal(const char *msg, const char *arg)
+{
+    fprintf(stderr, "%s: %s '%s'\n", Progname, msg, arg);
+    fprintf(stderr, "Try '%s --help' for more information.\n", Progname);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Parse a non-negative decimal number.
+ *
+ * @return int 0 on success, or -1 if `s` is not a valid number
+ */
+static int parse_size(const char *s, size_t *v)
+{
+    char *end = NULL;
+    unsigned long long n;
+
+    if (*s < '0' || *s > '9') {
+        return -1;
+    }
+    errno = 0;
+    n     = strtoull(s, &end, 10);
+    if (errno || *end || n > SIZE_MAX) {
+        return -1;
+    }
+    *v = (size_t)n;
+    return 0;
+}
+
+/**
+ * @brief Enlarge the buffer of a pipe so that fewer system calls are needed
+ * to move the data; a no-op for other files.
+ */
+static void grow_pipe(int fd)
+{
+#if defined(F_SETPIPE_SZ)
+    // fails harmlessly with EINVAL if `fd` is not a pipe, or with EPERM if the
+    // size exceeds /proc/sys/fs/pipe-max-size
+    fcntl(fd, F_SETPIPE_SZ, CLI_PIPESIZE);
+#else
+    (void)fd;
+#endif
+}
+
+static size_t readfull(int fd, const char *name, char *buf, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len) {
+        ssize_t rv = read(fd, buf + n, len - n);
+        if (rv == 0) {
+            break;
+        } else if (rv > 0) {
+            n += (size_t)rv;
+        } else if (errno != EINTR) {
+            die(name, errno);
+        }
+    }
+    return n;
+}
+
+static void writefull(int fd, const char *name, const char *buf, size_t len)
+{
+    while (len) {
+        ssize_t rv = write(fd, buf, len);
+        if (rv >= 0) {
+            buf += rv;
+            len -= (size_t)rv;
+        } else if (errno != EINTR) {
+            die(name, errno);
+        }
+    }
+}
+
+/**
+ * @brief Write `len` encoded characters, breaking lines every `out->wrap`
+ * characters.
+ */
+static void put_wrapped(output_t *out, const char *buf, size_t len)
+{
+    size_t n = 0;
+
+    if (!out->wrap) {
+        writefull(out->fd, out->name, buf, len);
+        return;
+    }
+    while (len) {
+        size_t k = out->wrap - out->col;
+        if (k > len) {
+            k = len;
+        }
+        memcpy(out->line + n, buf, k);
+        n += k;
+        buf += k;
+        len -= k;
+        out->col += k;
+        if (out->col == out->wrap) {
+            out->line[n++] = '\n';
+            out->col       = 0;
+        }
+    }
+    writefull(out->fd, out->name, out->line, n);
+}
+
+static void encode(int infd, const char *inname, output_t *out, int fmt)
+{
+    size_t dstlen = CLI_BUFSIZE / 5 * 8 + 8;
+    char *src     = malloc(CLI_BUFSIZE);
+    char *dst     = malloc(dstlen);
+    b32_encoder_t enc;
+    size_t n = 0;
+
+    // every full line of the output gets a newline character
+    out->linelen = dstlen + (out->wrap ? dstlen / out->wrap + 1 : 0);
+    out->line    = out->wrap ? malloc(out->linelen) : NULL;
+    if (!src || !dst || (out->wrap && !out->line)) {
+        die("malloc", ENOMEM);
+    }
+    b32_encoder_init(&enc, fmt);
+
+    while ((n = readfull(infd, inname, src, CLI_BUFSIZE)) > 0) {
+        ptrdiff_t rv = b32_encoder_update(&enc, dst, dstlen, src, n);
+        put_wrapped(out, dst, (size_t)rv);
+        if (n < CLI_BUFSIZE) {
+            break;
+        }
+    }
+    put_wrapped(out, dst, (size_t)b32_encoder_final(&enc, dst, dstlen));
+    if (out->col) {
+        writefull(out->fd, out->name, "\n", 1);
+    }
+
+    free(src);
+    free(dst);
+    free(out->line);
+}
+
+/**
+ * @brief Fill `keep` with the characters that are passed to the decoder:
+ * the alphabet and the padding characters of `fmt`, or every character
+ * except the newline if `ignore` is 0. Crockford's hyphens are dropped as
+ * well, since the decoder skips them anyway. The lowercase letters of
+ * RFC 4648 are not in the alphabet unless `nocase` is non-zero.
+ */
+static void make_filter(unsigned char keep[256], int fmt, int ignore,
+                        int nocase)
+{
+    for (int c = 0; c < 256; c++) {
+        if (c == '\n' || (c == '-' && fmt == B32_CROCKFORD)) {
+            keep[c] = 0;
+        } else if (!ignore) {
+            keep[c] = 1;
+        } else if (fmt == B32_RFC && !nocase && c >= 'a' && c <= 'z') {
+            keep[c] = 0;
+        } else {
+            // a single character is rejected only if it is illegal
+            b32_decoder_t dec;
+            char ch = (char)c;
+            char buf[8];
+            b32_decoder_init(&dec, fmt);
+            keep[c] = b32_decoder_update(&dec, buf, sizeof(buf), &ch, 1,
+                                         NULL) >= 0;
+        }
+    }
+}
+
+/**
+ * @brief Remove the characters that are not in `keep` from `buf` in place.
+ *
+ * @return size_t Number of characters left
+ */
+static size_t filter(char *buf, size_t len, const unsigned char keep[256],
+                     int newlines_only)
+{
+    size_t m = 0;
+
+    if (newlines_only) {
+        // the lines are long, so the newlines are found by memchr
+        const char *p   = buf;
+        const char *end = buf + len;
+        while (p < end) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            size_t n       = (size_t)((nl ? nl : end) - p);
+            memmove(buf + m, p, n);
+            m += n;
+            p += n + 1;
+        }
+        return m;
+    }
+    for (size_t i = 0; i < len; i++) {
+        buf[m] = buf[i];
+        m += keep[(unsigned char)buf[i]];
+    }
+    return m;
+}
+
+/**
+ * @brief Return the position of the first lowercase letter of `buf`, or `len`
+ * if there is none.
+ */
+static size_t find_lowercase(const char *buf, size_t len)
+{
+    const unsigned char *s = (const unsigned char *)buf;
+
+    // test blocks without branches so that the loop is vectorized
+    for (size_t i = 0; i < len; i += 4096) {
+        size_t n          = len - i < 4096 ? len - i : 4096;
+        unsigned char any = 0;
+        for (size_t j = 0; j < n; j++) {
+            any |= (unsigned char)(s[i + j] - 'a') < 26;
+        }
+        if (any) {
+            for (size_t j = 0;; j++) {
+                if ((unsigned char)(s[i + j] - 'a') < 26) {
+                    return i + j;
+                }
+            }
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief Feed `len` characters of `src` to the incremental decoder and
+ * write the result.
+ *
+ * @return ptrdiff_t 0 on success, or a negative error code
+ */
+static ptrdiff_t decode_update(b32_decoder_t *dec, output_t *out, char *dst,
+                               size_t dstlen, const char *src, size_t len)
+{
+    ptrdiff_t rv = b32_decoder_update(dec, dst, dstlen, src, len, NULL);
+
+    if (rv > 0) {
+        writefull(out->fd, out->name, dst, (size_t)rv);
+    }
+    return rv < 0 ? rv : 0;
+}
+
+/**
+ * @brief Decode the `len` filtered characters of `src` and write the result;
+ * if `final` is non-zero, finish the string, which also resets the decoder
+ * for the next one.
+ *
+ * The quanta that are complete, without padding, and start where the decoder
+ * is between quanta are decoded by b32_decode(), so that large runs go
+ * through the block kernel and the worker threads; the incremental decoder
+ * only sees the characters around them.
+ *
+ * @return ptrdiff_t 0 on success, or a negative error code
+ */
+static ptrdiff_t decode_part(b32_decoder_t *dec, output_t *out, char *dst,
+                             size_t dstlen, const char *src, size_t len,
+                             int final)
+{
+    size_t n     = 0;
+    ptrdiff_t rv = 0;
+
+    // complete the quantum left over by the previous part
+    if (dec->nbits) {
+        n = (size_t)(40 - dec->nbits) / 5;
+        n = n < len ? n : len;
+        if ((rv = decode_update(dec, out, dst, dstlen, src, n)) < 0) {
+            return rv;
+        }
+        src += n;
+        len -= n;
+    }
+    // the last quantum of a final part has the padding
+    n = len / 8 * 8;
+    if (final && n == len && n > 0) {
+        n -= 8;
+    }
+    if (n && dec->nbits == 0 && dec->npad == 0) {
+        rv = b32_decode(dst, dstlen, src, n, dec->fmt, 0, NULL);
+        if (rv < 0) {
+            return rv;
+        }
+        writefull(out->fd, out->name, dst, (size_t)rv);
+        dec->pos += n;
+        src += n;
+        len -= n;
+    }
+    if ((rv = decode_update(dec, out, dst, dstlen, src, len)) < 0 || !final) {
+        return rv;
+    }
+    rv = b32_decoder_final(dec, dst, dstlen);
+    if (rv > 0) {
+        writefull(out->fd, out->name, dst, (size_t)rv);
+    }
+    return rv < 0 ? rv : 0;
+}
+
+/**
+ * @brief Decode the input as coreutils does: an RFC 4648 quantum that ends
+ * with padding completes a string, and the next characters start another
+ * one, so that concatenated encoded files can be decoded at once. Lowercase
+ * RFC 4648 letters are rejected unless `nocase` is non-zero.
+ */
+static void decode(int infd, const char *inname, output_t *out, int fmt,
+                   int ignore, int nocase)
+{
+    size_t dstlen = CLI_BUFSIZE / 8 * 5 + 8;
+    char *src     = malloc(CLI_BUFSIZE);
+    char *dst     = malloc(dstlen);
+    unsigned char keep[256];
+    b32_decoder_t dec;
+    ptrdiff_t rv = 0;
+    size_t n     = 0;
+    // filtered characters of the current quantum, and whether it has padding
+    size_t qlen = 0;
+    int padded  = 0;
+
+    if (!src || !dst) {
+        die("malloc", ENOMEM);
+    }
+    make_filter(keep, fmt, ignore, nocase);
+    b32_decoder_init(&dec, fmt);
+
+    while ((n = readfull(infd, inname, src, CLI_BUFSIZE)) > 0) {
+        int eof      = n < CLI_BUFSIZE;
+        size_t m     = filter(src, n, keep, !ignore && fmt == B32_RFC);
+        size_t start = 0;
+        size_t end   = 0;
+        // decode the characters before a lowercase letter, then fail
+        size_t valid = fmt == B32_RFC && !ignore && !nocase ?
+                           find_lowercase(src, m) :
+                           m;
+        int lower    = valid < m;
+
+        m = valid;
+
+        // finish the string at the end of each quantum with padding; the
+        // quanta of this buffer end where (qlen + i) % 8 == 0
+        while (rv >= 0 && fmt == B32_RFC && start < m) {
+            if (padded) {
+                end = 8 - qlen;
+            } else {
+                const char *p = memchr(src + start, '=', m - start);
+                if (!p) {
+                    break;
+                }
+                end = (size_t)(p - src);
+                end += 8 - (qlen + end) % 8;
+            }
+            if (end > m) {
+                padded = 1;
+                break;
+            }
+            rv     = decode_part(&dec, out, dst, dstlen, src + start,
+                                 end - start, 1);
+            start  = end;
+            padded = 0;
+        }
+        if (rv >= 0) {
+            rv = decode_part(&dec, out, dst, dstlen, src + start, m - start,
+                             0);
+        }
+        if (rv >= 0 && lower) {
+            rv = B32_EILSEQ;
+        }
+        qlen = (qlen + m) % 8;
+        if (rv < 0 || eof) {
+            break;
+        }
+    }
+    if (rv >= 0) {
+        rv = decode_part(&dec, out, dst, dstlen, NULL, 0, 1);
+    }
+    if (rv < 0) {
+        fprintf(stderr, "%s: invalid input\n", Progname);
+        exit(EXIT_FAILURE);
+    }
+    free(src);
+    free(dst);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option longopts[] = {
+        {"decode",         no_argument,       NULL, 'd'},
+        {"ignore-garbage", no_argument,       NULL, 'i'},
+        {"ignore-case",    no_argument,       NULL, 'c'},
+        {"wrap",           required_argument, NULL, 'w'},
+        {"format",         required_argument, NULL, 'f'},
+        {"threads",        required_argument, NULL, 't'},
+        {"help",           no_argument,       NULL, 'h'},
+        {NULL,             0,                 NULL, 0  },
+    };
+    output_t out       = {.fd = STDOUT_FILENO, .name = "write error"};
+    const char *inname = "-";
+    int infd           = STDIN_FILENO;
+    int fmt            = B32_RFC;
+    int decoding       = 0;
+    int ignore         = 0;
+    int nocase         = 0;
+    size_t nthr        = 1;
+    int c              = 0;
+
+    out.wrap = CLI_WRAPCOLS;
+    while ((c = getopt_long(argc, argv, "diw:", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'd':
+            decoding = 1;
+            break;
+        case 'i':
+            ignore = 1;
+            break;
+        case 'c':
+            nocase = 1;
+            break;
+        case 'w':
+            if (parse_size(optarg, &out.wrap) != 0) {
+                fatal("invalid wrap size:", optarg);
+            }
+            break;
+        case 'f':
+            if (strcmp(optarg, "rfc") == 0) {
+                fmt = B32_RFC;
+            } else if (strcmp(optarg, "crockford") == 0) {
+                fmt = B32_CROCKFORD;
+            } else {
+                fatal("invalid format:", optarg);
+            }
+            break;
+        case 't':
+            if (parse_size(optarg, &nthr) != 0 || nthr < 1 ||
+                nthr > B32_MAX_THREADS) {
+                fatal("invalid number of threads:", optarg);
+            }
+            break;
+        case 'h':
+            usage(stdout);
+            return EXIT_SUCCESS;
+        default:
+            usage(stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind > 1) {
+        fatal("extra operand", argv[optind + 1]);
+    } else if (optind < argc && strcmp(argv[optind], "-") != 0) {
+        inname = argv[optind];
+        infd   = open(inname, O_RDONLY | O_CLOEXEC);
+        if (infd == -1) {
+            die(inname, errno);
+        }
+    }
+
+    // every full input buffer is split across the threads; the threshold is
+    // half a buffer because the decoder gets the characters without the
+    // newlines of the wrapped lines
+    b32_set_threads((int)nthr,
+                    nthr > 1 ? CLI_BUFSIZE / 2 : B32_PARALLEL_THRESHOLD);
+    grow_pipe(infd);
+    grow_pipe(out.fd);
+    if (decoding) {
+        decode(infd, inname, &out, fmt, ignore, nocase);
+    } else {
+        encode(infd, inname, &out, fmt);
+    }
+    if (infd != STDIN_FILENO) {
+        close(infd);
+    }
+    return EXIT_SUCCESS;
+}
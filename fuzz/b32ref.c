@@ -0,0 +1,298 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Frozen copy of the scalar code of src/b32core.c; see b32ref.h.
+ */
+
+#include "b32ref.h"
+#include "base32.h"
+
+// RFC 4648 Base32 Decoding table
+// https://datatracker.ietf.org/doc/html/rfc4648#section-6
+static const uint8_t RFC_DECODE_TABLE[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF,
+
+    // 2-7
+    26, 27, 28, 29, 30, 31,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // A-Z
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+    21, 22, 23, 24, 25,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // a-z
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+    21, 22, 23, 24, 25,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF};
+
+// Crockford's Base32 Decoding table (0xFF means invalid character)
+static const uint8_t CROCKFORD_DECODE_TABLE[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // 0-9
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // A-Z (I=1, L=1, O=0, U=0xFF)
+    10, 11, 12, 13, 14, 15, 16, 17, 1, 18, 19, 1, 20, 21, 0, 22, 23, 24, 25, 26,
+    0xFF, 27, 28, 29, 30, 31,
+
+    //
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // a-z (i=1, l=1, o=0, u=0xFF)
+    10, 11, 12, 13, 14, 15, 16, 17, 1, 18, 19, 1, 20, 21, 0, 22, 23, 24, 25, 26,
+    0xFF, 27, 28, 29, 30, 31,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, -1};
+
+// RFC 4648 Base32 encoding/decoding
+// https://datatracker.ietf.org/doc/html/rfc4648#section-6
+static const char RFC_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+// Crockford's Base32 alphabet (excluding I, L, O, U)
+static const char CROCKFORD_ALPHABET[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+
+/**
+ * @brief Encode `srclen` bytes of `src` into `dst` with the alphabet `tbl`.
+ *
+ * `dst` must have room for the encoded string. When `pad` is non-zero, the
+ * output is padded to a multiple of 8 characters.
+ *
+ * @return size_t Number of characters written
+ */
+static size_t encode_run(char *dst, const uint8_t *src, size_t srclen,
+                         const char *tbl, int pad)
+{
+    const uint8_t *head = src;
+    const uint8_t *tail = head + srclen;
+    char *out           = dst;
+
+    // Process 5 bytes at a time (40 bits -> 8 characters)
+    while ((tail - head) >= 5) {
+        // Load 5 bytes (40 bits)
+        uint64_t acc = ((uint64_t)head[0] << 32) | ((uint64_t)head[1] << 24) |
+                       ((uint64_t)head[2] << 16) | ((uint64_t)head[3] << 8) |
+                       (uint64_t)head[4];
+        // Extract 8 characters (5 bits each)
+        out[0] = tbl[(acc >> 35) & 0x1F];
+        out[1] = tbl[(acc >> 30) & 0x1F];
+        out[2] = tbl[(acc >> 25) & 0x1F];
+        out[3] = tbl[(acc >> 20) & 0x1F];
+        out[4] = tbl[(acc >> 15) & 0x1F];
+        out[5] = tbl[(acc >> 10) & 0x1F];
+        out[6] = tbl[(acc >> 5) & 0x1F];
+        out[7] = tbl[acc & 0x1F];
+        out += 8;  // Move output pointer forward by 8 characters
+        head += 5; // Move source pointer forward by 5 bytes
+    }
+
+    // Handle remaining bytes (1-4 bytes)
+    if (head < tail) {
+        uint32_t acc = 0;
+        int nbits    = 0;
+
+        // Load remaining bytes into accumulator
+        while (head < tail) {
+            acc = (acc << 8) | *head++;
+            nbits += 8;
+        }
+        // Extract all complete 5-bit groups
+        while (nbits >= 5) {
+            nbits -= 5;
+            *out++ = tbl[(acc >> nbits) & 0x1F];
+        }
+        // Handle remaining bits (if any)
+        if (nbits > 0) {
+            *out++ = tbl[(acc << (5 - nbits)) & 0x1F];
+        }
+
+        // Add padding for RFC Base32 format
+        if (pad) {
+            while ((out - dst) % 8 != 0) {
+                *out++ = '=';
+            }
+        }
+    }
+
+    return (size_t)(out - dst);
+}
+
+/**
+ * @brief Select the decoding table for `fmt` and strip the RFC 4648 padding
+ * characters from the end of `src`.
+ *
+ * @param src Base32 encoded string
+ * @param srclen Length of the string; updated to the length without padding
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param tbl Receives the decoding table
+ * @return int 0 on success, or a negative error code
+ */
+static int decode_prepare(const uint8_t *src, size_t *srclen, int fmt,
+                          const uint8_t **tbl)
+{
+    size_t len = *srclen;
+
+    // select lookup table based on format
+    switch (fmt) {
+    case B32_RFC: {
+        *tbl = RFC_DECODE_TABLE;
+        // RFC 4648 Base32 requires input length to be a multiple of 8
+        if (len % 8 != 0) {
+            return B32_ELENGTH;
+        }
+
+        // remove padding characters
+        int npad = 0;
+        for (; len > 0 && src[len - 1] == '='; len--) {
+            if (++npad > 6) {
+                // RFC 4648 Base32 allows at most 6 padding characters
+                return B32_EPADDING;
+            }
+        }
+        // number of padding characters must be 0, 1, 3, 4, or 6
+        if (npad != 0 && npad != 1 && npad != 3 && npad != 4 && npad != 6) {
+            return B32_EPADDING;
+        }
+        *srclen = len;
+        return 0;
+    }
+
+    case B32_CROCKFORD:
+        *tbl = CROCKFORD_DECODE_TABLE;
+        return 0;
+
+    default:
+        return B32_EINVAL;
+    }
+}
+
+/**
+ * @brief Decode `srclen` characters of `src` into `dst` with the decoding
+ * table `tbl`.
+ *
+ * The padding characters must have been removed by decode_prepare().
+ *
+ * @return ptrdiff_t Number of bytes written, or B32_EILSEQ with the 0-based
+ *         offset of the illegal character in `*errpos`
+ */
+static ptrdiff_t decode_run(uint8_t *dst, const uint8_t *src, size_t srclen,
+                            const uint8_t *tbl, size_t *errpos)
+{
+    uint8_t *out = dst;
+    uint64_t acc = 0;
+    int nbits    = 0;
+
+    for (size_t i = 0; i < srclen; i++) {
+        uint8_t c  = src[i];
+        uint8_t dc = tbl[c];
+
+        // Check if character is valid
+        if (dc > 31) {
+            // In Crockford's Base32, '-' is allowed for readability
+            if (c == '-' && tbl == CROCKFORD_DECODE_TABLE) {
+                continue;
+            }
+            *errpos = i;
+            return B32_EILSEQ;
+        }
+
+        // Add 5 bits to buffer
+        acc = (acc << 5) | dc;
+        nbits += 5;
+
+        // Extract 5 bytes when we have 40 bits
+        if (nbits >= 40) {
+            // Extract 5 bytes (40 bits)
+            out[0] = (acc >> 32) & 0xFF;
+            out[1] = (acc >> 24) & 0xFF;
+            out[2] = (acc >> 16) & 0xFF;
+            out[3] = (acc >> 8) & 0xFF;
+            out[4] = acc & 0xFF;
+            out += 5;
+            acc   = 0;
+            nbits = 0;
+        }
+    }
+
+    // Handle remaining bits (less than 40 bits)
+    while (nbits >= 8) {
+        nbits -= 8;
+        *out++ = (acc >> nbits) & 0xFF;
+    }
+
+    return out - dst;
+}
+
+size_t ref_encode(char *dst, const uint8_t *src, size_t srclen, int fmt)
+{
+    return encode_run(dst, src, srclen,
+                      fmt == B32_RFC ? RFC_ALPHABET : CROCKFORD_ALPHABET,
+                      fmt == B32_RFC);
+}
+
+ptrdiff_t ref_decode(uint8_t *dst, const char *src, size_t srclen, int fmt,
+                     size_t *errpos)
+{
+    const uint8_t *s   = (const uint8_t *)src;
+    const uint8_t *tbl = NULL;
+    int rv             = decode_prepare(s, &srclen, fmt, &tbl);
+
+    if (rv != 0) {
+        return rv;
+    }
+    return decode_run(dst, s, srclen, tbl, errpos);
+}
@@ -0,0 +1,47 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef b32ref_h
+#define b32ref_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Reference implementation
+ *
+ * A frozen copy of the scalar encoder and decoder of src/b32core.c, used as
+ * the oracle of the differential fuzzer. It defines the expected output,
+ * error codes and error positions of every engine of the library, and must
+ * not be optimized or changed together with them.
+ */
+
+// Encode `srclen` bytes of `src` into `dst` of b32_encoded_len() characters.
+size_t ref_encode(char *dst, const uint8_t *src, size_t srclen, int fmt);
+
+// Decode `srclen` characters of `src` into `dst` of b32_decoded_maxlen()
+// bytes, or return a negative error code with the offset of an illegal
+// character in `*errpos`.
+ptrdiff_t ref_decode(uint8_t *dst, const char *src, size_t srclen, int fmt,
+                     size_t *errpos);
+
+#endif
@@ -0,0 +1,514 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Differential fuzzer of libbase32
+ *
+ * Runs every engine of the library on the same input and aborts if any of
+ * them disagrees with the reference implementation of b32ref.c, including
+ * the error codes and the positions of illegal characters. The first two
+ * bytes of an input select the configuration; the rest is both encoded as
+ * data and decoded as a Base32 string:
+ *
+ *   byte 0: bits 0-1  number of threads - 1; the parallel threshold is 0,
+ *                     so that even small inputs are split over the threads
+ *           bit 2     Crockford's Base32 instead of RFC 4648
+ *           bit 3     also run the file engines
+ *   byte 1: seed of the split positions and the layout of the batches
+ *
+ * Built with -fsanitize=fuzzer, LLVMFuzzerTestOneInput() is the libFuzzer
+ * entry point; linked with fuzz/replay.c, it runs the files given to main().
+ */
+
+#include "b32ref.h"
+#include "base32.h"
+// include system headers
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CONF_THREADS   0x3
+#define CONF_CROCKFORD 0x4
+#define CONF_FILES     0x8
+
+// Result of the reference implementation for an input
+typedef struct {
+    int decode;
+    int fmt;
+    ptrdiff_t rv;
+    size_t errpos;
+    const char *out;
+} expect_t;
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static void fail(const expect_t *x, const char *engine, const char *msg, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "fuzz: %s %s (%s): ", x->decode ? "decode" : "encode",
+            engine, x->fmt == B32_RFC ? "rfc" : "crockford");
+    va_start(ap, msg);
+    vfprintf(stderr, msg, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    abort();
+}
+
+static void *xmalloc(size_t len)
+{
+    void *p = malloc(len ? len : 1);
+
+    if (!p) {
+        perror("fuzz: malloc");
+        abort();
+    }
+    return p;
+}
+
+// xorshift32
+static uint32_t next_rand(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/**
+ * @brief Compare the result of an engine with the reference.
+ */
+static void check(const expect_t *x, const char *engine, ptrdiff_t rv,
+                  size_t errpos, const void *out)
+{
+    if (rv != x->rv) {
+        fail(x, engine, "returned %td, expected %td", rv, x->rv);
+    } else if (rv == B32_EILSEQ && errpos != x->errpos) {
+        fail(x, engine, "illegal character at %zu, expected %zu", errpos,
+             x->errpos);
+    } else if (rv > 0 && memcmp(out, x->out, (size_t)rv) != 0) {
+        fail(x, engine, "output differs");
+    }
+}
+
+/**
+ * @brief Compare the result of a single-pass decoder with the reference.
+ *
+ * A decoder that does not see the whole string first checks the length and
+ * the padding at the end, so it may report an illegal character instead of
+ * the length or padding error of the reference.
+ */
+static void check_single_pass(const expect_t *x, const char *engine,
+                              ptrdiff_t rv, size_t errpos, const void *out)
+{
+    if (rv == B32_EILSEQ &&
+        (x->rv == B32_ELENGTH || x->rv == B32_EPADDING)) {
+        return;
+    }
+    check(x, engine, rv, errpos, out);
+}
+
+static size_t maxlen(const expect_t *x, size_t srclen)
+{
+    return x->decode ? b32_decoded_maxlen(srclen) :
+                       b32_encoded_len(srclen, x->fmt);
+}
+
+/**
+ * @brief Compute the reference result of converting `src`.
+ *
+ * `x->decode` and `x->fmt` must be set; the output buffer is allocated.
+ */
+static void expect(expect_t *x, const char *src, size_t len)
+{
+    char *out = xmalloc(maxlen(x, len));
+
+    if (x->decode) {
+        x->rv = ref_decode((uint8_t *)out, src, len, x->fmt, &x->errpos);
+    } else {
+        x->rv = (ptrdiff_t)ref_encode(out, (const uint8_t *)src, len, x->fmt);
+    }
+    x->out = out;
+}
+
+/**
+ * @brief Run the whole-buffer engines: every kernel, threads, asynchronous,
+ * and the validation functions of the decoder.
+ */
+static void run_whole(const expect_t *x, const char *src, size_t len)
+{
+    size_t dstlen     = maxlen(x, len);
+    char *dst         = xmalloc(dstlen);
+    b32_async_t *task = NULL;
+    size_t errpos     = 0;
+    ptrdiff_t rv      = 0;
+
+    if (!x->decode && (size_t)x->rv != dstlen) {
+        fail(x, "b32_encoded_len", "returned %zu, expected %td", dstlen,
+             x->rv);
+    } else if (x->rv > (ptrdiff_t)dstlen) {
+        fail(x, "b32_decoded_maxlen", "returned %zu, less than %td", dstlen,
+             x->rv);
+    }
+
+    // every kernel on the calling thread, and the dispatch of b32_set_tuning
+    for (int i = 0; i < 4; i++) {
+        static const char *const names[] = {"scalar", "block", "nontemporal",
+                                            "threads"};
+        static const int flags[]         = {
+            B32_NOTHREADS | B32_SCALAR,
+            B32_NOTHREADS | B32_BLOCK,
+            B32_NOTHREADS | B32_NONTEMPORAL,
+            0,
+        };
+        if (x->decode) {
+            rv = b32_decode(dst, dstlen, src, len, x->fmt, flags[i], &errpos);
+        } else {
+            rv = b32_encode(dst, dstlen, src, len, x->fmt, flags[i]);
+        }
+        check(x, names[i], rv, errpos, dst);
+    }
+
+    if (x->decode) {
+        rv = b32_decode_async(&task, dst, dstlen, src, len, x->fmt);
+    } else {
+        rv = b32_encode_async(&task, dst, dstlen, src, len, x->fmt);
+    }
+    if (rv == 0) {
+        rv = b32_async_wait(task, &errpos);
+        b32_async_free(task);
+    }
+    check(x, "async", rv, errpos, dst);
+
+    if (x->decode) {
+        // only the length and the padding are checked
+        ptrdiff_t want = 0;
+        if (x->rv == B32_ELENGTH || x->rv == B32_EPADDING) {
+            want = x->rv;
+        }
+        rv = b32_decode_check(src, len, x->fmt);
+        if (rv != want) {
+            fail(x, "b32_decode_check", "returned %td, expected %td", rv,
+                 want);
+        }
+        // the decoded length is returned without decoding
+        rv = b32_validate(src, len, x->fmt, &errpos);
+        check(x, "b32_validate", rv, errpos, x->out);
+    }
+    free(dst);
+}
+
+/**
+ * @brief Encode `src` in random parts, moving the state to a new encoder
+ * through b32_encoder_export() at random points.
+ */
+static ptrdiff_t encode_parts(const expect_t *x, char *dst, const char *src,
+                              size_t len, uint32_t *rng)
+{
+    b32_encoder_t e                       = {0};
+    unsigned char state[B32_STATE_MAXLEN] = {0};
+    size_t done                           = 0;
+    ptrdiff_t rv                          = 0;
+
+    b32_encoder_init(&e, x->fmt);
+    for (size_t pos = 0; pos < len;) {
+        size_t n = next_rand(rng) % 17;
+        if (n > len - pos) {
+            n = len - pos;
+        }
+        rv = b32_encoder_update(&e, dst + done, b32_encoder_outlen(&e, n),
+                                src + pos, n);
+        if (rv < 0) {
+            return rv;
+        }
+        done += (size_t)rv;
+        pos += n;
+        if (next_rand(rng) % 4 == 0) {
+            size_t slen = b32_encoder_export(&e, state);
+            b32_encoder_init(&e, B32_RFC);
+            if (b32_encoder_import(&e, state, slen) != 0) {
+                fail(x, "incremental", "cannot import the state");
+            }
+        }
+    }
+    rv = b32_encoder_final(&e, dst + done, maxlen(x, len) - done);
+    return rv < 0 ? rv : (ptrdiff_t)done + rv;
+}
+
+/**
+ * @brief Decode `src` in random parts, moving the state to a new decoder
+ * through b32_decoder_export() at random points.
+ */
+static ptrdiff_t decode_parts(const expect_t *x, char *dst, const char *src,
+                              size_t len, uint32_t *rng, size_t *errpos)
+{
+    b32_decoder_t d                       = {0};
+    unsigned char state[B32_STATE_MAXLEN] = {0};
+    size_t done                           = 0;
+    ptrdiff_t rv                          = 0;
+
+    b32_decoder_init(&d, x->fmt);
+    for (size_t pos = 0; pos < len;) {
+        size_t n = next_rand(rng) % 17;
+        if (n > len - pos) {
+            n = len - pos;
+        }
+        rv = b32_decoder_update(&d, dst + done, b32_decoder_outlen(&d, n),
+                                src + pos, n, errpos);
+        if (rv < 0) {
+            return rv;
+        }
+        done += (size_t)rv;
+        pos += n;
+        if (next_rand(rng) % 4 == 0) {
+            size_t slen = b32_decoder_export(&d, state);
+            b32_decoder_init(&d, B32_RFC);
+            if (b32_decoder_import(&d, state, slen) != 0) {
+                fail(x, "incremental", "cannot import the state");
+            }
+        }
+    }
+    rv = b32_decoder_final(&d, dst + done, maxlen(x, len) - done);
+    return rv < 0 ? rv : (ptrdiff_t)done + rv;
+}
+
+/**
+ * @brief Run the incremental encoder or decoder. Strings are decoded both
+ * after b32_decode_check(), as the Lua module does, and in a single pass.
+ */
+static void run_incremental(const expect_t *x, const char *src, size_t len,
+                            uint32_t *rng)
+{
+    char *dst     = xmalloc(maxlen(x, len));
+    size_t errpos = 0;
+    ptrdiff_t rv  = 0;
+
+    if (!x->decode) {
+        check(x, "incremental", encode_parts(x, dst, src, len, rng), 0, dst);
+    } else {
+        rv = b32_decode_check(src, len, x->fmt);
+        if (rv == 0) {
+            rv = decode_parts(x, dst, src, len, rng, &errpos);
+        }
+        check(x, "incremental", rv, errpos, dst);
+
+        rv = decode_parts(x, dst, src, len, rng, &errpos);
+        check_single_pass(x, "incremental single-pass", rv, errpos, dst);
+    }
+    free(dst);
+}
+
+/**
+ * @brief Run b32_*_batch() and b32_*_many() on `src` cut into items.
+ *
+ * Most items have the same random length, so that the multi-buffer kernel
+ * runs them in lockstep; the last part, an empty item and the whole input
+ * follow.
+ */
+static void run_batch(const expect_t *x, const char *src, size_t len,
+                      uint32_t *rng)
+{
+    size_t size       = 1 + next_rand(rng) % 24;
+    size_t nitems     = 0;
+    b32_item_t *items = NULL;
+    expect_t *want    = NULL;
+
+    if (x->decode && x->fmt == B32_RFC && next_rand(rng) % 2) {
+        // whole quanta, so that the items can be valid strings
+        size *= 8;
+    }
+    nitems = len / size + 3;
+    items  = xmalloc(nitems * sizeof(b32_item_t));
+    want   = xmalloc(nitems * sizeof(expect_t));
+    for (size_t i = 0, pos = 0; i < nitems; i++) {
+        size_t n = size;
+        if (i == nitems - 1) {
+            pos = 0;
+            n   = len;
+        } else if (n > len - pos) {
+            n = len - pos;
+        }
+        want[i]  = (expect_t){.decode = x->decode, .fmt = x->fmt};
+        expect(&want[i], src + pos, n);
+        items[i] = (b32_item_t){
+            .src    = src + pos,
+            .srclen = n,
+            .dstlen = maxlen(x, n),
+        };
+        items[i].dst = xmalloc(items[i].dstlen);
+        pos += n;
+    }
+
+    for (int many = 0; many < 2; many++) {
+        void (*fn)(b32_item_t *, size_t, int, int) = NULL;
+        if (x->decode) {
+            fn = many ? b32_decode_many : b32_decode_batch;
+        } else {
+            fn = many ? b32_encode_many : b32_encode_batch;
+        }
+        for (int threads = 0; threads < 2; threads++) {
+            fn(items, nitems, x->fmt, threads ? 0 : B32_NOTHREADS);
+            for (size_t i = 0; i < nitems; i++) {
+                check(&want[i], many ? "many" : "batch", items[i].rv,
+                      items[i].errpos, items[i].dst);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < nitems; i++) {
+        free(items[i].dst);
+        free((void *)want[i].out);
+    }
+    free(items);
+    free(want);
+}
+
+/**
+ * @brief Run b32_encode_stream() or b32_decode_stream() with small random
+ * buffers.
+ */
+static void run_stream(const expect_t *x, const char *src, size_t len,
+                       uint32_t *rng)
+{
+    size_t bufsize = next_rand(rng) % 256;
+    FILE *in       = tmpfile();
+    char *out      = NULL;
+    size_t outsize = 0;
+    FILE *fp       = open_memstream(&out, &outsize);
+    size_t errpos  = 0;
+    int errc       = 0;
+    ptrdiff_t rv   = 0;
+
+    if (!in || !fp || fwrite(src, 1, len, in) != len ||
+        fseek(in, 0, SEEK_SET) != 0) {
+        perror("fuzz: stream");
+        abort();
+    }
+    if (x->decode) {
+        rv = b32_decode_stream(in, fp, x->fmt, bufsize, &errpos, &errc);
+    } else {
+        rv = b32_encode_stream(in, fp, x->fmt, bufsize);
+    }
+    fclose(fp);
+    fclose(in);
+
+    if (rv >= 0 && (size_t)rv != outsize) {
+        fail(x, "stream", "returned %td, but wrote %zu", rv, outsize);
+    } else if (rv == B32_EILSEQ &&
+               (errpos >= len || errc != (unsigned char)src[errpos])) {
+        fail(x, "stream", "illegal character %d at %zu does not match", errc,
+             errpos);
+    } else if (x->decode) {
+        check_single_pass(x, "stream", rv, errpos, out);
+    } else {
+        check(x, "stream", rv, errpos, out);
+    }
+    free(out);
+}
+
+/**
+ * @brief Run b32_encode_file() or b32_decode_file() with every I/O method.
+ */
+static void run_file(const expect_t *x, const char *src, size_t len)
+{
+    static const struct {
+        const char *name;
+        int flags;
+    } METHODS[] = {
+        {"file mmap",  0                         },
+        {"file uring", B32_PIPELINE              },
+        {"file pread", B32_PIPELINE | B32_NOURING},
+    };
+    char inpath[]  = "/tmp/b32fuzz-in-XXXXXX";
+    char outpath[] = "/tmp/b32fuzz-out-XXXXXX";
+    int infd       = mkstemp(inpath);
+    int outfd      = mkstemp(outpath);
+    char *out      = xmalloc(maxlen(x, len));
+    size_t errpos  = 0;
+    int errc       = 0;
+    ptrdiff_t rv   = 0;
+
+    if (infd == -1 || outfd == -1 || write(infd, src, len) != (ssize_t)len) {
+        perror("fuzz: file");
+        abort();
+    }
+    for (size_t i = 0; i < sizeof(METHODS) / sizeof(METHODS[0]); i++) {
+        if (x->decode) {
+            rv = b32_decode_file(inpath, outpath, x->fmt, METHODS[i].flags,
+                                 &errpos, &errc);
+        } else {
+            rv = b32_encode_file(inpath, outpath, x->fmt, METHODS[i].flags);
+        }
+        if (rv > 0 && pread(outfd, out, (size_t)rv, 0) != rv) {
+            fail(x, METHODS[i].name, "output file is too short");
+        } else if (rv == B32_EILSEQ &&
+                   (errpos >= len || errc != (unsigned char)src[errpos])) {
+            fail(x, METHODS[i].name,
+                 "illegal character %d at %zu does not match", errc, errpos);
+        }
+        if (x->decode && (METHODS[i].flags & B32_PIPELINE)) {
+            check_single_pass(x, METHODS[i].name, rv, errpos, out);
+        } else {
+            check(x, METHODS[i].name, rv, errpos, out);
+        }
+    }
+
+    close(infd);
+    close(outfd);
+    unlink(inpath);
+    unlink(outpath);
+    free(out);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    const char *src = (const char *)data + 2;
+    size_t len      = size - 2;
+    uint32_t rng    = 0;
+
+    if (size < 2) {
+        return 0;
+    }
+    b32_set_threads((data[0] & CONF_THREADS) + 1, 0);
+
+    for (int decode = 0; decode < 2; decode++) {
+        expect_t x = {
+            .decode = decode,
+            .fmt    = data[0] & CONF_CROCKFORD ? B32_CROCKFORD : B32_RFC,
+        };
+        // the same splits for every input with the same seed
+        rng = 0x9E3779B9u ^ data[1];
+        expect(&x, src, len);
+        run_whole(&x, src, len);
+        run_incremental(&x, src, len, &rng);
+        run_batch(&x, src, len, &rng);
+        run_stream(&x, src, len, &rng);
+        if (data[0] & CONF_FILES) {
+            run_file(&x, src, len);
+        }
+        free((void *)x.out);
+    }
+    return 0;
+}
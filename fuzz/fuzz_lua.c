@@ -0,0 +1,583 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Differential fuzzer of the Lua module
+ *
+ * Hosts a Lua state that requires the base32 module, runs its functions on
+ * each input and aborts if a result differs from the reference
+ * implementation of b32ref.c, including the text of the error messages with
+ * the illegal characters and their positions. The control bytes are those
+ * of fuzz/fuzz_base32.c, so that both fuzzers share a corpus:
+ *
+ *   byte 0: bits 0-1  number of threads - 1, with a parallel threshold of 0
+ *           bit 2     Crockford's Base32 instead of RFC 4648
+ *   byte 1: seed of the slice size of base32.set_yield, of the chunks fed to
+ *           the encoders and the decoders, and of the layout of the batches
+ *
+ * The module is linked in and registered in package.preload, so that its
+ * code is instrumented; the modules it requires are found in LUA_PATH and
+ * LUA_CPATH. Built with -fsanitize=fuzzer, LLVMFuzzerTestOneInput() is the
+ * libFuzzer entry point; linked with fuzz/replay.c, it runs the files given
+ * to main().
+ */
+
+#include "b32ref.h"
+#include "base32.h"
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+// include system headers
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONF_THREADS   0x3
+#define CONF_CROCKFORD 0x4
+
+// Registry key of the function that runs a call in a coroutine
+#define RESUME_KEY "fuzz.resume"
+// Start of the message of an illegal character, up to the quoted character
+#define ILLEGAL "Illegal character in Base32 string: '"
+
+// Result of the reference implementation for an input
+typedef struct {
+    int decode;
+    int fmt;
+    ptrdiff_t rv;
+    size_t errpos;
+    const char *out;
+} expect_t;
+
+int luaopen_base32(lua_State *L);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Call fn(...) in a coroutine resumed until it returns, and return its two
+// results and the number of times it yielded
+static const char RESUME[] =
+    "local co = coroutine.create((...))\n"
+    "local ok, res, err = coroutine.resume(co, select(2, ...))\n"
+    "local n = 0\n"
+    "while ok and coroutine.status(co) == 'suspended' do\n"
+    "    n = n + 1\n"
+    "    ok, res, err = coroutine.resume(co)\n"
+    "end\n"
+    "if not ok then\n"
+    "    error(res, 0)\n"
+    "end\n"
+    "return res, err, n\n";
+
+static void fail(const expect_t *x, const char *engine, const char *msg, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "fuzz: %s %s (%s): ", x->decode ? "decode" : "encode",
+            engine, x->fmt == B32_RFC ? "rfc" : "crockford");
+    va_start(ap, msg);
+    vfprintf(stderr, msg, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    abort();
+}
+
+static void *xmalloc(size_t len)
+{
+    void *p = malloc(len ? len : 1);
+
+    if (!p) {
+        perror("fuzz: malloc");
+        abort();
+    }
+    return p;
+}
+
+// xorshift32
+static uint32_t next_rand(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+// Length of the list at index `idx`
+static inline size_t rawlen(lua_State *L, int idx)
+{
+#if LUA_VERSION_NUM >= 502
+    return (size_t)lua_rawlen(L, idx);
+#else
+    return lua_objlen(L, idx);
+#endif
+}
+
+static size_t maxlen(const expect_t *x, size_t srclen)
+{
+    return x->decode ? b32_decoded_maxlen(srclen) :
+                       b32_encoded_len(srclen, x->fmt);
+}
+
+/**
+ * @brief Compute the reference result of converting `src`.
+ *
+ * `x->decode` and `x->fmt` must be set; the output buffer is allocated.
+ */
+static void expect(expect_t *x, const char *src, size_t len)
+{
+    char *out = xmalloc(maxlen(x, len));
+
+    if (x->decode) {
+        x->rv = ref_decode((uint8_t *)out, src, len, x->fmt, &x->errpos);
+    } else {
+        x->rv = (ptrdiff_t)ref_encode(out, (const uint8_t *)src, len, x->fmt);
+    }
+    x->out = out;
+}
+
+/**
+ * @brief Call the function below `nargs` arguments on the stack, and abort
+ * if it raises an error.
+ */
+static void call(lua_State *L, const char *name, int nargs, int nresults)
+{
+    if (lua_pcall(L, nargs, nresults, 0) != 0) {
+        fprintf(stderr, "fuzz: %s raised an error: %s\n", name,
+                lua_tostring(L, -1));
+        abort();
+    }
+}
+
+// Push base32[name]
+static void pushfn(lua_State *L, const char *name)
+{
+    lua_getglobal(L, "base32");
+    lua_getfield(L, -1, name);
+    lua_remove(L, -2);
+}
+
+static void pushformat(lua_State *L, const expect_t *x)
+{
+    lua_pushstring(L, x->fmt == B32_RFC ? "rfc" : "crockford");
+}
+
+// Replace the value at the top of the stack with tostring(value)
+static const char *tostr(lua_State *L)
+{
+    lua_getglobal(L, "tostring");
+    lua_insert(L, -2);
+    lua_call(L, 1, 1);
+    return lua_tostring(L, -1);
+}
+
+/**
+ * @brief Format the message of the error object that the module returns for
+ * the reference result of decoding `src`, as decode_error() of src/base32.c
+ * does; `item` is the 1-based index of a batch item, or 0.
+ */
+static void errmsg(char *buf, size_t size, const expect_t *x, const char *src,
+                   size_t item)
+{
+    int len         = 0;
+    unsigned char c = 0;
+
+    if (item) {
+        len = snprintf(buf, size, "item #%d: ", (int)item);
+    }
+    switch (x->rv) {
+    case B32_ELENGTH:
+        snprintf(buf + len, size - len,
+                 "RFC 4648 Base32 requires input length to be a multiple of "
+                 "8");
+        break;
+
+    case B32_EPADDING:
+        snprintf(buf + len, size - len,
+                 "RFC 4648 Base32 padding length must be 0, 1, 3, 4, or 6");
+        break;
+
+    default:
+        c = (unsigned char)src[x->errpos];
+        snprintf(buf + len, size - len, ILLEGAL "%c' (0x%02X) at position %zu",
+                 c, c, x->errpos + 1);
+    }
+}
+
+/**
+ * @brief Compare the result and the error object at the top of the stack
+ * with the reference for `src`, and pop them.
+ */
+static void check(lua_State *L, const expect_t *x, const char *engine,
+                  const char *src, size_t item)
+{
+    size_t len      = 0;
+    const char *res = lua_tolstring(L, -2, &len);
+    char want[256]  = {0};
+
+    if (x->rv >= 0 && !res) {
+        fail(x, engine, "failed with \"%s\"", tostr(L));
+    } else if (x->rv >= 0 &&
+               (len != (size_t)x->rv || memcmp(res, x->out, len) != 0)) {
+        fail(x, engine, "output differs");
+    } else if (x->rv < 0) {
+        errmsg(want, sizeof(want), x, src, item);
+        if (res) {
+            fail(x, engine, "returned a string, expected \"%s\"", want);
+        } else if (!strstr(tostr(L), want)) {
+            fail(x, engine, "returned \"%s\", expected \"%s\"",
+                 lua_tostring(L, -1), want);
+        }
+    }
+    lua_pop(L, 2);
+}
+
+/**
+ * @brief Compare the result of a single-pass decoder with the reference.
+ *
+ * The decoder does not see the whole string before the end, so it may report
+ * an illegal character instead of the length or padding error of the
+ * reference; the character must then be the one of `src` at the reported
+ * position. A NUL character ends the message after the quote.
+ */
+static void check_single_pass(lua_State *L, const expect_t *x,
+                              const char *engine, const char *src,
+                              size_t len)
+{
+    const char *msg = NULL;
+    const char *p   = NULL;
+    unsigned int c  = 0;
+    size_t pos      = 0;
+
+    if (lua_isnil(L, -2) && (x->rv == B32_ELENGTH || x->rv == B32_EPADDING)) {
+        msg = tostr(L);
+        p   = strstr(msg, ILLEGAL);
+        if (p && (p[strlen(ILLEGAL)] == '\0' ?
+                      memchr(src, 0, len) != NULL :
+                      sscanf(p + strlen(ILLEGAL) + 1,
+                             "' (0x%2X) at position %zu", &c, &pos) == 2 &&
+                          pos > 0 && pos <= len &&
+                          (unsigned char)src[pos - 1] == c)) {
+            lua_pop(L, 2);
+            return;
+        } else if (p) {
+            fail(x, engine, "illegal character of \"%s\" does not match",
+                 msg);
+        }
+    }
+    check(L, x, engine, src, 0);
+}
+
+/**
+ * @brief Run base32.encode or base32.decode on the main thread, which
+ * converts up to TINY_MAX bytes in a buffer on the C stack, and longer
+ * strings with the threads.
+ */
+static void run_whole(lua_State *L, const expect_t *x, const char *src,
+                      size_t len)
+{
+    pushfn(L, x->decode ? "decode" : "encode");
+    lua_pushlstring(L, src, len);
+    pushformat(L, x);
+    call(L, "base32.encode/decode", 2, 2);
+    check(L, x, "whole", src, 0);
+}
+
+/**
+ * @brief Run base32.encode or base32.decode in a coroutine that yields
+ * between slices of a random size, and check the number of slices.
+ */
+static void run_yield(lua_State *L, const expect_t *x, const char *src,
+                      size_t len, uint32_t *rng)
+{
+#if LUA_VERSION_NUM >= 502
+    size_t slice  = 1 + next_rand(rng) % 64;
+    // the slices of the encoder are rounded up to a quantum
+    size_t step   = x->decode ? slice : (slice + 4) / 5 * 5;
+    size_t nslice = len > slice ? (len + step - 1) / step : 1;
+    size_t nyield = 0;
+
+    pushfn(L, "set_yield");
+    lua_pushinteger(L, (lua_Integer)slice);
+    call(L, "base32.set_yield", 1, 0);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, RESUME_KEY);
+    pushfn(L, x->decode ? "decode" : "encode");
+    lua_pushlstring(L, src, len);
+    pushformat(L, x);
+    call(L, "coroutine", 3, 3);
+    nyield = (size_t)lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    check(L, x, "yield", src, 0);
+
+    // a string is checked before the first slice, and the illegal
+    // characters end the call in any slice
+    if (x->rv == B32_ELENGTH || x->rv == B32_EPADDING ?
+            nyield != 0 :
+            (x->rv >= 0 ? nyield != nslice - 1 : nyield > nslice - 1)) {
+        fail(x, "yield", "yielded %zu times in %zu slices of %zu bytes",
+             nyield, nslice, slice);
+    }
+
+    pushfn(L, "set_yield");
+    lua_pushinteger(L, 0);
+    call(L, "base32.set_yield", 1, 0);
+#else
+    (void)L;
+    (void)x;
+    (void)src;
+    (void)len;
+    (void)rng;
+#endif
+}
+
+// Push base32.encoder(format, {state = <value at the top>}) in place of the
+// state
+static void import_state(lua_State *L, const expect_t *x)
+{
+    pushfn(L, x->decode ? "decoder" : "encoder");
+    pushformat(L, x);
+    lua_createtable(L, 0, 1);
+    lua_pushvalue(L, -4);
+    lua_setfield(L, -2, "state");
+    call(L, "base32.encoder/decoder", 2, 2);
+    if (lua_isnil(L, -2)) {
+        fail(x, "import", "cannot import the state: %s", tostr(L));
+    }
+    lua_pop(L, 1);
+    lua_remove(L, -2);
+}
+
+/**
+ * @brief Feed base32.encoder or base32.decoder with `src` in random chunks,
+ * moving its state to a new object through :export() at random points.
+ *
+ * The decoder reports the illegal characters with their position in the
+ * whole string, picking the character from the current chunk or, for a
+ * misplaced padding character, from a previous one.
+ */
+static void run_object(lua_State *L, const expect_t *x, const char *src,
+                       size_t len, uint32_t *rng)
+{
+    char *out  = xmalloc(maxlen(x, len));
+    size_t off = 0;
+    int obj    = 0;
+
+    pushfn(L, x->decode ? "decoder" : "encoder");
+    pushformat(L, x);
+    call(L, "base32.encoder/decoder", 1, 1);
+    if (lua_isnil(L, -1)) {
+        fail(x, "object", "cannot be created");
+    }
+    obj = lua_gettop(L);
+
+    for (size_t pos = 0; pos <= len;) {
+        size_t n        = next_rand(rng) % 17;
+        const char *res = NULL;
+        size_t reslen   = 0;
+
+        if (pos == len) {
+            lua_getfield(L, obj, "finish");
+            lua_pushvalue(L, obj);
+            call(L, "finish", 1, 2);
+            pos++;
+        } else {
+            if (n > len - pos) {
+                n = len - pos;
+            }
+            lua_getfield(L, obj, "update");
+            lua_pushvalue(L, obj);
+            lua_pushlstring(L, src + pos, n);
+            call(L, "update", 2, 2);
+            pos += n;
+        }
+        if (!(res = lua_tolstring(L, -2, &reslen))) {
+            // the error of the whole string, with the result so far
+            check_single_pass(L, x, "object", src, len);
+            lua_pop(L, 1);
+            free(out);
+            return;
+        } else if (off + reslen > maxlen(x, len)) {
+            fail(x, "object", "returned more than %zu bytes", maxlen(x, len));
+        }
+        memcpy(out + off, res, reslen);
+        off += reslen;
+        lua_pop(L, 2);
+
+        if (pos < len && next_rand(rng) % 4 == 0) {
+            lua_getfield(L, obj, "export");
+            lua_pushvalue(L, obj);
+            call(L, "export", 1, 1);
+            import_state(L, x);
+            lua_replace(L, obj);
+        }
+    }
+
+    lua_pushlstring(L, out, off);
+    lua_pushnil(L);
+    check(L, x, "object", src, 0);
+    lua_pop(L, 1);
+    free(out);
+}
+
+/**
+ * @brief Run base32.*_batch() and base32.*_many() on `src` cut into items,
+ * and check that the results are split back into the items of the list.
+ *
+ * Most items have the same random length, so that the multi-buffer kernel
+ * runs them in lockstep; the last part, an empty item and the whole input
+ * follow.
+ */
+static void run_batch(lua_State *L, const expect_t *x, const char *src,
+                      size_t len, uint32_t *rng)
+{
+    static const char *const NAMES[2][2] = {
+        {"encode_batch", "encode_many"},
+        {"decode_batch", "decode_many"},
+    };
+    size_t size    = 1 + next_rand(rng) % 24;
+    size_t nitems  = 0;
+    size_t first   = 0;
+    expect_t *want = NULL;
+    size_t *offs   = NULL;
+
+    if (x->decode && x->fmt == B32_RFC && next_rand(rng) % 2) {
+        // whole quanta, so that the items can be valid strings
+        size *= 8;
+    }
+    nitems = len / size + 3;
+    want   = xmalloc(nitems * sizeof(expect_t));
+    offs   = xmalloc(nitems * sizeof(size_t));
+    lua_createtable(L, (int)nitems, 0);
+    for (size_t i = 0, pos = 0; i < nitems; i++) {
+        size_t n = size;
+        if (i == nitems - 1) {
+            pos = 0;
+            n   = len;
+        } else if (n > len - pos) {
+            n = len - pos;
+        }
+        want[i] = (expect_t){.decode = x->decode, .fmt = x->fmt};
+        offs[i] = pos;
+        expect(&want[i], src + pos, n);
+        if (want[i].rv < 0 && !first) {
+            first = i + 1;
+        }
+        lua_pushlstring(L, src + pos, n);
+        lua_rawseti(L, -2, (int)i + 1);
+        pos += n;
+    }
+
+    for (int many = 0; many < 2; many++) {
+        pushfn(L, NAMES[x->decode][many]);
+        lua_pushvalue(L, -2);
+        pushformat(L, x);
+        call(L, NAMES[x->decode][many], 2, 2);
+        if (first) {
+            // the first item that fails is reported
+            check(L, &want[first - 1], NAMES[x->decode][many],
+                  src + offs[first - 1], first);
+            continue;
+        } else if (!lua_istable(L, -2)) {
+            fail(x, NAMES[x->decode][many], "failed with \"%s\"", tostr(L));
+        } else if (rawlen(L, -2) != nitems) {
+            fail(x, NAMES[x->decode][many], "returned %zu results for %zu items",
+                 rawlen(L, -2), nitems);
+        }
+        lua_pop(L, 1);
+        for (size_t i = 0; i < nitems; i++) {
+            lua_rawgeti(L, -1, (int)i + 1);
+            lua_pushnil(L);
+            check(L, &want[i], NAMES[x->decode][many], src + offs[i], 0);
+        }
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    for (size_t i = 0; i < nitems; i++) {
+        free((void *)want[i].out);
+    }
+    free(want);
+    free(offs);
+}
+
+static lua_State *new_state(void)
+{
+    lua_State *L = luaL_newstate();
+
+    if (!L) {
+        fputs("fuzz: cannot create a Lua state\n", stderr);
+        abort();
+    }
+    luaL_openlibs(L);
+    // require() finds the linked module before the search paths
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "preload");
+    lua_pushcfunction(L, luaopen_base32);
+    lua_setfield(L, -2, "base32");
+    lua_pop(L, 2);
+    lua_getglobal(L, "require");
+    lua_pushliteral(L, "base32");
+    call(L, "require", 1, 1);
+    lua_setglobal(L, "base32");
+
+    if (luaL_loadbuffer(L, RESUME, sizeof(RESUME) - 1, "=resume") != 0) {
+        fprintf(stderr, "fuzz: %s\n", lua_tostring(L, -1));
+        abort();
+    }
+    lua_setfield(L, LUA_REGISTRYINDEX, RESUME_KEY);
+    return L;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static lua_State *L = NULL;
+    const char *src     = (const char *)data + 2;
+    size_t len          = size - 2;
+    uint32_t rng        = 0;
+
+    if (size < 2) {
+        return 0;
+    } else if (!L) {
+        L = new_state();
+    }
+    pushfn(L, "set_threads");
+    lua_pushinteger(L, (data[0] & CONF_THREADS) + 1);
+    lua_pushinteger(L, 0);
+    call(L, "base32.set_threads", 2, 0);
+
+    for (int decode = 0; decode < 2; decode++) {
+        expect_t x = {
+            .decode = decode,
+            .fmt    = data[0] & CONF_CROCKFORD ? B32_CROCKFORD : B32_RFC,
+        };
+        // the same slices and splits for every input with the same seed
+        rng = 0x9E3779B9u ^ data[1];
+        expect(&x, src, len);
+        run_whole(L, &x, src, len);
+        run_yield(L, &x, src, len, &rng);
+        run_object(L, &x, src, len, &rng);
+        run_batch(L, &x, src, len, &rng);
+        free((void *)x.out);
+    }
+    lua_settop(L, 0);
+    return 0;
+}
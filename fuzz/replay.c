@@ -0,0 +1,113 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Replay driver of the fuzzers
+ *
+ * Runs the LLVMFuzzerTestOneInput() of the fuzzer it is linked with on the
+ * files and the directories given as arguments, or on the standard input
+ * without arguments, which is how AFL runs a target. It builds the fuzzers
+ * without clang, e.g. to run the corpus as a regression test.
+ */
+
+// include system headers
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static int run_path(const char *path)
+{
+    FILE *fp      = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    uint8_t *data = NULL;
+    size_t size   = 0;
+    size_t cap    = 0;
+
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    do {
+        if (size == cap) {
+            cap  = cap ? cap * 2 : 4096;
+            data = realloc(data, cap);
+            if (!data) {
+                perror("fuzz: realloc");
+                abort();
+            }
+        }
+        size += fread(data + size, 1, cap - size, fp);
+    } while (size == cap);
+    if (fp != stdin) {
+        fclose(fp);
+    }
+
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+    return 1;
+}
+
+static int run_dir(const char *path)
+{
+    DIR *dir         = opendir(path);
+    struct dirent *e = NULL;
+    char buf[4096];
+    int n            = 0;
+
+    if (!dir) {
+        perror(path);
+        return -1;
+    }
+    while ((e = readdir(dir))) {
+        if (e->d_name[0] != '.') {
+            snprintf(buf, sizeof(buf), "%s/%s", path, e->d_name);
+            n += run_path(buf) > 0;
+        }
+    }
+    closedir(dir);
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    struct stat st;
+    int n = 0;
+
+    if (argc < 2) {
+        n = run_path("-");
+    }
+    for (int i = 1; i < argc; i++) {
+        int rv = stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode) ?
+                     run_dir(argv[i]) :
+                     run_path(argv[i]);
+        if (rv < 0) {
+            return EXIT_FAILURE;
+        }
+        n += rv;
+    }
+    fprintf(stderr, "fuzz: %d inputs passed\n", n);
+    return EXIT_SUCCESS;
+}
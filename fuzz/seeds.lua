@@ -0,0 +1,48 @@
+#!/usr/bin/env lua
+--
+-- Write the seed corpus of the differential fuzzer
+--
+--   lua fuzz/seeds.lua test/base32_test.lua fuzz/corpus
+--
+-- Every double-quoted string literal of the test file becomes an input: the
+-- test vectors and the invalid strings of the error cases, as well as some
+-- messages, which are harmless seeds. Each literal is written for both
+-- formats, with the control bytes described in fuzz/fuzz_base32.c.
+--
+local format = string.format
+
+local function main(args)
+    if #args < 2 then
+        io.stderr:write("usage: lua fuzz/seeds.lua TESTFILE CORPUSDIR\n")
+        return 2
+    end
+    local f = assert(io.open(args[1], "r"))
+    local src = f:read("*a")
+    f:close()
+
+    local seen = {}
+    local nlit = 0
+    local n = 0
+    for s in src:gmatch('"([^"\\\n]*)"') do
+        if not seen[s] then
+            seen[s] = true
+            nlit = nlit + 1
+            for _, fmt in ipairs({
+                0,
+                4,
+            }) do
+                -- 1 to 4 threads in turn, and the file engines every 8 seeds
+                local conf = fmt + nlit % 4 + (nlit % 8 == 0 and 8 or 0)
+                local path = format("%s/seed-%04d", args[2], n)
+                local out = assert(io.open(path, "wb"))
+                out:write(string.char(conf, nlit % 256), s)
+                out:close()
+                n = n + 1
+            end
+        end
+    end
+    print(format("%d seeds written to %s", n, args[2]))
+    return 0
+end
+
+os.exit(main(arg or {}))
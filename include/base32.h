@@ -0,0 +1,287 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef base32_h
+#define base32_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * libbase32
+ *
+ * The Lua-independent Base32 codec used by the base32 Lua module. The
+ * functions write into a caller-provided buffer and return the number of
+ * bytes written, or one of the negative B32_E* error codes. They are also
+ * exported from the Lua module itself, so they can be called through the
+ * LuaJIT FFI (see lib/base32/ffi.lua).
+ */
+
+// Base32 formats
+enum {
+    B32_RFC       = 0,
+    B32_CROCKFORD = 1,
+};
+
+// Error codes
+enum {
+    B32_EINVAL    = -1, // invalid argument (unknown format or flags)
+    B32_ENOBUFS   = -2, // output buffer is too small
+    B32_ELENGTH   = -3, // RFC 4648 input length is not a multiple of 8
+    B32_EPADDING  = -4, // RFC 4648 padding length is not 0, 1, 3, 4, or 6
+    B32_EILSEQ    = -5, // illegal character in input
+    B32_ECANCELED = -6, // asynchronous conversion was canceled
+    B32_ESYS      = -7, // system resource allocation failed; see errno
+};
+
+// Flags
+enum {
+    // process the input on the calling thread regardless of b32_set_threads()
+    B32_NOTHREADS   = 0x1,
+    // read and write files through a pipeline of buffers instead of mapping
+    // them, with io_uring on Linux when it is available
+    B32_PIPELINE    = 0x2,
+    // with B32_PIPELINE, use blocking reads and writes instead of io_uring
+    B32_NOURING     = 0x4,
+    // use the scalar or the block kernel regardless of the input length and
+    // b32_set_tuning(); for benchmarks and tests
+    B32_SCALAR      = 0x8,
+    B32_BLOCK       = 0x10,
+    // encode with the block kernel and non-temporal stores regardless of the
+    // input length; decoding uses the block kernel with cached stores
+    B32_NONTEMPORAL = 0x20,
+};
+
+// Default minimum input length for the parallel path (4 MiB)
+#define B32_PARALLEL_THRESHOLD    (4 * 1024 * 1024)
+// Maximum number of threads for the parallel path
+#define B32_MAX_THREADS           256
+// Default minimum input length for the block kernels
+#define B32_BLOCK_THRESHOLD       64
+// Default minimum input length for the non-temporal stores (32 MiB)
+#define B32_NONTEMPORAL_THRESHOLD (32 * 1024 * 1024)
+// Maximum buffer size of b32_encode_stream() and b32_decode_stream() (1 GiB)
+#define B32_STREAM_MAX_BUFSIZE    (1024 * 1024 * 1024)
+
+// Set the number of threads used for inputs of at least `threshold` bytes.
+void b32_set_threads(int n, size_t threshold);
+
+// Get the number of threads and the parallel threshold.
+int b32_get_threads(size_t *threshold);
+
+// Dispatch thresholds of b32_encode() and b32_decode()
+typedef struct {
+    // minimum input length in bytes for the block encoding kernel
+    size_t encode_block;
+    // minimum input length in characters for the block decoding kernel
+    size_t decode_block;
+    // minimum input length for the parallel path (see b32_set_threads)
+    size_t parallel;
+    // minimum input length in bytes for writing the encoded string with
+    // non-temporal stores, on CPUs that have them
+    size_t nontemporal;
+} b32_tuning_t;
+
+// Set the dispatch thresholds.
+void b32_set_tuning(const b32_tuning_t *t);
+
+// Get the dispatch thresholds.
+void b32_get_tuning(b32_tuning_t *t);
+
+// Measure the kernels on this CPU, set the thresholds and return them in `t`.
+int b32_calibrate(b32_tuning_t *t);
+
+// Write the thresholds `t` to the file `path`.
+int b32_save_tuning(const char *path, const b32_tuning_t *t);
+
+// Read the thresholds written by b32_save_tuning() from the file `path`.
+int b32_load_tuning(const char *path, b32_tuning_t *t);
+
+// Return the length of the Base32 encoded string of `srclen` bytes.
+size_t b32_encoded_len(size_t srclen, int fmt);
+
+// Return the upper bound of the decoded length of `srclen` characters.
+size_t b32_decoded_maxlen(size_t srclen);
+
+// Encode `srclen` bytes of `src` into `dst`.
+ptrdiff_t b32_encode(char *dst, size_t dstlen, const void *src, size_t srclen,
+                     int fmt, int flags);
+
+// Decode `srclen` characters of `src` into `dst`.
+ptrdiff_t b32_decode(void *dst, size_t dstlen, const char *src, size_t srclen,
+                     int fmt, int flags, size_t *errpos);
+
+// Encode the file `inpath` into the file `outpath` through memory mappings,
+// or through a pipeline of buffers with B32_PIPELINE. The output must be
+// another file than the input.
+ptrdiff_t b32_encode_file(const char *inpath, const char *outpath, int fmt,
+                          int flags);
+
+// Decode the file `inpath` into the file `outpath` through memory mappings,
+// or through a pipeline of buffers with B32_PIPELINE. The output must be
+// another file than the input.
+ptrdiff_t b32_decode_file(const char *inpath, const char *outpath, int fmt,
+                          int flags, size_t *errpos, int *errc);
+
+// Encode the stream `in` into the stream `out` with bounded memory.
+ptrdiff_t b32_encode_stream(FILE *in, FILE *out, int fmt, size_t bufsize);
+
+// Decode the stream `in` into the stream `out` with bounded memory.
+ptrdiff_t b32_decode_stream(FILE *in, FILE *out, int fmt, size_t bufsize,
+                            size_t *errpos, int *errc);
+
+// Check that `src` is valid and return the exact decoded length.
+ptrdiff_t b32_validate(const char *src, size_t srclen, int fmt, size_t *errpos);
+
+// Incremental encoder state
+typedef struct {
+    // bytes of the incomplete quantum
+    unsigned char buf[5];
+    size_t nbuf;
+    // number of bytes consumed
+    size_t pos;
+    int fmt;
+} b32_encoder_t;
+
+// Initialize an encoder for `fmt`.
+int b32_encoder_init(b32_encoder_t *e, int fmt);
+
+// Return the number of characters encoded from the next `srclen` bytes.
+size_t b32_encoder_outlen(const b32_encoder_t *e, size_t srclen);
+
+// Encode the next `srclen` bytes of the input.
+ptrdiff_t b32_encoder_update(b32_encoder_t *e, char *dst, size_t dstlen,
+                             const void *src, size_t srclen);
+
+// Write the remaining bytes with padding, and reset the encoder.
+ptrdiff_t b32_encoder_final(b32_encoder_t *e, char *dst, size_t dstlen);
+
+// Check the length and the padding of a complete Base32 encoded string.
+int b32_decode_check(const char *src, size_t srclen, int fmt);
+
+// Incremental decoder state
+typedef struct {
+    // bits of the incomplete quantum
+    uint64_t acc;
+    // number of characters consumed
+    size_t pos;
+    // number and position of the trailing padding characters seen so far
+    size_t npad;
+    size_t padpos;
+    int fmt;
+    int nbits;
+} b32_decoder_t;
+
+// Initialize a decoder for `fmt`.
+int b32_decoder_init(b32_decoder_t *d, int fmt);
+
+// Return the maximum number of bytes decoded from the next `srclen` characters.
+size_t b32_decoder_outlen(const b32_decoder_t *d, size_t srclen);
+
+// Decode the next `srclen` characters of a Base32 encoded string.
+ptrdiff_t b32_decoder_update(b32_decoder_t *d, void *dst, size_t dstlen,
+                             const char *src, size_t srclen, size_t *errpos);
+
+// Check the total length and padding, write the remaining bytes, and reset
+// the decoder.
+ptrdiff_t b32_decoder_final(b32_decoder_t *d, void *dst, size_t dstlen);
+
+// Maximum length of a serialized encoder or decoder state
+#define B32_STATE_MAXLEN 64
+
+// Serialize the state of an encoder into `buf` and return its length.
+size_t b32_encoder_export(const b32_encoder_t *e, void *buf);
+
+// Restore the state of an encoder serialized by b32_encoder_export().
+int b32_encoder_import(b32_encoder_t *e, const void *buf, size_t len);
+
+// Serialize the state of a decoder into `buf` and return its length.
+size_t b32_decoder_export(const b32_decoder_t *d, void *buf);
+
+// Restore the state of a decoder serialized by b32_decoder_export().
+int b32_decoder_import(b32_decoder_t *d, const void *buf, size_t len);
+
+// An entry of a batch
+typedef struct {
+    // input
+    const char *src;
+    size_t srclen;
+    // output buffer
+    char *dst;
+    size_t dstlen;
+    // result of b32_encode()/b32_decode() and the error position
+    ptrdiff_t rv;
+    size_t errpos;
+} b32_item_t;
+
+// Encode every item of a batch, spreading the items over the threads.
+void b32_encode_batch(b32_item_t *items, size_t nitems, int fmt, int flags);
+
+// Decode every item of a batch, spreading the items over the threads.
+void b32_decode_batch(b32_item_t *items, size_t nitems, int fmt, int flags);
+
+// Encode a batch, running same-length items in lockstep on vector lanes.
+void b32_encode_many(b32_item_t *items, size_t nitems, int fmt, int flags);
+
+// Decode a batch, running same-length items in lockstep on vector lanes.
+void b32_decode_many(b32_item_t *items, size_t nitems, int fmt, int flags);
+
+// Return how b32_decode_many() maps the characters: "avx512", "vector" or
+// "table".
+const char *b32_decode_many_kernel(void);
+
+// An asynchronous conversion running on the worker threads
+typedef struct b32_async_t b32_async_t;
+
+// Start encoding `srclen` bytes of `src` into `dst` on the worker threads.
+int b32_encode_async(b32_async_t **task, char *dst, size_t dstlen,
+                     const void *src, size_t srclen, int fmt);
+
+// Start decoding `srclen` characters of `src` into `dst` on the worker threads.
+int b32_decode_async(b32_async_t **task, void *dst, size_t dstlen,
+                     const char *src, size_t srclen, int fmt);
+
+// Return a file descriptor that becomes readable when `task` is completed.
+int b32_async_fd(const b32_async_t *task);
+
+// Return non-zero if `task` is completed.
+int b32_async_ready(const b32_async_t *task);
+
+// Cancel the chunks of `task` that have not started yet.
+void b32_async_cancel(b32_async_t *task);
+
+// Wait for `task` to complete and return the result of the conversion.
+ptrdiff_t b32_async_wait(b32_async_t *task, size_t *errpos);
+
+// Cancel `task`, wait for its running chunks and release it.
+void b32_async_free(b32_async_t *task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
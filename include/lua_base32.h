@@ -0,0 +1,84 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef lua_base32_h
+#define lua_base32_h
+
+#include "base32.h"
+#include <lua.h>
+
+/*
+ * C API for other Lua C modules
+ *
+ * luaopen_base32 publishes a lua_base32_capi_t in the Lua registry, so that
+ * other C modules can call the codec on raw pointers without going through
+ * the Lua stack:
+ *
+ *   const lua_base32_capi_t *b32 = lua_base32_capi(L);
+ *   if (b32) {
+ *       ptrdiff_t n = b32->encode(dst, dstlen, src, srclen, B32_RFC, 0);
+ *   }
+ *
+ * The struct is versioned and only ever extended at the end; a consumer
+ * compiled against LUA_BASE32_CAPI_VERSION N accepts any version >= N.
+ */
+
+#define LUA_BASE32_CAPI         "base32.capi"
+#define LUA_BASE32_CAPI_VERSION 1
+
+typedef struct {
+    int version;
+    // size oracle
+    size_t (*encoded_len)(size_t srclen, int fmt);
+    size_t (*decoded_maxlen)(size_t srclen);
+    // codec
+    ptrdiff_t (*encode)(char *dst, size_t dstlen, const void *src,
+                        size_t srclen, int fmt, int flags);
+    ptrdiff_t (*decode)(void *dst, size_t dstlen, const char *src,
+                        size_t srclen, int fmt, int flags, size_t *errpos);
+    ptrdiff_t (*validate)(const char *src, size_t srclen, int fmt,
+                          size_t *errpos);
+} lua_base32_capi_t;
+
+/**
+ * @brief Get the C API published by the base32 module.
+ *
+ * The base32 module must have been loaded in `L` by `require "base32"`.
+ *
+ * @param L Lua state
+ * @return const lua_base32_capi_t* Pointer to the C API, or NULL if the module
+ *         is not loaded or is older than LUA_BASE32_CAPI_VERSION
+ */
+static inline const lua_base32_capi_t *lua_base32_capi(lua_State *L)
+{
+    const lua_base32_capi_t *api = NULL;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_BASE32_CAPI);
+    api = (const lua_base32_capi_t *)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if (api && api->version < LUA_BASE32_CAPI_VERSION) {
+        return NULL;
+    }
+    return api;
+}
+
+#endif
@@ -0,0 +1,106 @@
+--
+-- Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a
+-- copy of this software and associated documentation files (the "Software"),
+-- to deal in the Software without restriction, including without limitation
+-- the rights to use, copy, modify, merge, publish, distribute, sublicense,
+-- and/or sell copies of the Software, and to permit persons to whom the
+-- Software is furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+-- THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+-- DEALINGS IN THE SOFTWARE.
+--
+local ffi = require('ffi')
+local tonumber = tonumber
+
+ffi.cdef [[
+size_t b32_encoded_len(size_t srclen, int fmt);
+size_t b32_decoded_maxlen(size_t srclen);
+ptrdiff_t b32_encode(char *dst, size_t dstlen, const void *src, size_t srclen,
+                     int fmt, int flags);
+ptrdiff_t b32_decode(void *dst, size_t dstlen, const char *src, size_t srclen,
+                     int fmt, int flags, size_t *errpos);
+ptrdiff_t b32_validate(const char *src, size_t srclen, int fmt,
+                       size_t *errpos);
+]]
+
+-- load the C symbols from the same shared library as the base32 module
+local C = ffi.load(assert(package.searchpath('base32', package.cpath)))
+
+--- encode encodes srclen bytes of src into dst.
+--- @param dst ffi.cdata* output buffer
+--- @param dstlen integer size of dst
+--- @param src ffi.cdata*|string input data
+--- @param srclen integer length of src
+--- @param fmt integer? RFC (default) or CROCKFORD
+--- @return integer n number of characters written, or a negative error code
+local function encode(dst, dstlen, src, srclen, fmt)
+    return tonumber(C.b32_encode(dst, dstlen, src, srclen, fmt or 0, 0))
+end
+
+--- decode decodes srclen characters of src into dst.
+--- @param dst ffi.cdata* output buffer
+--- @param dstlen integer size of dst
+--- @param src ffi.cdata*|string Base32 encoded string
+--- @param srclen integer length of src
+--- @param fmt integer? RFC (default) or CROCKFORD
+--- @param errpos ffi.cdata*? size_t[1] that receives the 0-based offset of
+--- the illegal character on EILSEQ
+--- @return integer n number of bytes written, or a negative error code
+local function decode(dst, dstlen, src, srclen, fmt, errpos)
+    return tonumber(C.b32_decode(dst, dstlen, src, srclen, fmt or 0, 0, errpos))
+end
+
+--- validate checks that srclen characters of src are valid Base32.
+--- @param src ffi.cdata*|string Base32 encoded string
+--- @param srclen integer length of src
+--- @param fmt integer? RFC (default) or CROCKFORD
+--- @param errpos ffi.cdata*? size_t[1] that receives the 0-based offset of
+--- the illegal character on EILSEQ
+--- @return integer n length of the decoded data, or a negative error code
+local function validate(src, srclen, fmt, errpos)
+    return tonumber(C.b32_validate(src, srclen, fmt or 0, errpos))
+end
+
+--- encoded_len returns the length of the encoded string of srclen bytes.
+--- @param srclen integer
+--- @param fmt integer? RFC (default) or CROCKFORD
+--- @return integer
+local function encoded_len(srclen, fmt)
+    return tonumber(C.b32_encoded_len(srclen, fmt or 0))
+end
+
+--- decoded_maxlen returns the upper bound of the decoded length of srclen
+--- characters.
+--- @param srclen integer
+--- @return integer
+local function decoded_maxlen(srclen)
+    return tonumber(C.b32_decoded_maxlen(srclen))
+end
+
+return {
+    C = C,
+    encode = encode,
+    decode = decode,
+    validate = validate,
+    encoded_len = encoded_len,
+    decoded_maxlen = decoded_maxlen,
+    -- formats
+    RFC = 0,
+    CROCKFORD = 1,
+    -- error codes
+    EINVAL = -1,
+    ENOBUFS = -2,
+    ELENGTH = -3,
+    EPADDING = -4,
+    EILSEQ = -5,
+}
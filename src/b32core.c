@@ -0,0 +1,2244 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "base32.h"
+#include "b32pool.h"
+// include system headers
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__linux__)
+# include <sys/eventfd.h>
+#endif
+#if defined(__x86_64__) && defined(__SSE2__)
+# include <emmintrin.h>
+# define HAVE_STREAM 1
+#endif
+
+// RFC 4648 Base32 Decoding table
+// https://datatracker.ietf.org/doc/html/rfc4648#section-6
+static const uint8_t RFC_DECODE_TABLE[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF,
+
+    // 2-7
+    26, 27, 28, 29, 30, 31,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // A-Z
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+    21, 22, 23, 24, 25,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // a-z
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+    21, 22, 23, 24, 25,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF};
+
+// Crockford's Base32 Decoding table (0xFF means invalid character)
+static const uint8_t CROCKFORD_DECODE_TABLE[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // 0-9
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // A-Z (I=1, L=1, O=0, U=0xFF)
+    10, 11, 12, 13, 14, 15, 16, 17, 1, 18, 19, 1, 20, 21, 0, 22, 23, 24, 25, 26,
+    0xFF, 27, 28, 29, 30, 31,
+
+    //
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+
+    // a-z (i=1, l=1, o=0, u=0xFF)
+    10, 11, 12, 13, 14, 15, 16, 17, 1, 18, 19, 1, 20, 21, 0, 22, 23, 24, 25, 26,
+    0xFF, 27, 28, 29, 30, 31,
+
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, -1};
+
+// RFC 4648 Base32 encoding/decoding
+// https://datatracker.ietf.org/doc/html/rfc4648#section-6
+static const char RFC_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+// Crockford's Base32 alphabet (excluding I, L, O, U)
+static const char CROCKFORD_ALPHABET[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+
+// Number of threads used for large inputs (1 disables the parallel path)
+static int Threads              = 1;
+// Minimum input length for the parallel path
+static size_t ParallelThreshold = B32_PARALLEL_THRESHOLD;
+// Minimum input lengths for the block kernels
+static size_t EncodeBlockMin    = B32_BLOCK_THRESHOLD;
+static size_t DecodeBlockMin    = B32_BLOCK_THRESHOLD;
+// Minimum input length for the non-temporal stores
+static size_t NontemporalMin    = B32_NONTEMPORAL_THRESHOLD;
+
+/**
+ * @brief Set the number of threads used to encode/decode large inputs.
+ *
+ * Worker threads are started lazily on the first parallel call and are never
+ * stopped; lowering the number only leaves the extra workers idle.
+ *
+ * @param n Number of threads including the calling thread (1 to 256)
+ * @param threshold Minimum input length in bytes for the parallel path
+ */
+void b32_set_threads(int n, size_t threshold)
+{
+    if (n < 1) {
+        n = 1;
+    } else if (n > B32_MAX_THREADS) {
+        n = B32_MAX_THREADS;
+    }
+    __atomic_store_n(&Threads, n, __ATOMIC_RELAXED);
+    __atomic_store_n(&ParallelThreshold, threshold, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Get the current parallel settings.
+ *
+ * @param threshold If not NULL, receives the parallel threshold
+ * @return int Number of threads
+ */
+int b32_get_threads(size_t *threshold)
+{
+    if (threshold) {
+        *threshold = __atomic_load_n(&ParallelThreshold, __ATOMIC_RELAXED);
+    }
+    return __atomic_load_n(&Threads, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Set the dispatch thresholds of b32_encode() and b32_decode().
+ *
+ * The thresholds are usually measured by b32_calibrate(). A threshold of
+ * SIZE_MAX disables its path.
+ *
+ * @param t Thresholds
+ */
+void b32_set_tuning(const b32_tuning_t *t)
+{
+    __atomic_store_n(&EncodeBlockMin, t->encode_block, __ATOMIC_RELAXED);
+    __atomic_store_n(&DecodeBlockMin, t->decode_block, __ATOMIC_RELAXED);
+    __atomic_store_n(&ParallelThreshold, t->parallel, __ATOMIC_RELAXED);
+    __atomic_store_n(&NontemporalMin, t->nontemporal, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Get the dispatch thresholds of b32_encode() and b32_decode().
+ *
+ * @param t Receives the thresholds
+ */
+void b32_get_tuning(b32_tuning_t *t)
+{
+    t->encode_block = __atomic_load_n(&EncodeBlockMin, __ATOMIC_RELAXED);
+    t->decode_block = __atomic_load_n(&DecodeBlockMin, __ATOMIC_RELAXED);
+    t->parallel     = __atomic_load_n(&ParallelThreshold, __ATOMIC_RELAXED);
+    t->nontemporal  = __atomic_load_n(&NontemporalMin, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Return the number of threads to use for `len` bytes of input, or 1
+ * if the input should be processed on the calling thread.
+ *
+ * @param len Input length
+ * @param nquanta Number of quanta the input can be split into
+ * @param flags Flags passed to b32_encode/b32_decode
+ * @return size_t Number of threads
+ */
+static inline size_t parallelism(size_t len, size_t nquanta, int flags)
+{
+    size_t n = (size_t)__atomic_load_n(&Threads, __ATOMIC_RELAXED);
+
+    if (n < 2 || (flags & B32_NOTHREADS) ||
+        len < __atomic_load_n(&ParallelThreshold, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+    return n < nquanta ? n : nquanta;
+}
+
+// Flags that select a kernel
+#define KERNEL_FLAGS (B32_SCALAR | B32_BLOCK | B32_NONTEMPORAL)
+
+// Return non-zero if the kernel flags of `flags` contradict each other.
+static inline int bad_kernel(int flags)
+{
+    return (flags & B32_SCALAR) && (flags & (B32_BLOCK | B32_NONTEMPORAL));
+}
+
+/**
+ * @brief Return non-zero if `len` bytes or characters of input should be
+ * processed by the block kernel rather than the scalar one.
+ *
+ * @param len Input length
+ * @param min Minimum input length for the block kernel
+ * @param flags Flags passed to b32_encode/b32_decode
+ * @return int Non-zero for the block kernel
+ */
+static inline int use_block(size_t len, const size_t *min, int flags)
+{
+    if (flags & KERNEL_FLAGS) {
+        return !(flags & B32_SCALAR);
+    }
+    return len >= __atomic_load_n(min, __ATOMIC_RELAXED);
+}
+
+// Encoding kernels
+enum {
+    KERNEL_SCALAR,
+    KERNEL_BLOCK,
+    // the block kernel with non-temporal stores
+    KERNEL_STREAM,
+};
+
+/**
+ * @brief Return the kernel that encodes `len` bytes, of an input of `total`
+ * bytes.
+ *
+ * The non-temporal stores are chosen by the length of the whole input, so
+ * that the chunks of an input encoded in parallel all bypass the caches.
+ */
+static inline int encode_kernel(size_t len, size_t total, int flags)
+{
+#if defined(HAVE_STREAM)
+    if ((flags & B32_NONTEMPORAL) ||
+        (!(flags & KERNEL_FLAGS) &&
+         total >= __atomic_load_n(&NontemporalMin, __ATOMIC_RELAXED))) {
+        return KERNEL_STREAM;
+    }
+#else
+    (void)total;
+#endif
+    return use_block(len, &EncodeBlockMin, flags) ? KERNEL_BLOCK :
+                                                    KERNEL_SCALAR;
+}
+
+/**
+ * @brief Return the length of the Base32 encoded string of `srclen` bytes.
+ *
+ * @param srclen Length of the input data
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @return size_t Length of the encoded string
+ */
+size_t b32_encoded_len(size_t srclen, int fmt)
+{
+    size_t rem = srclen % 5;
+
+    if (fmt == B32_RFC) {
+        // padded to a multiple of 8 characters
+        return (srclen / 5 + (rem != 0)) * 8;
+    }
+    // 8 bits per byte -> 5 bits per character, without padding
+    return srclen / 5 * 8 + (rem * 8 + 4) / 5;
+}
+
+/**
+ * @brief Return the upper bound of the decoded length of `srclen` characters.
+ *
+ * @param srclen Length of the Base32 encoded string
+ * @return size_t Maximum length of the decoded data
+ */
+size_t b32_decoded_maxlen(size_t srclen)
+{
+    // 5 bits per character -> 8 bits per byte
+    return srclen / 8 * 5 + (srclen % 8) * 5 / 8;
+}
+
+/**
+ * @brief Encode `srclen` bytes of `src` into `dst` with the alphabet `tbl`.
+ *
+ * `dst` must have room for the encoded string. When `pad` is non-zero, the
+ * output is padded to a multiple of 8 characters.
+ *
+ * @return size_t Number of characters written
+ */
+static size_t encode_run(char *dst, const uint8_t *src, size_t srclen,
+                         const char *tbl, int pad)
+{
+    const uint8_t *head = src;
+    const uint8_t *tail = head + srclen;
+    char *out           = dst;
+
+    // Process 5 bytes at a time (40 bits -> 8 characters)
+    while ((tail - head) >= 5) {
+        // Load 5 bytes (40 bits)
+        uint64_t acc = ((uint64_t)head[0] << 32) | ((uint64_t)head[1] << 24) |
+                       ((uint64_t)head[2] << 16) | ((uint64_t)head[3] << 8) |
+                       (uint64_t)head[4];
+        // Extract 8 characters (5 bits each)
+        out[0] = tbl[(acc >> 35) & 0x1F];
+        out[1] = tbl[(acc >> 30) & 0x1F];
+        out[2] = tbl[(acc >> 25) & 0x1F];
+        out[3] = tbl[(acc >> 20) & 0x1F];
+        out[4] = tbl[(acc >> 15) & 0x1F];
+        out[5] = tbl[(acc >> 10) & 0x1F];
+        out[6] = tbl[(acc >> 5) & 0x1F];
+        out[7] = tbl[acc & 0x1F];
+        out += 8;  // Move output pointer forward by 8 characters
+        head += 5; // Move source pointer forward by 5 bytes
+    }
+
+    // Handle remaining bytes (1-4 bytes)
+    if (head < tail) {
+        uint32_t acc = 0;
+        int nbits    = 0;
+
+        // Load remaining bytes into accumulator
+        while (head < tail) {
+            acc = (acc << 8) | *head++;
+            nbits += 8;
+        }
+        // Extract all complete 5-bit groups
+        while (nbits >= 5) {
+            nbits -= 5;
+            *out++ = tbl[(acc >> nbits) & 0x1F];
+        }
+        // Handle remaining bits (if any)
+        if (nbits > 0) {
+            *out++ = tbl[(acc << (5 - nbits)) & 0x1F];
+        }
+
+        // Add padding for RFC Base32 format
+        if (pad) {
+            while ((out - dst) % 8 != 0) {
+                *out++ = '=';
+            }
+        }
+    }
+
+    return (size_t)(out - dst);
+}
+
+/*
+ * Block kernels
+ *
+ * The encoding kernel looks up 10 bits at a time in a table of character
+ * pairs and stores each quantum with one 8-byte write, optionally
+ * non-temporal so that huge outputs do not evict the caches of the other
+ * threads and processes. The decoding kernel
+ * looks up the 8 characters of a quantum and checks them with a single
+ * branch, leaving the rest of the input to decode_run() at the first quantum
+ * with a hyphen or an illegal character. They are faster than the scalar
+ * loops on most CPUs once the table is in the cache; b32_calibrate()
+ * measures where.
+ */
+
+// Character pairs of each alphabet, indexed by 10 bits, in memory order
+static uint16_t EncodePairs[2][1024];
+static pthread_once_t EncodePairsOnce = PTHREAD_ONCE_INIT;
+
+static void init_pairs(void)
+{
+    for (int i = 0; i < 1024; i++) {
+        char rfc[2]       = {RFC_ALPHABET[i >> 5], RFC_ALPHABET[i & 0x1F]};
+        char crockford[2] = {CROCKFORD_ALPHABET[i >> 5],
+                             CROCKFORD_ALPHABET[i & 0x1F]};
+
+        memcpy(&EncodePairs[B32_RFC][i], rfc, 2);
+        memcpy(&EncodePairs[B32_CROCKFORD][i], crockford, 2);
+    }
+}
+
+// Store the 8 bytes of `v`, bypassing the caches if `stream` is non-zero.
+static inline void store8(char *dst, uint64_t v, int stream)
+{
+#if defined(HAVE_STREAM)
+    if (stream) {
+        _mm_stream_si64((long long *)(void *)dst, (long long)v);
+        return;
+    }
+#else
+    (void)stream;
+#endif
+    memcpy(dst, &v, 8);
+}
+
+/**
+ * @brief Encode `srclen` bytes of `src` into `dst` with the alphabet `tbl`,
+ * as encode_run() does, with non-temporal stores if `stream` is non-zero.
+ *
+ * @return size_t Number of characters written
+ */
+static size_t encode_block(char *dst, const uint8_t *src, size_t srclen,
+                           const char *tbl, int pad, int stream)
+{
+    const uint16_t *pairs = NULL;
+    char *out             = dst;
+
+    pthread_once(&EncodePairsOnce, init_pairs);
+    pairs = EncodePairs[tbl == CROCKFORD_ALPHABET];
+
+    // 8 bytes are loaded per quantum, so the last quantum is left to
+    // encode_run() with the tail
+    for (; srclen >= 8; srclen -= 5) {
+        uint64_t acc = 0;
+        uint64_t v   = 0;
+
+        memcpy(&acc, src, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        acc = __builtin_bswap64(acc) >> 24;
+        v   = (uint64_t)pairs[(acc >> 30) & 0x3FF] |
+              (uint64_t)pairs[(acc >> 20) & 0x3FF] << 16 |
+              (uint64_t)pairs[(acc >> 10) & 0x3FF] << 32 |
+              (uint64_t)pairs[acc & 0x3FF] << 48;
+#else
+        acc >>= 24;
+        v = (uint64_t)pairs[(acc >> 30) & 0x3FF] << 48 |
+            (uint64_t)pairs[(acc >> 20) & 0x3FF] << 32 |
+            (uint64_t)pairs[(acc >> 10) & 0x3FF] << 16 |
+            (uint64_t)pairs[acc & 0x3FF];
+#endif
+        store8(out, v, stream);
+        out += 8;
+        src += 5;
+    }
+#if defined(HAVE_STREAM)
+    if (stream) {
+        // order the non-temporal stores before the completion of the task
+        _mm_sfence();
+    }
+#endif
+    return (size_t)(out - dst) + encode_run(out, src, srclen, tbl, pad);
+}
+
+// Encode with the kernel `kernel`.
+static inline size_t encode_any(char *dst, const uint8_t *src, size_t srclen,
+                                const char *tbl, int pad, int kernel)
+{
+    if (kernel == KERNEL_SCALAR) {
+        return encode_run(dst, src, srclen, tbl, pad);
+    }
+    return encode_block(dst, src, srclen, tbl, pad, kernel == KERNEL_STREAM);
+}
+
+typedef struct {
+    b32_job_t job;
+    char *dst;
+    const uint8_t *src;
+    size_t srclen;
+    // bytes per task (multiple of 5)
+    size_t chunk;
+    const char *tbl;
+    int pad;
+    int kernel;
+} encode_job_t;
+
+static void encode_task(b32_job_t *job, size_t idx)
+{
+    encode_job_t *j = (encode_job_t *)job;
+    size_t off      = idx * j->chunk;
+    size_t len      = j->srclen - off;
+
+    if (len > j->chunk) {
+        len = j->chunk;
+    }
+    // each chunk starts at a quantum boundary, so its output is independent
+    encode_any(j->dst + off / 5 * 8, j->src + off, len, j->tbl, j->pad,
+               j->kernel);
+}
+
+/**
+ * @brief Encode `srclen` bytes of `src` into `dst`.
+ *
+ * Inputs of at least the parallel threshold are split into quantum-aligned
+ * chunks and encoded by the worker threads, unless B32_NOTHREADS is set.
+ * Inputs, or chunks, of at least the block threshold are encoded by the
+ * block kernel, and inputs of at least the non-temporal threshold are written
+ * with non-temporal stores.
+ *
+ * @param dst Output buffer
+ * @param dstlen Size of the output buffer; must be at least
+ *               b32_encoded_len(srclen, fmt)
+ * @param src Input data
+ * @param srclen Length of the input data
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param flags 0, or B32_NOTHREADS and either B32_SCALAR, or B32_BLOCK
+ *              and/or B32_NONTEMPORAL
+ * @return ptrdiff_t Number of characters written, or a negative error code
+ */
+ptrdiff_t b32_encode(char *dst, size_t dstlen, const void *src, size_t srclen,
+                     int fmt, int flags)
+{
+    const char *tbl = NULL;
+    size_t nthr     = 0;
+
+    // select lookup table based on format
+    switch (fmt) {
+    case B32_RFC:
+        tbl = RFC_ALPHABET;
+        break;
+    case B32_CROCKFORD:
+        tbl = CROCKFORD_ALPHABET;
+        break;
+    default:
+        return B32_EINVAL;
+    }
+    if ((flags & ~(B32_NOTHREADS | KERNEL_FLAGS)) || bad_kernel(flags)) {
+        return B32_EINVAL;
+    } else if (dstlen < b32_encoded_len(srclen, fmt)) {
+        return B32_ENOBUFS;
+    }
+
+    nthr = parallelism(srclen, srclen / 5, flags);
+    if (nthr > 1) {
+        size_t nquanta   = srclen / 5;
+        encode_job_t job = {
+            .job    = {.fn = encode_task},
+            .dst    = dst,
+            .src    = (const uint8_t *)src,
+            .srclen = srclen,
+            .chunk  = (nquanta + nthr - 1) / nthr * 5,
+            .tbl    = tbl,
+            .pad    = fmt == B32_RFC,
+        };
+        job.kernel     = encode_kernel(job.chunk, srclen, flags);
+        job.job.ntasks = (srclen + job.chunk - 1) / job.chunk;
+        b32_pool_run(&job.job, (int)nthr - 1);
+        return (ptrdiff_t)b32_encoded_len(srclen, fmt);
+    }
+
+    return (ptrdiff_t)encode_any(dst, (const uint8_t *)src, srclen, tbl,
+                                 fmt == B32_RFC,
+                                 encode_kernel(srclen, srclen, flags));
+}
+
+/**
+ * @brief Select the decoding table for `fmt` and strip the RFC 4648 padding
+ * characters from the end of `src`.
+ *
+ * @param src Base32 encoded string
+ * @param srclen Length of the string; updated to the length without padding
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param tbl Receives the decoding table
+ * @return int 0 on success, or a negative error code
+ */
+static int decode_prepare(const uint8_t *src, size_t *srclen, int fmt,
+                          const uint8_t **tbl)
+{
+    size_t len = *srclen;
+
+    // select lookup table based on format
+    switch (fmt) {
+    case B32_RFC: {
+        *tbl = RFC_DECODE_TABLE;
+        // RFC 4648 Base32 requires input length to be a multiple of 8
+        if (len % 8 != 0) {
+            return B32_ELENGTH;
+        }
+
+        // remove padding characters
+        int npad = 0;
+        for (; len > 0 && src[len - 1] == '='; len--) {
+            if (++npad > 6) {
+                // RFC 4648 Base32 allows at most 6 padding characters
+                return B32_EPADDING;
+            }
+        }
+        // number of padding characters must be 0, 1, 3, 4, or 6
+        if (npad != 0 && npad != 1 && npad != 3 && npad != 4 && npad != 6) {
+            return B32_EPADDING;
+        }
+        *srclen = len;
+        return 0;
+    }
+
+    case B32_CROCKFORD:
+        *tbl = CROCKFORD_DECODE_TABLE;
+        return 0;
+
+    default:
+        return B32_EINVAL;
+    }
+}
+
+/**
+ * @brief Decode `srclen` characters of `src` into `dst` with the decoding
+ * table `tbl`.
+ *
+ * The padding characters must have been removed by decode_prepare().
+ *
+ * @return ptrdiff_t Number of bytes written, or B32_EILSEQ with the 0-based
+ *         offset of the illegal character in `*errpos`
+ */
+static ptrdiff_t decode_run(uint8_t *dst, const uint8_t *src, size_t srclen,
+                            const uint8_t *tbl, size_t *errpos)
+{
+    uint8_t *out = dst;
+    uint64_t acc = 0;
+    int nbits    = 0;
+
+    for (size_t i = 0; i < srclen; i++) {
+        uint8_t c  = src[i];
+        uint8_t dc = tbl[c];
+
+        // Check if character is valid
+        if (dc > 31) {
+            // In Crockford's Base32, '-' is allowed for readability
+            if (c == '-' && tbl == CROCKFORD_DECODE_TABLE) {
+                continue;
+            }
+            *errpos = i;
+            return B32_EILSEQ;
+        }
+
+        // Add 5 bits to buffer
+        acc = (acc << 5) | dc;
+        nbits += 5;
+
+        // Extract 5 bytes when we have 40 bits
+        if (nbits >= 40) {
+            // Extract 5 bytes (40 bits)
+            out[0] = (acc >> 32) & 0xFF;
+            out[1] = (acc >> 24) & 0xFF;
+            out[2] = (acc >> 16) & 0xFF;
+            out[3] = (acc >> 8) & 0xFF;
+            out[4] = acc & 0xFF;
+            out += 5;
+            acc   = 0;
+            nbits = 0;
+        }
+    }
+
+    // Handle remaining bits (less than 40 bits)
+    while (nbits >= 8) {
+        nbits -= 8;
+        *out++ = (acc >> nbits) & 0xFF;
+    }
+
+    return out - dst;
+}
+
+/**
+ * @brief Decode `srclen` characters of `src` into `dst` with the decoding
+ * table `tbl`, as decode_run() does.
+ *
+ * @return ptrdiff_t Number of bytes written, or B32_EILSEQ with the 0-based
+ *         offset of the illegal character in `*errpos`
+ */
+static ptrdiff_t decode_block(uint8_t *dst, const uint8_t *src, size_t srclen,
+                              const uint8_t *tbl, size_t *errpos)
+{
+    uint8_t *out = dst;
+    size_t i     = 0;
+    ptrdiff_t rv = 0;
+
+    for (; srclen - i >= 8; i += 8) {
+        const uint8_t *p = src + i;
+        uint64_t v[8]    = {tbl[p[0]], tbl[p[1]], tbl[p[2]], tbl[p[3]],
+                            tbl[p[4]], tbl[p[5]], tbl[p[6]], tbl[p[7]]};
+        uint64_t acc     = 0;
+
+        if ((v[0] | v[1] | v[2] | v[3] | v[4] | v[5] | v[6] | v[7]) > 31) {
+            // a hyphen or an illegal character
+            break;
+        }
+        acc    = v[0] << 35 | v[1] << 30 | v[2] << 25 | v[3] << 20 |
+                 v[4] << 15 | v[5] << 10 | v[6] << 5 | v[7];
+        out[0] = (acc >> 32) & 0xFF;
+        out[1] = (acc >> 24) & 0xFF;
+        out[2] = (acc >> 16) & 0xFF;
+        out[3] = (acc >> 8) & 0xFF;
+        out[4] = acc & 0xFF;
+        out += 5;
+    }
+
+    rv = decode_run(out, src + i, srclen - i, tbl, errpos);
+    if (rv < 0) {
+        *errpos += i;
+        return rv;
+    }
+    return out - dst + rv;
+}
+
+// Decode with the block kernel if `block` is non-zero.
+static inline ptrdiff_t decode_any(uint8_t *dst, const uint8_t *src,
+                                   size_t srclen, const uint8_t *tbl,
+                                   size_t *errpos, int block)
+{
+    if (block) {
+        return decode_block(dst, src, srclen, tbl, errpos);
+    }
+    return decode_run(dst, src, srclen, tbl, errpos);
+}
+
+typedef struct {
+    b32_job_t job;
+    uint8_t *dst;
+    const uint8_t *src;
+    size_t srclen;
+    // characters per task (multiple of 8)
+    size_t chunk;
+    // if not NULL, task i decodes the characters [bounds[i], bounds[i + 1])
+    // into dst + outoffs[i] instead of a fixed-size chunk
+    const size_t *bounds;
+    const size_t *outoffs;
+    const uint8_t *tbl;
+    int block;
+    // results
+    size_t errpos;
+    ptrdiff_t lastlen;
+} decode_job_t;
+
+static void decode_task(b32_job_t *job, size_t idx)
+{
+    decode_job_t *j = (decode_job_t *)job;
+    size_t off      = idx * j->chunk;
+    size_t len      = j->srclen - off;
+    uint8_t *out    = j->dst + off / 8 * 5;
+    size_t pos      = 0;
+    ptrdiff_t rv    = 0;
+
+    if (j->bounds) {
+        off = j->bounds[idx];
+        len = j->bounds[idx + 1] - off;
+        out = j->dst + j->outoffs[idx];
+    } else if (len > j->chunk) {
+        len = j->chunk;
+    }
+    rv = decode_any(out, j->src + off, len, j->tbl, &pos, j->block);
+    if (rv == B32_EILSEQ) {
+        // keep the position of the first illegal character in the input
+        size_t cur = __atomic_load_n(&j->errpos, __ATOMIC_RELAXED);
+        pos += off;
+        while (pos < cur &&
+               !__atomic_compare_exchange_n(&j->errpos, &cur, pos, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+        }
+    } else if (idx == job->ntasks - 1) {
+        j->lastlen = rv;
+    }
+}
+
+typedef struct {
+    b32_job_t job;
+    const uint8_t *src;
+    size_t srclen;
+    // characters per task
+    size_t chunk;
+    // number of hyphens in each chunk
+    size_t *counts;
+} count_job_t;
+
+// Count the hyphens in [src, src + len); written so that it vectorizes.
+static size_t count_hyphens(const uint8_t *src, size_t len)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        n += src[i] == '-';
+    }
+    return n;
+}
+
+static void count_task(b32_job_t *job, size_t idx)
+{
+    count_job_t *j = (count_job_t *)job;
+    size_t off     = idx * j->chunk;
+    size_t len     = j->srclen - off;
+
+    if (len > j->chunk) {
+        len = j->chunk;
+    }
+    j->counts[idx] = count_hyphens(j->src + off, len);
+}
+
+/**
+ * @brief Decode `srclen` characters of `src` into `dst` with `nthr` threads.
+ *
+ * The input is split into chunks of the same number of characters. If
+ * `counts` is not NULL, it holds the number of hyphens in each chunk, and the
+ * chunk boundaries are moved forward to the next character that starts a
+ * quantum, so that each chunk decodes into its own range of `dst`. The
+ * chunks are decoded by the block kernel if `flags` or the block threshold
+ * select it.
+ *
+ * @return int 0 on success, or B32_EILSEQ
+ */
+static int decode_parallel(uint8_t *dst, const uint8_t *src, size_t srclen,
+                           const uint8_t *tbl, size_t nthr, int flags,
+                           const size_t *counts, size_t *errpos)
+{
+    size_t bounds[B32_MAX_THREADS + 1]  = {0};
+    size_t outoffs[B32_MAX_THREADS + 1] = {0};
+    size_t nhyphens                     = 0;
+    decode_job_t job                    = {
+        .job    = {.fn = decode_task},
+        .dst    = dst,
+        .src    = src,
+        .srclen = srclen,
+        .chunk  = (srclen / 8 + nthr - 1) / nthr * 8,
+        .tbl    = tbl,
+        .errpos = SIZE_MAX,
+    };
+
+    job.block      = use_block(job.chunk, &DecodeBlockMin, flags);
+    job.job.ntasks = (srclen + job.chunk - 1) / job.chunk;
+    if (counts) {
+        job.bounds  = bounds;
+        job.outoffs = outoffs;
+        for (size_t i = 1; i < job.job.ntasks; i++) {
+            size_t pos   = i * job.chunk;
+            size_t nchar = 0;
+
+            // number of non-hyphen characters before the chunk
+            nhyphens += counts[i - 1];
+            nchar = pos - nhyphens;
+            if (pos < bounds[i - 1]) {
+                // the previous boundary is already past this chunk
+                pos   = bounds[i - 1];
+                nchar = outoffs[i - 1] / 5 * 8;
+            }
+            for (; pos < srclen && nchar % 8 != 0; pos++) {
+                nchar += src[pos] != '-';
+            }
+            if (pos == srclen) {
+                job.job.ntasks = i;
+                break;
+            }
+            bounds[i]  = pos;
+            outoffs[i] = nchar / 8 * 5;
+        }
+        bounds[job.job.ntasks] = srclen;
+    }
+
+    b32_pool_run(&job.job, (int)nthr - 1);
+    if (job.errpos != SIZE_MAX) {
+        *errpos = job.errpos;
+        return B32_EILSEQ;
+    }
+    return 0;
+}
+
+/**
+ * @brief Decode `srclen` characters of `src` into `dst`.
+ *
+ * Inputs of at least the parallel threshold are split into quantum-aligned
+ * chunks and decoded by the worker threads, unless B32_NOTHREADS is set. The
+ * hyphens of Crockford's Base32 strings are counted first, so that the chunk
+ * boundaries can be aligned to the quanta of the output. Inputs, or chunks,
+ * of at least the block threshold are decoded by the block kernel.
+ *
+ * @param dst Output buffer
+ * @param dstlen Size of the output buffer; must be at least
+ *               b32_decoded_maxlen(srclen), or the exact decoded length
+ * @param src Base32 encoded string
+ * @param srclen Length of the Base32 encoded string
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param flags 0, or B32_NOTHREADS and either B32_SCALAR, or B32_BLOCK
+ *              and/or B32_NONTEMPORAL
+ * @param errpos If not NULL, receives the 0-based offset of the illegal
+ *               character on B32_EILSEQ
+ * @return ptrdiff_t Number of bytes written, or a negative error code
+ */
+ptrdiff_t b32_decode(void *dst, size_t dstlen, const char *src, size_t srclen,
+                     int fmt, int flags, size_t *errpos)
+{
+    const uint8_t *s                   = (const uint8_t *)src;
+    const uint8_t *tbl                 = NULL;
+    size_t counts[B32_MAX_THREADS + 1] = {0};
+    size_t nhyphens                    = 0;
+    size_t pos                         = 0;
+    size_t nthr                        = 0;
+    ptrdiff_t rv                       = 0;
+
+    if ((flags & ~(B32_NOTHREADS | KERNEL_FLAGS)) || bad_kernel(flags)) {
+        return B32_EINVAL;
+    }
+
+    rv = decode_prepare(s, &srclen, fmt, &tbl);
+    if (rv != 0) {
+        return rv;
+    }
+
+    nthr = parallelism(srclen, srclen / 8, flags);
+    if (tbl == CROCKFORD_DECODE_TABLE && nthr > 1) {
+        count_job_t job = {
+            .job    = {.fn = count_task},
+            .src    = s,
+            .srclen = srclen,
+            .chunk  = (srclen / 8 + nthr - 1) / nthr * 8,
+            .counts = counts,
+        };
+        job.job.ntasks = (srclen + job.chunk - 1) / job.chunk;
+        b32_pool_run(&job.job, (int)nthr - 1);
+        for (size_t i = 0; i < job.job.ntasks; i++) {
+            nhyphens += counts[i];
+        }
+    } else if (tbl == CROCKFORD_DECODE_TABLE &&
+               dstlen < b32_decoded_maxlen(srclen)) {
+        // hyphens do not produce output
+        nhyphens = count_hyphens(s, srclen);
+    }
+    if (dstlen < b32_decoded_maxlen(srclen - nhyphens)) {
+        return B32_ENOBUFS;
+    }
+
+    if (nthr > 1) {
+        rv = decode_parallel((uint8_t *)dst, s, srclen, tbl, nthr, flags,
+                             nhyphens ? counts : NULL, &pos);
+        if (rv == 0) {
+            rv = (ptrdiff_t)b32_decoded_maxlen(srclen - nhyphens);
+        }
+    } else {
+        rv = decode_any((uint8_t *)dst, s, srclen, tbl, &pos,
+                        use_block(srclen, &DecodeBlockMin, flags));
+    }
+
+    if (rv == B32_EILSEQ && errpos) {
+        *errpos = pos;
+    }
+    return rv;
+}
+
+/*
+ * Incremental encoding
+ *
+ * The encoder writes every complete quantum (5 bytes -> 8 characters) and
+ * keeps the remaining 1-4 bytes until the next call. b32_encoder_final()
+ * encodes them with the same tail and padding rules as b32_encode().
+ */
+
+/**
+ * @brief Initialize an encoder.
+ *
+ * @param e Encoder
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @return int 0 on success, or B32_EINVAL
+ */
+int b32_encoder_init(b32_encoder_t *e, int fmt)
+{
+    if (fmt != B32_RFC && fmt != B32_CROCKFORD) {
+        return B32_EINVAL;
+    }
+    *e = (b32_encoder_t){.fmt = fmt};
+    return 0;
+}
+
+/**
+ * @brief Return the number of characters b32_encoder_update() writes for
+ * `srclen` bytes.
+ */
+size_t b32_encoder_outlen(const b32_encoder_t *e, size_t srclen)
+{
+    return (e->nbuf + srclen) / 5 * 8;
+}
+
+/**
+ * @brief Encode the next `srclen` bytes of the input.
+ *
+ * Large inputs are encoded by the worker threads as by b32_encode().
+ *
+ * @param e Encoder
+ * @param dst Output buffer
+ * @param dstlen Size of the output buffer; must be at least
+ *               b32_encoder_outlen(e, srclen)
+ * @param src Next part of the input
+ * @param srclen Length of the part
+ * @return ptrdiff_t Number of characters written, or a negative error code
+ */
+ptrdiff_t b32_encoder_update(b32_encoder_t *e, char *dst, size_t dstlen,
+                             const void *src, size_t srclen)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    const char *tbl  = e->fmt == B32_RFC ? RFC_ALPHABET : CROCKFORD_ALPHABET;
+    size_t outlen    = b32_encoder_outlen(e, srclen);
+    char *out        = dst;
+    size_t n         = 0;
+
+    if (dstlen < outlen) {
+        return B32_ENOBUFS;
+    }
+    e->pos += srclen;
+
+    // complete the buffered quantum
+    if (e->nbuf) {
+        n = 5 - e->nbuf;
+        if (n > srclen) {
+            n = srclen;
+        }
+        memcpy(e->buf + e->nbuf, s, n);
+        e->nbuf += n;
+        s += n;
+        srclen -= n;
+        if (e->nbuf < 5) {
+            return 0;
+        }
+        out += encode_run(out, e->buf, 5, tbl, 0);
+        e->nbuf = 0;
+    }
+
+    // every complete quantum of the input, then keep the rest
+    n = srclen / 5 * 5;
+    if (n) {
+        out += b32_encode(out, dstlen - (size_t)(out - dst), s, n, e->fmt, 0);
+    }
+    memcpy(e->buf, s + n, srclen - n);
+    e->nbuf = srclen - n;
+    return out - dst;
+}
+
+/**
+ * @brief Finish encoding and write the last 1-4 bytes with padding.
+ *
+ * On success, the encoder is reset and can be used for the next input.
+ *
+ * @param e Encoder
+ * @param dst Output buffer
+ * @param dstlen Size of the output buffer; 8 characters are always enough
+ * @return ptrdiff_t Number of characters written, or a negative error code
+ */
+ptrdiff_t b32_encoder_final(b32_encoder_t *e, char *dst, size_t dstlen)
+{
+    ptrdiff_t rv = b32_encode(dst, dstlen, e->buf, e->nbuf, e->fmt, 0);
+
+    if (rv >= 0) {
+        b32_encoder_init(e, e->fmt);
+    }
+    return rv;
+}
+
+/**
+ * @brief Check the length and the padding of a complete Base32 encoded
+ * string without scanning its characters.
+ *
+ * @param src Base32 encoded string
+ * @param srclen Length of the Base32 encoded string
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @return int 0 if the string can be passed to b32_decoder_update(), or a
+ *         negative error code
+ */
+int b32_decode_check(const char *src, size_t srclen, int fmt)
+{
+    const uint8_t *tbl = NULL;
+    return decode_prepare((const uint8_t *)src, &srclen, fmt, &tbl);
+}
+
+/*
+ * Incremental decoding
+ *
+ * The decoder keeps the bits of an incomplete quantum between calls, so the
+ * input can be split at any position. Padding characters are held back until
+ * the next non-padding character or b32_decoder_final(), which checks the
+ * total length and the padding of RFC 4648 strings.
+ */
+
+/**
+ * @brief Initialize a decoder.
+ *
+ * @param d Decoder
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @return int 0 on success, or B32_EINVAL
+ */
+int b32_decoder_init(b32_decoder_t *d, int fmt)
+{
+    if (fmt != B32_RFC && fmt != B32_CROCKFORD) {
+        return B32_EINVAL;
+    }
+    *d = (b32_decoder_t){.fmt = fmt};
+    return 0;
+}
+
+/**
+ * @brief Return the maximum number of bytes b32_decoder_update() writes for
+ * `srclen` characters.
+ */
+size_t b32_decoder_outlen(const b32_decoder_t *d, size_t srclen)
+{
+    // bytes are written a quantum (8 characters) at a time
+    return (d->nbits / 5 + srclen) / 8 * 5;
+}
+
+/**
+ * @brief Decode the next `srclen` characters of a Base32 encoded string.
+ *
+ * @param d Decoder
+ * @param dst Output buffer
+ * @param dstlen Size of the output buffer; must be at least
+ *               b32_decoder_outlen(d, srclen)
+ * @param src Next part of the Base32 encoded string
+ * @param srclen Length of the part
+ * @param errpos If not NULL, receives the 0-based offset of the illegal
+ *               character from the start of the string on B32_EILSEQ
+ * @return ptrdiff_t Number of bytes written, or a negative error code
+ */
+ptrdiff_t b32_decoder_update(b32_decoder_t *d, void *dst, size_t dstlen,
+                             const char *src, size_t srclen, size_t *errpos)
+{
+    const uint8_t *s   = (const uint8_t *)src;
+    const uint8_t *tbl = d->fmt == B32_RFC ? RFC_DECODE_TABLE :
+                                             CROCKFORD_DECODE_TABLE;
+    uint8_t *out       = dst;
+    uint64_t acc       = d->acc;
+    int nbits          = d->nbits;
+    size_t i           = 0;
+
+    if (dstlen < b32_decoder_outlen(d, srclen)) {
+        return B32_ENOBUFS;
+    }
+
+    for (; i < srclen; i++) {
+        uint8_t c  = s[i];
+        uint8_t dc = tbl[c];
+
+        if (dc > 31) {
+            if (c == '-' && tbl == CROCKFORD_DECODE_TABLE) {
+                continue;
+            } else if (c == '=' && tbl == RFC_DECODE_TABLE) {
+                // padding, unless a non-padding character follows
+                if (d->npad++ == 0) {
+                    d->padpos = d->pos + i;
+                }
+                continue;
+            }
+            goto ILLEGAL;
+        } else if (d->npad) {
+            goto ILLEGAL;
+        }
+
+        acc = (acc << 5) | dc;
+        nbits += 5;
+        if (nbits == 40) {
+            out[0] = (acc >> 32) & 0xFF;
+            out[1] = (acc >> 24) & 0xFF;
+            out[2] = (acc >> 16) & 0xFF;
+            out[3] = (acc >> 8) & 0xFF;
+            out[4] = acc & 0xFF;
+            out += 5;
+            acc   = 0;
+            nbits = 0;
+        }
+    }
+
+    d->acc   = acc;
+    d->nbits = nbits;
+    d->pos += srclen;
+    return out - (uint8_t *)dst;
+
+ILLEGAL:
+    if (d->npad) {
+        // the padding characters are not at the end of the string, so the
+        // first of them is the first illegal character
+        i = d->padpos - d->pos;
+    }
+    if (errpos) {
+        *errpos = d->pos + i;
+    }
+    return B32_EILSEQ;
+}
+
+/**
+ * @brief Finish decoding and write the bytes of the last incomplete quantum.
+ *
+ * On success, the decoder is reset and can be used for the next input.
+ *
+ * @param d Decoder
+ * @param dst Output buffer
+ * @param dstlen Size of the output buffer; 4 bytes are always enough
+ * @return ptrdiff_t Number of bytes written, or a negative error code
+ */
+ptrdiff_t b32_decoder_final(b32_decoder_t *d, void *dst, size_t dstlen)
+{
+    uint8_t *out = dst;
+    int nbits    = d->nbits;
+    int npad     = (int)d->npad;
+
+    if (d->fmt == B32_RFC) {
+        if (d->pos % 8 != 0) {
+            return B32_ELENGTH;
+        } else if (npad != 0 && npad != 1 && npad != 3 && npad != 4 &&
+                   npad != 6) {
+            return B32_EPADDING;
+        }
+    }
+    if (dstlen < (size_t)nbits / 8) {
+        return B32_ENOBUFS;
+    }
+
+    while (nbits >= 8) {
+        nbits -= 8;
+        *out++ = (d->acc >> nbits) & 0xFF;
+    }
+    b32_decoder_init(d, d->fmt);
+    return out - (uint8_t *)dst;
+}
+
+/*
+ * Stream state serialization
+ *
+ * The state of an encoder or a decoder is serialized in a compact,
+ * byte-order independent format:
+ *
+ *   kind ('e' or 'd'), version, format,
+ *   encoder: nbuf, buf[nbuf], pos
+ *   decoder: nbits, acc (nbits / 8 + 1 bytes), pos, npad[, padpos]
+ *
+ * where pos, npad and padpos are unsigned LEB128 varints.
+ */
+
+#define STATE_VERSION 1
+
+static uint8_t *put_varint(uint8_t *p, size_t v)
+{
+    for (; v >= 0x80; v >>= 7) {
+        *p++ = (uint8_t)(v | 0x80);
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+/**
+ * @brief Read a varint from [*p, end).
+ *
+ * @return int 0 on success, or -1 if the varint is truncated or too large
+ */
+static int get_varint(const uint8_t **p, const uint8_t *end, size_t *v)
+{
+    size_t val = 0;
+
+    for (size_t shift = 0; *p < end && shift < sizeof(size_t) * 8;
+         shift += 7) {
+        uint8_t c = *(*p)++;
+        val |= (size_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            *v = val;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Serialize the state of an encoder.
+ *
+ * @param e Encoder
+ * @param buf Output buffer of B32_STATE_MAXLEN bytes
+ * @return size_t Length of the serialized state
+ */
+size_t b32_encoder_export(const b32_encoder_t *e, void *buf)
+{
+    uint8_t *p = buf;
+
+    *p++ = 'e';
+    *p++ = STATE_VERSION;
+    *p++ = (uint8_t)e->fmt;
+    *p++ = (uint8_t)e->nbuf;
+    memcpy(p, e->buf, e->nbuf);
+    p = put_varint(p + e->nbuf, e->pos);
+    return (size_t)(p - (uint8_t *)buf);
+}
+
+/**
+ * @brief Restore the state of an encoder serialized by b32_encoder_export().
+ *
+ * @param e Encoder
+ * @param buf Serialized state
+ * @param len Length of the serialized state
+ * @return int 0 on success, or B32_EINVAL if the state is malformed
+ */
+int b32_encoder_import(b32_encoder_t *e, const void *buf, size_t len)
+{
+    const uint8_t *p   = buf;
+    const uint8_t *end = p + len;
+    b32_encoder_t tmp  = {0};
+
+    if (len < 4 || p[0] != 'e' || p[1] != STATE_VERSION ||
+        b32_encoder_init(&tmp, p[2]) != 0 || p[3] > 4 ||
+        (size_t)(end - p) < 4u + p[3]) {
+        return B32_EINVAL;
+    }
+    tmp.nbuf = p[3];
+    memcpy(tmp.buf, p + 4, tmp.nbuf);
+    p += 4 + tmp.nbuf;
+    // the incomplete quantum holds the bytes after the last complete one
+    if (get_varint(&p, end, &tmp.pos) != 0 || p != end ||
+        tmp.pos % 5 != tmp.nbuf) {
+        return B32_EINVAL;
+    }
+    *e = tmp;
+    return 0;
+}
+
+/**
+ * @brief Serialize the state of a decoder.
+ *
+ * @param d Decoder
+ * @param buf Output buffer of B32_STATE_MAXLEN bytes
+ * @return size_t Length of the serialized state
+ */
+size_t b32_decoder_export(const b32_decoder_t *d, void *buf)
+{
+    uint8_t *p = buf;
+
+    *p++ = 'd';
+    *p++ = STATE_VERSION;
+    *p++ = (uint8_t)d->fmt;
+    *p++ = (uint8_t)d->nbits;
+    // at most 35 bits, in big-endian order
+    for (int i = d->nbits / 8; i >= 0; i--) {
+        *p++ = (uint8_t)(d->acc >> (i * 8));
+    }
+    p = put_varint(p, d->pos);
+    p = put_varint(p, d->npad);
+    if (d->npad) {
+        p = put_varint(p, d->padpos);
+    }
+    return (size_t)(p - (uint8_t *)buf);
+}
+
+/**
+ * @brief Restore the state of a decoder serialized by b32_decoder_export().
+ *
+ * @param d Decoder
+ * @param buf Serialized state
+ * @param len Length of the serialized state
+ * @return int 0 on success, or B32_EINVAL if the state is malformed
+ */
+int b32_decoder_import(b32_decoder_t *d, const void *buf, size_t len)
+{
+    const uint8_t *p   = buf;
+    const uint8_t *end = p + len;
+    b32_decoder_t tmp  = {0};
+
+    if (len < 4 || p[0] != 'd' || p[1] != STATE_VERSION ||
+        b32_decoder_init(&tmp, p[2]) != 0 || p[3] % 5 != 0 || p[3] >= 40 ||
+        (size_t)(end - p) < 5u + p[3] / 8) {
+        return B32_EINVAL;
+    }
+    tmp.nbits = p[3];
+    p += 4;
+    for (int i = tmp.nbits / 8; i >= 0; i--) {
+        tmp.acc = (tmp.acc << 8) | *p++;
+    }
+    if (tmp.acc >> tmp.nbits || get_varint(&p, end, &tmp.pos) != 0 ||
+        get_varint(&p, end, &tmp.npad) != 0 ||
+        // only RFC 4648 strings are padded
+        (tmp.npad && tmp.fmt != B32_RFC) ||
+        (tmp.npad && (get_varint(&p, end, &tmp.padpos) != 0 ||
+                      tmp.padpos + tmp.npad > tmp.pos)) ||
+        p != end) {
+        return B32_EINVAL;
+    }
+    *d = tmp;
+    return 0;
+}
+
+/*
+ * Multi-buffer kernels
+ *
+ * Encode or decode MB_LANES strings of the same length in lockstep, one
+ * string per vector lane. Each lane holds one quantum (40 bits of input or
+ * 8 characters of output) in a 64-bit element, so the bit extraction and the
+ * alphabet mapping run on all lanes at once. The vectors use the GCC/Clang
+ * vector extensions, which are lowered to SSE2/AVX2/AVX-512 on x86 and NEON
+ * on ARM depending on the target flags.
+ *
+ * The decoder maps the characters with range compares: on the bytes of the
+ * 64-bit lanes when the 8 lanes fit in a single AVX-512 register, and
+ * otherwise with the byte compares of SSE2 or NEON, two lanes per 16-byte
+ * vector. Other targets use table lookups.
+ */
+
+#define MB_LANES 8
+#if defined(__AVX512F__)
+# define HAVE_MB_RANGES   1
+# define MB_DECODE_KERNEL "avx512"
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+# define HAVE_MB_BYTES    1
+# define MB_DECODE_KERNEL "vector"
+#else
+# define MB_DECODE_KERNEL "table"
+#endif
+typedef uint64_t mb_vec_t __attribute__((vector_size(MB_LANES * 8)));
+
+typedef union {
+    mb_vec_t v;
+    uint64_t u[MB_LANES];
+    uint8_t b[MB_LANES * 8];
+} mb_reg_t;
+
+// Load 8 bytes as a little-endian integer
+static inline uint64_t mb_load64le(const void *p)
+{
+    uint64_t v = 0;
+    memcpy(&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+// Store a 64-bit integer as 8 little-endian bytes
+static inline void mb_store64le(void *p, uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, 8);
+}
+
+// Load 5 bytes as a big-endian 40-bit integer
+static inline uint64_t mb_load40(const uint8_t *p)
+{
+    return ((uint64_t)p[0] << 32) | ((uint64_t)p[1] << 24) |
+           ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 8) | (uint64_t)p[4];
+}
+
+// Repeat a byte value in every byte of a 64-bit lane
+#define MB_BYTES(b) (0x0101010101010101ULL * (uint64_t)(b))
+// 1 in every byte of `x` that is >= `n`, 0 otherwise (bytes must be < 128)
+#define MB_GE(x, n)   ((((x) + MB_BYTES(0x80 - (n))) >> 7) & MB_BYTES(1))
+// Expand 0/1 bytes to 0x00/0xFF without a multiplication
+#define MB_EXPAND(v)     (((v) << 8) - (v))
+#define MB_MASK(x, n)    MB_EXPAND(MB_GE(x, n))
+// 1 in every byte of `x` that is in [lo, hi], 0 otherwise
+#define MB_IN(x, lo, hi) (MB_GE(x, lo) - MB_GE(x, (hi) + 1))
+
+// Encode the first `nq` quanta of every lane
+static void mb_encode_quanta(b32_item_t *items, size_t nq, int fmt)
+{
+    size_t len = items[0].srclen;
+
+    for (size_t q = 0; q < nq; q++) {
+        mb_reg_t out;
+        mb_vec_t acc, idx;
+        uint64_t w[MB_LANES];
+
+        // load one quantum (40 bits) per lane
+        for (int l = 0; l < MB_LANES; l++) {
+            const uint8_t *p = (const uint8_t *)items[l].src + q * 5;
+            if (q * 5 + 8 <= len) {
+                // read 8 bytes at once and drop the 3 bytes of the next
+                // quantum
+                w[l] = __builtin_bswap64(mb_load64le(p)) >> 24;
+            } else {
+                w[l] = mb_load40(p);
+            }
+        }
+        acc = (mb_vec_t){w[0], w[1], w[2], w[3], w[4], w[5], w[6], w[7]};
+
+        // extract 8 characters (5 bits each) into the bytes of each lane
+        idx = ((acc >> 35) & 0x1F) | (((acc >> 30) & 0x1F) << 8) |
+              (((acc >> 25) & 0x1F) << 16) | (((acc >> 20) & 0x1F) << 24) |
+              (((acc >> 15) & 0x1F) << 32) | (((acc >> 10) & 0x1F) << 40) |
+              (((acc >> 5) & 0x1F) << 48) | ((acc & 0x1F) << 56);
+
+        // map each byte to the alphabet without a table lookup
+        if (fmt == B32_RFC) {
+            // A-Z for 0-25, 2-7 for 26-31
+            out.v = idx + MB_BYTES('A') -
+                    (MB_MASK(idx, 26) & MB_BYTES('A' + 26 - '2'));
+        } else {
+            // 0-9 for 0-9, then skip the gaps before A, J, M, P and V
+            out.v = idx + MB_BYTES('0') +
+                    (MB_MASK(idx, 10) & MB_BYTES('A' - '9' - 1)) +
+                    MB_GE(idx, 18) + MB_GE(idx, 20) + MB_GE(idx, 22) +
+                    MB_GE(idx, 27);
+        }
+
+        for (int l = 0; l < MB_LANES; l++) {
+            mb_store64le(items[l].dst + q * 8, out.u[l]);
+        }
+    }
+}
+
+#if defined(HAVE_MB_RANGES)
+// Map the characters of quantum `q` of every lane to their 5-bit values in
+// `val` with range compares, and set the bytes of `bad` for the other
+// characters
+static inline void mb_decode_chars(const b32_item_t *items, size_t q, int fmt,
+                                   mb_vec_t *val, mb_vec_t *bad)
+{
+    mb_vec_t c, x, v, ok;
+    uint64_t w[MB_LANES];
+
+    for (int l = 0; l < MB_LANES; l++) {
+        w[l] = mb_load64le(items[l].src + q * 8);
+    }
+    c = (mb_vec_t){w[0], w[1], w[2], w[3], w[4], w[5], w[6], w[7]};
+
+    // the bytes are offset by 0x80 so that no subtraction borrows from the
+    // next byte
+    x = c & MB_BYTES(0x7F);
+    x -= MB_IN(x, 'a', 'z') << 5;
+    if (fmt == B32_RFC) {
+        // A-Z for 0-25, 2-7 for 26-31
+        ok = MB_IN(x, 'A', 'Z') | MB_IN(x, '2', '7');
+        v  = x + MB_BYTES(0x80 - 'A') +
+            (MB_EXPAND(MB_IN(x, '2', '7')) & MB_BYTES('A' - '2' + 26));
+    } else {
+        // 0-9 for 0-9, then A-Z without the gaps at I, L, O and U, which are
+        // 1, 1, 0 and invalid
+        ok = MB_IN(x, '0', '9') + MB_IN(x, 'A', 'Z') - MB_IN(x, 'U', 'U');
+        v  = x + MB_BYTES(0x80 - '0') -
+            (MB_MASK(x, 'A') & MB_BYTES('A' - '9' - 1)) - MB_GE(x, 'J') -
+            MB_GE(x, 'M') - MB_GE(x, 'P') - MB_GE(x, 'V');
+        v -= (MB_EXPAND(MB_IN(x, 'I', 'I')) & MB_BYTES(18 - 1)) |
+             (MB_EXPAND(MB_IN(x, 'L', 'L')) & MB_BYTES(20 - 1)) |
+             (MB_EXPAND(MB_IN(x, 'O', 'O')) & MB_BYTES(22 - 0));
+    }
+    *val = v & MB_BYTES(0x1F);
+    *bad |= (ok ^ MB_BYTES(1)) | (c & MB_BYTES(0x80));
+}
+#elif defined(HAVE_MB_BYTES)
+// 16 characters, the widest byte vector of SSE2 and NEON; GCC scalarizes the
+// compares of wider vectors than the target registers
+typedef int8_t mb_bytes_t __attribute__((vector_size(16)));
+typedef uint8_t mb_ubytes_t __attribute__((vector_size(16)));
+
+// Subtract `c` from every byte of `x`, wrapping around like the unsigned
+// bytes; the signed bytes would overflow for the characters from 0x80
+#define MB_SUB(x, c) ((mb_bytes_t)((mb_ubytes_t)(x) - (uint8_t)(c)))
+
+// Map 16 characters to their 5-bit values with byte-wise range compares, and
+// set the bytes of `bad` for the characters outside the alphabet. The bytes
+// are signed, so the characters from 0x80 are below every range.
+static inline mb_bytes_t mb_decode_bytes(mb_bytes_t x, int fmt,
+                                         mb_bytes_t *bad)
+{
+    mb_bytes_t v, ok;
+
+    // each compare yields -1 for true and 0 for false
+    x -= (mb_bytes_t)((x >= 'a') & (x <= 'z')) & 0x20;
+    if (fmt == B32_RFC) {
+        // A-Z for 0-25, 2-7 for 26-31
+        mb_bytes_t alpha = (mb_bytes_t)((x >= 'A') & (x <= 'Z'));
+        mb_bytes_t digit = (mb_bytes_t)((x >= '2') & (x <= '7'));
+        ok               = alpha | digit;
+        v = (MB_SUB(x, 'A') & alpha) | (MB_SUB(x, '2' - 26) & digit);
+    } else {
+        // 0-9 for 0-9, then A-Z without the gaps at I, L, O and U, which are
+        // 1, 1, 0 and invalid
+        mb_bytes_t digit = (mb_bytes_t)((x >= '0') & (x <= '9'));
+        mb_bytes_t alpha = (mb_bytes_t)((x >= 'A') & (x <= 'Z') & (x != 'U'));
+        mb_bytes_t one   = (mb_bytes_t)((x == 'I') | (x == 'L'));
+        mb_bytes_t zero  = (mb_bytes_t)(x == 'O');
+        ok               = digit | alpha;
+        // a true compare adds -1, one for each gap below the character
+        v = (mb_bytes_t)((mb_ubytes_t)x - ('A' - 10) + (mb_ubytes_t)(x > 'I') +
+                         (mb_ubytes_t)(x > 'L') + (mb_ubytes_t)(x > 'O') +
+                         (mb_ubytes_t)(x > 'U'));
+        v = (MB_SUB(x, '0') & digit) | (v & alpha & ~(one | zero)) | (one & 1);
+    }
+    *bad |= ~ok;
+    return v;
+}
+
+// Map the characters of quantum `q` of every lane to their 5-bit values in
+// `val` with range compares, and set the bytes of `bad` for the other
+// characters
+static inline void mb_decode_chars(const b32_item_t *items, size_t q, int fmt,
+                                   mb_vec_t *val, mb_vec_t *bad)
+{
+    mb_bytes_t v[MB_LANES / 2];
+    mb_bytes_t nok = {0};
+    uint64_t u[2];
+    mb_reg_t r;
+
+    // two lanes per vector
+    for (int i = 0; i < MB_LANES / 2; i++) {
+        memcpy(&v[i], items[i * 2].src + q * 8, 8);
+        memcpy((char *)&v[i] + 8, items[i * 2 + 1].src + q * 8, 8);
+        v[i] = mb_decode_bytes(v[i], fmt, &nok);
+    }
+    memcpy(r.b, v, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (int l = 0; l < MB_LANES; l++) {
+        r.u[l] = __builtin_bswap64(r.u[l]);
+    }
+#endif
+    *val = r.v;
+    // a bad character in any lane fails the whole group
+    memcpy(u, &nok, sizeof(u));
+    (*bad)[0] |= u[0] | u[1];
+}
+#else
+// Look up the 5-bit values of the characters of quantum `q` of every lane in
+// `val`, and set the bytes of `bad` for the characters outside the alphabet
+static inline void mb_decode_chars(const b32_item_t *items, size_t q, int fmt,
+                                   mb_vec_t *val, mb_vec_t *bad)
+{
+    const uint8_t *tbl = fmt == B32_RFC ? RFC_DECODE_TABLE :
+                                          CROCKFORD_DECODE_TABLE;
+    mb_reg_t r;
+
+    for (int l = 0; l < MB_LANES; l++) {
+        const uint8_t *p = (const uint8_t *)items[l].src + q * 8;
+        for (int k = 0; k < 8; k++) {
+            r.b[l * 8 + k] = tbl[p[k]];
+        }
+        r.u[l] = mb_load64le(r.b + l * 8);
+    }
+    // valid values are 0-31; the tables use 0xFF for invalid characters
+    *val = r.v;
+    *bad |= r.v & MB_BYTES(0xE0);
+}
+#endif
+
+/**
+ * @brief Decode the first `nq` quanta of every lane.
+ *
+ * @return int 1 on success, 0 if any lane contains a character that is not
+ *         in the alphabet (including Crockford's hyphens)
+ */
+static int mb_decode_quanta(b32_item_t *items, size_t nq, int fmt)
+{
+    mb_vec_t bad = {0};
+
+    for (size_t q = 0; q < nq; q++) {
+        mb_vec_t val, acc;
+
+        mb_decode_chars(items, q, fmt, &val, &bad);
+
+        // merge the 5-bit values of each lane pairwise into 40 bits
+        acc = ((val & 0x00FF00FF00FF00FFULL) << 5) |
+              ((val >> 8) & 0x00FF00FF00FF00FFULL);
+        acc = ((acc & 0x0000FFFF0000FFFFULL) << 10) |
+              ((acc >> 16) & 0x0000FFFF0000FFFFULL);
+        acc = ((acc & 0xFFFFFFFFULL) << 20) | (acc >> 32);
+
+        for (int l = 0; l < MB_LANES; l++) {
+            uint8_t *out = (uint8_t *)items[l].dst + q * 5;
+            out[0]       = (uint8_t)(acc[l] >> 32);
+            out[1]       = (uint8_t)(acc[l] >> 24);
+            out[2]       = (uint8_t)(acc[l] >> 16);
+            out[3]       = (uint8_t)(acc[l] >> 8);
+            out[4]       = (uint8_t)acc[l];
+        }
+    }
+
+    for (int l = 0; l < MB_LANES; l++) {
+        if (bad[l]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Return non-zero if the MB_LANES items at `items` can run in lockstep
+static int mb_same_length(const b32_item_t *items, size_t nitems)
+{
+    if (nitems < MB_LANES) {
+        return 0;
+    }
+    for (int l = 1; l < MB_LANES; l++) {
+        if (items[l].srclen != items[0].srclen) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void mb_encode_group(b32_item_t *items, int fmt)
+{
+    size_t len      = items[0].srclen;
+    size_t nq       = len / 5;
+    const char *tbl = fmt == B32_RFC ? RFC_ALPHABET : CROCKFORD_ALPHABET;
+
+    for (int l = 0; l < MB_LANES; l++) {
+        if (items[l].dstlen < b32_encoded_len(len, fmt)) {
+            // let b32_encode report the error
+            for (l = 0; l < MB_LANES; l++) {
+                items[l].rv = b32_encode(items[l].dst, items[l].dstlen,
+                                         items[l].src, len, fmt, B32_NOTHREADS);
+            }
+            return;
+        }
+    }
+
+    mb_encode_quanta(items, nq, fmt);
+    // encode the remaining 1-4 bytes and the padding of each lane
+    for (int l = 0; l < MB_LANES; l++) {
+        const uint8_t *src = (const uint8_t *)items[l].src + nq * 5;
+        size_t n           = encode_run(items[l].dst + nq * 8, src,
+                                        len - nq * 5, tbl, fmt == B32_RFC);
+        items[l].rv        = (ptrdiff_t)(nq * 8 + n);
+    }
+}
+
+static void mb_decode_group(b32_item_t *items, int fmt)
+{
+    const uint8_t *tbl = NULL;
+    size_t lens[MB_LANES];
+    size_t nq = SIZE_MAX;
+
+    for (int l = 0; l < MB_LANES; l++) {
+        lens[l] = items[l].srclen;
+        if (decode_prepare((const uint8_t *)items[l].src, &lens[l], fmt,
+                           &tbl) != 0 ||
+            items[l].dstlen < b32_decoded_maxlen(lens[l])) {
+            goto FALLBACK;
+        }
+        // padding may differ between lanes
+        if (lens[l] / 8 < nq) {
+            nq = lens[l] / 8;
+        }
+    }
+    if (!mb_decode_quanta(items, nq, fmt)) {
+        goto FALLBACK;
+    }
+
+    // decode the remaining characters of each lane
+    for (int l = 0; l < MB_LANES; l++) {
+        size_t pos   = 0;
+        ptrdiff_t rv = decode_run((uint8_t *)items[l].dst + nq * 5,
+                                  (const uint8_t *)items[l].src + nq * 8,
+                                  lens[l] - nq * 8, tbl, &pos);
+        if (rv < 0) {
+            items[l].errpos = pos + nq * 8;
+            items[l].rv     = rv;
+        } else {
+            items[l].rv = (ptrdiff_t)(nq * 5) + rv;
+        }
+    }
+    return;
+
+FALLBACK:
+    // errors, hyphens and illegal characters are handled by b32_decode
+    for (int l = 0; l < MB_LANES; l++) {
+        items[l].rv = b32_decode(items[l].dst, items[l].dstlen, items[l].src,
+                                 items[l].srclen, fmt, B32_NOTHREADS,
+                                 &items[l].errpos);
+    }
+}
+
+/*
+ * Batches
+ */
+
+// Minimum total input length for running a batch on the worker threads
+#define BATCH_THRESHOLD (64 * 1024)
+// Number of tasks per thread; more tasks keep mixed-size batches balanced
+#define BATCH_TASKS     8
+
+enum {
+    BATCH_ENCODE = 0,
+    BATCH_DECODE,
+    BATCH_ENCODE_MANY,
+    BATCH_DECODE_MANY,
+};
+
+typedef struct {
+    b32_job_t job;
+    b32_item_t *items;
+    size_t nitems;
+    // items per task (multiple of MB_LANES)
+    size_t per;
+    int fmt;
+    int op;
+} batch_job_t;
+
+static void batch_task(b32_job_t *job, size_t idx)
+{
+    batch_job_t *j  = (batch_job_t *)job;
+    b32_item_t *it  = j->items + idx * j->per;
+    b32_item_t *end = it + j->per;
+    int valid_fmt   = j->fmt == B32_RFC || j->fmt == B32_CROCKFORD;
+
+    if (end > j->items + j->nitems) {
+        end = j->items + j->nitems;
+    }
+    while (it < end) {
+        if (j->op == BATCH_ENCODE_MANY && valid_fmt &&
+            mb_same_length(it, end - it)) {
+            mb_encode_group(it, j->fmt);
+            it += MB_LANES;
+        } else if (j->op == BATCH_DECODE_MANY && valid_fmt &&
+                   mb_same_length(it, end - it)) {
+            mb_decode_group(it, j->fmt);
+            it += MB_LANES;
+        } else if (j->op == BATCH_ENCODE || j->op == BATCH_ENCODE_MANY) {
+            it->rv = b32_encode(it->dst, it->dstlen, it->src, it->srclen,
+                                j->fmt, B32_NOTHREADS);
+            it++;
+        } else {
+            it->rv = b32_decode(it->dst, it->dstlen, it->src, it->srclen,
+                                j->fmt, B32_NOTHREADS, &it->errpos);
+            it++;
+        }
+    }
+}
+
+/**
+ * @brief Encode or decode every item of a batch.
+ *
+ * The items are split into tasks of consecutive items. Idle threads claim
+ * the next unclaimed task, so a thread that got small items takes over more
+ * tasks than a thread that got large ones.
+ */
+static void batch_run(b32_item_t *items, size_t nitems, int fmt, int flags,
+                      int op)
+{
+    size_t nthr     = 1;
+    size_t total    = 0;
+    batch_job_t job = {
+        .job    = {.fn = batch_task},
+        .items  = items,
+        .nitems = nitems,
+        .per    = nitems,
+        .fmt    = fmt,
+        .op     = op,
+    };
+
+    if (nitems == 0) {
+        return;
+    } else if (!(flags & B32_NOTHREADS)) {
+        nthr = (size_t)b32_get_threads(NULL);
+        for (size_t i = 0; nthr > 1 && i < nitems; i++) {
+            total += items[i].srclen;
+        }
+        if (total < BATCH_THRESHOLD) {
+            nthr = 1;
+        }
+    }
+
+    if (nthr > 1) {
+        size_t ntasks = nthr * BATCH_TASKS;
+        job.per       = (nitems + ntasks - 1) / ntasks;
+        // keep the lane groups of the multi-buffer kernels within a task
+        job.per = (job.per + MB_LANES - 1) / MB_LANES * MB_LANES;
+    }
+    job.job.ntasks = (nitems + job.per - 1) / job.per;
+    b32_pool_run(&job.job, (int)nthr - 1);
+}
+
+/**
+ * @brief Encode every item of a batch.
+ *
+ * For each item, `src`/`srclen` are encoded into `dst`/`dstlen`, and `rv`
+ * receives the result of b32_encode(). When more than one thread is set by
+ * b32_set_threads() and the batch holds at least 64 KiB of input, the items
+ * are spread over the worker threads.
+ *
+ * @param items Items to encode
+ * @param nitems Number of items
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param flags 0 or B32_NOTHREADS
+ */
+void b32_encode_batch(b32_item_t *items, size_t nitems, int fmt, int flags)
+{
+    batch_run(items, nitems, fmt, flags, BATCH_ENCODE);
+}
+
+/**
+ * @brief Decode every item of a batch.
+ *
+ * Same as b32_encode_batch(), but each item is decoded with b32_decode() and
+ * `errpos` receives the position of an illegal character.
+ *
+ * @param items Items to decode
+ * @param nitems Number of items
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param flags 0 or B32_NOTHREADS
+ */
+void b32_decode_batch(b32_item_t *items, size_t nitems, int fmt, int flags)
+{
+    batch_run(items, nitems, fmt, flags, BATCH_DECODE);
+}
+
+/**
+ * @brief Encode every item of a batch with the multi-buffer kernel.
+ *
+ * Same as b32_encode_batch(), but each run of 8 consecutive items of the
+ * same length is encoded in lockstep, one item per vector lane. Other items
+ * are encoded one by one.
+ *
+ * @param items Items to encode
+ * @param nitems Number of items
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param flags 0 or B32_NOTHREADS
+ */
+void b32_encode_many(b32_item_t *items, size_t nitems, int fmt, int flags)
+{
+    batch_run(items, nitems, fmt, flags, BATCH_ENCODE_MANY);
+}
+
+/**
+ * @brief Decode every item of a batch with the multi-buffer kernel.
+ *
+ * Same as b32_encode_many(), but decodes. A group of lanes that contains an
+ * error or a Crockford hyphen is decoded again one by one with b32_decode(),
+ * so the results and error positions are the same as b32_decode_batch().
+ *
+ * @param items Items to decode
+ * @param nitems Number of items
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param flags 0 or B32_NOTHREADS
+ */
+void b32_decode_many(b32_item_t *items, size_t nitems, int fmt, int flags)
+{
+    batch_run(items, nitems, fmt, flags, BATCH_DECODE_MANY);
+}
+
+/**
+ * @brief Return how b32_decode_many() maps the characters in this build.
+ *
+ * @return const char* "avx512" or "vector" for the range compares on AVX-512
+ *         or on 16-byte SSE2/NEON vectors, or "table" for table lookups
+ */
+const char *b32_decode_many_kernel(void)
+{
+    return MB_DECODE_KERNEL;
+}
+
+/**
+ * @brief Check that `src` is a valid Base32 encoded string without decoding
+ * it.
+ *
+ * @param src Base32 encoded string
+ * @param srclen Length of the Base32 encoded string
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param errpos If not NULL, receives the 0-based offset of the illegal
+ *               character on B32_EILSEQ
+ * @return ptrdiff_t Length of the decoded data, or a negative error code
+ */
+ptrdiff_t b32_validate(const char *src, size_t srclen, int fmt, size_t *errpos)
+{
+    const uint8_t *s   = (const uint8_t *)src;
+    const uint8_t *tbl = NULL;
+    size_t nchars      = 0;
+    int rv             = decode_prepare(s, &srclen, fmt, &tbl);
+
+    if (rv != 0) {
+        return rv;
+    }
+
+    for (size_t i = 0; i < srclen; i++) {
+        uint8_t c = s[i];
+
+        if (tbl[c] > 31) {
+            // In Crockford's Base32, '-' is allowed for readability
+            if (c == '-' && tbl == CROCKFORD_DECODE_TABLE) {
+                continue;
+            }
+            if (errpos) {
+                *errpos = i;
+            }
+            return B32_EILSEQ;
+        }
+        nchars++;
+    }
+
+    return (ptrdiff_t)(nchars * 5 / 8);
+}
+
+/*
+ * Asynchronous conversions
+ */
+
+// Input bytes per task; small enough to cancel a conversion quickly
+#define ASYNC_CHUNK (1024 * 1024)
+
+struct b32_async_t {
+    // must be the first member; the tasks cast the job back to their type
+    union {
+        b32_job_t job;
+        encode_job_t enc;
+        decode_job_t dec;
+    } u;
+    int decode;
+    // result of an encoding
+    size_t outlen;
+    int canceled;
+    int ready;
+    // read and write ends of the completion notification
+    int fd;
+    int wfd;
+};
+
+// Called by the pool with its lock held when the last task is completed.
+static void async_done(b32_job_t *job)
+{
+    b32_async_t *task = (b32_async_t *)job;
+    ssize_t rv        = 0;
+
+    // set the flag first, so that the task is ready once the fd is readable
+    __atomic_store_n(&task->ready, 1, __ATOMIC_RELEASE);
+#if defined(__linux__)
+    rv = write(task->wfd, &(uint64_t){1}, sizeof(uint64_t));
+#else
+    rv = write(task->wfd, "", 1);
+#endif
+    (void)rv;
+}
+
+/**
+ * @brief Allocate a task and the file descriptor that becomes readable when
+ * it is completed.
+ *
+ * An eventfd is used on Linux, and a pipe elsewhere. The descriptors are
+ * non-blocking and close-on-exec.
+ *
+ * @return b32_async_t* New task, or NULL with errno set
+ */
+static b32_async_t *async_new(void)
+{
+    b32_async_t *task = calloc(1, sizeof(b32_async_t));
+
+    if (!task) {
+        return NULL;
+    }
+#if defined(__linux__)
+    task->fd = task->wfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (task->fd != -1) {
+        return task;
+    }
+#else
+    int fds[2] = {-1, -1};
+    if (pipe(fds) == 0) {
+        for (int i = 0; i < 2; i++) {
+            fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+            fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        }
+        task->fd  = fds[0];
+        task->wfd = fds[1];
+        return task;
+    }
+#endif
+    free(task);
+    return NULL;
+}
+
+// Queue the tasks of `task` on the worker threads.
+static void async_submit(b32_async_t *task)
+{
+    task->u.job.done = async_done;
+    b32_pool_submit(&task->u.job, b32_get_threads(NULL));
+}
+
+/**
+ * @brief Start encoding `srclen` bytes of `src` into `dst` on the worker
+ * threads.
+ *
+ * The input is split into 1 MiB chunks that are encoded by the worker pool
+ * (with at least one worker, regardless of b32_set_threads()). `src` and
+ * `dst` must stay valid until b32_async_wait() or b32_async_free() returns.
+ *
+ * @param task Receives the new task
+ * @param dst Output buffer
+ * @param dstlen Size of the output buffer; must be at least
+ *               b32_encoded_len(srclen, fmt)
+ * @param src Input data
+ * @param srclen Length of the input data
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @return int 0 on success, or a negative error code
+ */
+int b32_encode_async(b32_async_t **task, char *dst, size_t dstlen,
+                     const void *src, size_t srclen, int fmt)
+{
+    b32_async_t *t = NULL;
+
+    if (fmt != B32_RFC && fmt != B32_CROCKFORD) {
+        return B32_EINVAL;
+    } else if (dstlen < b32_encoded_len(srclen, fmt)) {
+        return B32_ENOBUFS;
+    } else if (!(t = async_new())) {
+        return B32_ESYS;
+    }
+
+    t->outlen = b32_encoded_len(srclen, fmt);
+    t->u.enc  = (encode_job_t){
+        .job    = {.fn = encode_task},
+        .dst    = dst,
+        .src    = (const uint8_t *)src,
+        .srclen = srclen,
+        .chunk  = ASYNC_CHUNK / 5 * 5,
+        .tbl    = fmt == B32_RFC ? RFC_ALPHABET : CROCKFORD_ALPHABET,
+        .pad    = fmt == B32_RFC,
+        .kernel = encode_kernel(srclen, srclen, 0),
+    };
+    t->u.job.ntasks = (srclen + t->u.enc.chunk - 1) / t->u.enc.chunk;
+    async_submit(t);
+    *task = t;
+    return 0;
+}
+
+/**
+ * @brief Start decoding `srclen` characters of `src` into `dst` on the worker
+ * threads.
+ *
+ * Errors in the length or padding are returned immediately; illegal
+ * characters are reported by b32_async_wait(). Crockford's Base32 strings
+ * containing hyphens are decoded as a single chunk.
+ *
+ * @param task Receives the new task
+ * @param dst Output buffer
+ * @param dstlen Size of the output buffer; must be at least
+ *               b32_decoded_maxlen(srclen)
+ * @param src Base32 encoded string
+ * @param srclen Length of the Base32 encoded string
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @return int 0 on success, or a negative error code
+ */
+int b32_decode_async(b32_async_t **task, void *dst, size_t dstlen,
+                     const char *src, size_t srclen, int fmt)
+{
+    const uint8_t *s   = (const uint8_t *)src;
+    const uint8_t *tbl = NULL;
+    b32_async_t *t     = NULL;
+    int rv             = decode_prepare(s, &srclen, fmt, &tbl);
+
+    if (rv != 0) {
+        return rv;
+    } else if (dstlen < b32_decoded_maxlen(srclen)) {
+        return B32_ENOBUFS;
+    } else if (!(t = async_new())) {
+        return B32_ESYS;
+    }
+
+    t->decode = 1;
+    t->u.dec  = (decode_job_t){
+        .job    = {.fn = decode_task},
+        .dst    = (uint8_t *)dst,
+        .src    = s,
+        .srclen = srclen,
+        .chunk  = ASYNC_CHUNK / 8 * 8,
+        .tbl    = tbl,
+        .block  = use_block(srclen, &DecodeBlockMin, 0),
+        .errpos = SIZE_MAX,
+    };
+    if (tbl == CROCKFORD_DECODE_TABLE && memchr(s, '-', srclen)) {
+        // hyphens break the quantum alignment of the chunks
+        t->u.dec.chunk = srclen;
+    }
+    if (srclen > 0) {
+        t->u.job.ntasks = (srclen + t->u.dec.chunk - 1) / t->u.dec.chunk;
+    }
+    async_submit(t);
+    *task = t;
+    return 0;
+}
+
+/**
+ * @brief Return the file descriptor that becomes readable when `task` is
+ * completed.
+ *
+ * The descriptor can be registered with poll, epoll or kqueue. It stays
+ * readable once the task is completed and must not be read or closed by the
+ * caller.
+ */
+int b32_async_fd(const b32_async_t *task)
+{
+    return task->fd;
+}
+
+// Return non-zero if every chunk of `task` is completed or canceled.
+int b32_async_ready(const b32_async_t *task)
+{
+    return __atomic_load_n(&task->ready, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Cancel the chunks of `task` that have not started yet.
+ *
+ * Chunks that are already running are completed. If any chunk was canceled,
+ * b32_async_wait() returns B32_ECANCELED.
+ */
+void b32_async_cancel(b32_async_t *task)
+{
+    if (b32_pool_cancel(&task->u.job) > 0) {
+        task->canceled = 1;
+    }
+}
+
+/**
+ * @brief Wait for `task` to complete and return its result.
+ *
+ * Chunks that have not started yet are run on the calling thread.
+ *
+ * @param task Task
+ * @param errpos If not NULL, receives the 0-based offset of the illegal
+ *               character on B32_EILSEQ
+ * @return ptrdiff_t Number of bytes written as by b32_encode()/b32_decode(),
+ *         B32_ECANCELED, or B32_EILSEQ
+ */
+ptrdiff_t b32_async_wait(b32_async_t *task, size_t *errpos)
+{
+    decode_job_t *j = &task->u.dec;
+
+    b32_pool_wait(&task->u.job);
+    if (task->canceled) {
+        return B32_ECANCELED;
+    } else if (!task->decode) {
+        return (ptrdiff_t)task->outlen;
+    } else if (j->errpos != SIZE_MAX) {
+        if (errpos) {
+            *errpos = j->errpos;
+        }
+        return B32_EILSEQ;
+    } else if (j->job.ntasks == 0) {
+        return 0;
+    }
+    return (ptrdiff_t)((j->job.ntasks - 1) * j->chunk / 8 * 5) + j->lastlen;
+}
+
+/**
+ * @brief Cancel `task`, wait for its running chunks and release it.
+ *
+ * @param task Task, or NULL
+ */
+void b32_async_free(b32_async_t *task)
+{
+    if (task) {
+        b32_pool_cancel(&task->u.job);
+        b32_pool_wait(&task->u.job);
+        close(task->fd);
+        if (task->wfd != task->fd) {
+            close(task->wfd);
+        }
+        free(task);
+    }
+}
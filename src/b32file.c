@@ -0,0 +1,913 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "base32.h"
+#include "b32pool.h"
+#include "b32ring.h"
+// include system headers
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Minimum mapping size for the huge page hint
+#define HUGEPAGE_THRESHOLD (2 * 1024 * 1024)
+
+/**
+ * @brief Give the kernel the access hints for a mapping that is read or
+ * written once from start to end.
+ */
+static void advise(void *addr, size_t len)
+{
+    madvise(addr, len, MADV_SEQUENTIAL);
+#if defined(MADV_HUGEPAGE)
+    if (len >= HUGEPAGE_THRESHOLD) {
+        // only a hint; ignored by filesystems without huge page support
+        madvise(addr, len, MADV_HUGEPAGE);
+    }
+#endif
+}
+
+typedef struct {
+    int infd;
+    int outfd;
+    const char *src;
+    size_t srclen;
+    char *dst;
+    size_t dstlen;
+} mapping_t;
+
+/**
+ * @brief Open and map the input file.
+ *
+ * @return int 0 on success, or B32_ESYS with errno set
+ */
+static int map_input(mapping_t *m, const char *path)
+{
+    struct stat st;
+    void *addr = NULL;
+
+    m->infd = open(path, O_RDONLY | O_CLOEXEC);
+    if (m->infd == -1) {
+        return B32_ESYS;
+    } else if (fstat(m->infd, &st) != 0) {
+        return B32_ESYS;
+    } else if ((uintmax_t)st.st_size > SIZE_MAX) {
+        errno = EFBIG;
+        return B32_ESYS;
+    }
+
+    m->srclen = (size_t)st.st_size;
+    if (m->srclen == 0) {
+        // mmap does not accept an empty mapping
+        return 0;
+    }
+    addr = mmap(NULL, m->srclen, PROT_READ, MAP_PRIVATE, m->infd, 0);
+    if (addr == MAP_FAILED) {
+        return B32_ESYS;
+    }
+    m->src = addr;
+    advise(addr, m->srclen);
+    return 0;
+}
+
+/**
+ * @brief Open the output file with `mode` and truncate it, unless it is the
+ * input file.
+ *
+ * The files are compared once both are open, so that another path or a hard
+ * link to the input file is detected as well; it would be truncated while
+ * the input is mapped or read.
+ *
+ * @return int 0 on success, B32_EINVAL if the output file is the input file,
+ *         or B32_ESYS with errno set
+ */
+static int open_output(mapping_t *m, const char *path, int mode)
+{
+    struct stat in, out;
+    int rv = 0;
+
+    m->outfd = open(path, mode | O_CREAT | O_CLOEXEC, 0666);
+    if (m->outfd == -1) {
+        return B32_ESYS;
+    } else if (fstat(m->infd, &in) != 0 || fstat(m->outfd, &out) != 0) {
+        rv = B32_ESYS;
+    } else if (in.st_dev == out.st_dev && in.st_ino == out.st_ino) {
+        rv = B32_EINVAL;
+    } else if (S_ISREG(out.st_mode) && ftruncate(m->outfd, 0) != 0) {
+        return B32_ESYS;
+    }
+    if (rv != 0) {
+        // unmap() must not truncate a file that may be the input file
+        int err = errno;
+        close(m->outfd);
+        m->outfd = -1;
+        errno    = err;
+    }
+    return rv;
+}
+
+/**
+ * @brief Extend the opened output file to exactly `len` bytes and map it.
+ *
+ * @return int 0 on success, or B32_ESYS with errno set
+ */
+static int map_output(mapping_t *m, size_t len)
+{
+    void *addr = NULL;
+
+    if ((uintmax_t)len > (uintmax_t)INTMAX_MAX ||
+        ftruncate(m->outfd, (off_t)len) != 0) {
+        return B32_ESYS;
+    }
+
+    m->dstlen = len;
+    if (len == 0) {
+        return 0;
+    }
+    addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, m->outfd, 0);
+    if (addr == MAP_FAILED) {
+        return B32_ESYS;
+    }
+    m->dst = addr;
+    advise(addr, len);
+    return 0;
+}
+
+/**
+ * @brief Unmap and close the files, preserving errno.
+ *
+ * @param m Mapping
+ * @param rv Result of the conversion; on failure the output file is
+ *           truncated to zero length
+ * @return ptrdiff_t `rv`
+ */
+static ptrdiff_t unmap(mapping_t *m, ptrdiff_t rv)
+{
+    int err = errno;
+
+    if (m->src) {
+        munmap((void *)m->src, m->srclen);
+    }
+    if (m->dst) {
+        munmap(m->dst, m->dstlen);
+    }
+    if (m->infd != -1) {
+        close(m->infd);
+    }
+    if (m->outfd != -1) {
+        if (rv < 0) {
+            // do not leave a partially converted file behind
+            if (ftruncate(m->outfd, 0) != 0) {
+                // nothing more can be done
+            }
+        }
+        close(m->outfd);
+    }
+    errno = err;
+    return rv;
+}
+
+/*
+ * Pipelined file conversion
+ *
+ * The input file is read in blocks into a ring of slots. With io_uring, the
+ * reads of the next blocks and the writes of the converted ones are kept in
+ * flight while the blocks that have been read are converted by the worker
+ * threads. Without io_uring, each request is performed by a blocking
+ * pread(2) or pwrite(2) when it is queued.
+ */
+
+// Size of an input block; a multiple of 40 so that only the last encoded
+// block has padding characters
+#define PIPE_BLKSIZE (40 * 16 * 1024)
+// Size of an output block; large enough for an encoded or decoded block
+#define PIPE_OUTSIZE (PIPE_BLKSIZE / 5 * 8)
+// Number of slots, and so of requests in flight
+#define PIPE_NSLOTS  8
+
+enum {
+    SLOT_IDLE = 0,
+    SLOT_READING,
+    SLOT_READY,
+    SLOT_WRITING,
+};
+
+typedef struct {
+    int state;
+    // remaining part of the current request and its file offset
+    struct iovec iov;
+    uint64_t off;
+    char *in;
+    size_t inlen;
+    char *out;
+    size_t outlen;
+    // the block has been decoded on its own by pipe_task()
+    int decoded;
+} slot_t;
+
+typedef struct {
+    b32_job_t job;
+    int decode;
+    int fmt;
+    b32_decoder_t dec;
+    b32_ring_t ring;
+    int uring;
+    int infd;
+    int outfd;
+    size_t ninflight;
+    slot_t slots[PIPE_NSLOTS];
+    // blocks converted by the current job
+    size_t first;
+    size_t nblocks;
+    // result of the current job
+    ptrdiff_t rv;
+    size_t errpos;
+    int errc;
+} pipe_job_t;
+
+static void pipe_task(b32_job_t *job, size_t idx)
+{
+    pipe_job_t *p = (pipe_job_t *)job;
+    slot_t *s     = p->slots + (p->first + idx) % PIPE_NSLOTS;
+    ptrdiff_t rv  = 0;
+
+    if (!p->decode) {
+        // blocks are encoded independently of each other
+        s->outlen = (size_t)b32_encode(s->out, PIPE_OUTSIZE, s->in, s->inlen,
+                                       p->fmt, B32_NOTHREADS);
+        return;
+    }
+
+    // an RFC 4648 block is made of whole quanta, so it is decoded on its own
+    // unless it is invalid or ends with padding; pipe_decode() then decodes
+    // it again in order to report the error or to keep the padding
+    rv         = b32_decode(s->out, PIPE_OUTSIZE, s->in, s->inlen, p->fmt,
+                            B32_NOTHREADS, NULL);
+    s->decoded = rv >= 0 && (s->inlen == 0 || s->in[s->inlen - 1] != '=');
+    s->outlen  = s->decoded ? (size_t)rv : 0;
+}
+
+/**
+ * @brief Pass the blocks of the current job to the incremental decoder in
+ * file order, skipping those that pipe_task() has decoded while the decoder
+ * is at the start of a quantum without padding.
+ */
+static void pipe_decode(pipe_job_t *p)
+{
+    for (size_t i = 0; i < p->nblocks; i++) {
+        slot_t *s    = p->slots + (p->first + i) % PIPE_NSLOTS;
+        ptrdiff_t rv = 0;
+
+        if (s->decoded && p->dec.nbits == 0 && p->dec.npad == 0) {
+            p->dec.pos += s->inlen;
+            continue;
+        }
+        // the decoder state is carried from a block to the next
+        rv = b32_decoder_update(&p->dec, s->out, PIPE_OUTSIZE, s->in, s->inlen,
+                                &p->errpos);
+        if (rv < 0) {
+            // the decoder has not counted this block; only misplaced
+            // padding characters can be in a previous one
+            p->errc = p->errpos >= p->dec.pos ?
+                          (uint8_t)s->in[p->errpos - p->dec.pos] :
+                          '=';
+            p->rv   = rv;
+            return;
+        }
+        s->outlen = (size_t)rv;
+    }
+}
+
+/**
+ * @brief Account `res` bytes transferred by the request of slot `s`.
+ *
+ * @return int 0 on success, or -1 with errno set
+ */
+static int pipe_complete(slot_t *s, long res)
+{
+    if (res == -EINTR || res == -EAGAIN) {
+        // the request is queued again as is
+        return 0;
+    } else if (res < 0) {
+        errno = (int)-res;
+        return -1;
+    } else if (res == 0) {
+        // the input file has been truncated during the conversion
+        errno = EIO;
+        return -1;
+    }
+    s->iov.iov_base = (char *)s->iov.iov_base + res;
+    s->iov.iov_len -= (size_t)res;
+    s->off += (uint64_t)res;
+    if (s->iov.iov_len == 0) {
+        s->state = s->state == SLOT_READING ? SLOT_READY : SLOT_IDLE;
+    }
+    return 0;
+}
+
+/**
+ * @brief Queue the read or write request of slot `idx`, or perform it with
+ * blocking calls if io_uring is not used.
+ *
+ * @return int 0 on success, or -1 with errno set
+ */
+static int pipe_queue(pipe_job_t *p, size_t idx)
+{
+    slot_t *s = p->slots + idx;
+    int write = s->state == SLOT_WRITING;
+    int fd    = write ? p->outfd : p->infd;
+
+    if (p->uring) {
+        // a slot has at most one request in flight, so the queue that has an
+        // entry for each slot is never full
+        b32_ring_prep(&p->ring, write, fd, &s->iov, s->off, idx);
+        p->ninflight++;
+        return 0;
+    }
+
+    while (s->state == SLOT_READING || s->state == SLOT_WRITING) {
+        ssize_t n = write ? pwrite(fd, s->iov.iov_base, s->iov.iov_len,
+                                   (off_t)s->off) :
+                            pread(fd, s->iov.iov_base, s->iov.iov_len,
+                                  (off_t)s->off);
+        if (pipe_complete(s, n == -1 ? -(long)errno : (long)n) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Wait for a request in flight to complete, and queue it again if it
+ * was partially completed.
+ *
+ * @return int 0 on success, or -1 with errno set
+ */
+static int pipe_reap(pipe_job_t *p)
+{
+    uint64_t idx = 0;
+    int res      = 0;
+
+    if (b32_ring_wait(&p->ring, &idx, &res) != 0) {
+        return -1;
+    }
+    p->ninflight--;
+    if (pipe_complete(p->slots + idx, res) != 0) {
+        return -1;
+    } else if (p->slots[idx].state == SLOT_READING ||
+               p->slots[idx].state == SLOT_WRITING) {
+        return pipe_queue(p, (size_t)idx);
+    }
+    return 0;
+}
+
+/**
+ * @brief Convert `srclen` bytes of `p->infd` into `p->outfd`.
+ *
+ * @param p Pipeline with the opened files and the format
+ * @param srclen Length of the input file
+ * @param flags B32_NOTHREADS and B32_NOURING flags
+ * @return ptrdiff_t Number of bytes written, or a negative error code;
+ *         B32_ESYS with errno set on read or write errors
+ */
+static ptrdiff_t pipe_run(pipe_job_t *p, size_t srclen, int flags)
+{
+    size_t nblocks = (srclen + PIPE_BLKSIZE - 1) / PIPE_BLKSIZE;
+    size_t memlen  = (size_t)PIPE_NSLOTS * (PIPE_BLKSIZE + PIPE_OUTSIZE);
+    int nthr       = (flags & B32_NOTHREADS) ? 1 : b32_get_threads(NULL);
+    char *mem      = malloc(memlen);
+    uint64_t total = 0;
+    size_t nread   = 0;
+    size_t nconv   = 0;
+    ptrdiff_t rv   = 0;
+    int err        = 0;
+
+    if (!mem) {
+        return B32_ESYS;
+    }
+    for (size_t i = 0; i < PIPE_NSLOTS; i++) {
+        p->slots[i].in  = mem + i * PIPE_BLKSIZE;
+        p->slots[i].out = mem + PIPE_NSLOTS * PIPE_BLKSIZE + i * PIPE_OUTSIZE;
+    }
+    if (!(flags & B32_NOURING) && b32_ring_init(&p->ring, PIPE_NSLOTS) == 0) {
+        p->uring = 1;
+        // plain reads and writes are used if the buffers cannot be pinned
+        b32_ring_register(&p->ring, mem, memlen);
+    }
+    p->job.fn = pipe_task;
+
+    while (nconv < nblocks) {
+        size_t k = 0;
+
+        // read ahead into the idle slots
+        while (nread < nblocks && nread < nconv + PIPE_NSLOTS &&
+               p->slots[nread % PIPE_NSLOTS].state == SLOT_IDLE) {
+            slot_t *s = p->slots + nread % PIPE_NSLOTS;
+            s->off    = (uint64_t)nread * PIPE_BLKSIZE;
+            s->inlen  = srclen - (size_t)s->off < PIPE_BLKSIZE ?
+                            srclen - (size_t)s->off :
+                            PIPE_BLKSIZE;
+            s->iov    = (struct iovec){.iov_base = s->in, .iov_len = s->inlen};
+            s->state  = SLOT_READING;
+            if (pipe_queue(p, nread % PIPE_NSLOTS) != 0) {
+                goto FAIL;
+            }
+            nread++;
+        }
+        if (p->slots[nconv % PIPE_NSLOTS].state != SLOT_READY) {
+            if (pipe_reap(p) != 0) {
+                goto FAIL;
+            }
+            continue;
+        }
+
+        // convert the blocks that have been read, in file order, while the
+        // submitted requests are in flight
+        while (nconv + k < nread &&
+               p->slots[(nconv + k) % PIPE_NSLOTS].state == SLOT_READY) {
+            k++;
+        }
+        if (p->uring && b32_ring_submit(&p->ring) != 0) {
+            goto FAIL;
+        }
+        p->first   = nconv;
+        p->nblocks = k;
+        // Crockford blocks may end in the middle of a quantum because of the
+        // hyphens, so they are only decoded by the incremental decoder
+        if (!p->decode || p->fmt == B32_RFC) {
+            p->job.ntasks = k;
+            b32_pool_run(&p->job, nthr - 1);
+        }
+        if (p->decode) {
+            pipe_decode(p);
+        }
+        if (p->rv < 0) {
+            rv = p->rv;
+            goto DONE;
+        }
+
+        for (size_t i = 0; i < k; i++, nconv++) {
+            slot_t *s = p->slots + nconv % PIPE_NSLOTS;
+            s->iov    = (struct iovec){.iov_base = s->out, .iov_len = s->outlen};
+            s->off    = total;
+            s->state  = s->outlen ? SLOT_WRITING : SLOT_IDLE;
+            total += s->outlen;
+            if (s->outlen && pipe_queue(p, nconv % PIPE_NSLOTS) != 0) {
+                goto FAIL;
+            }
+        }
+    }
+    while (p->ninflight) {
+        if (pipe_reap(p) != 0) {
+            goto FAIL;
+        }
+    }
+
+    if (p->decode) {
+        // every slot is idle now
+        slot_t *s = p->slots;
+        rv        = b32_decoder_final(&p->dec, s->out, PIPE_OUTSIZE);
+        if (rv < 0) {
+            goto DONE;
+        } else if (rv > 0) {
+            s->iov   = (struct iovec){.iov_base = s->out,
+                                          .iov_len  = (size_t)rv};
+            s->off   = total;
+            s->state = SLOT_WRITING;
+            total += (uint64_t)rv;
+            // the last few bytes are written by a blocking call
+            p->uring = 0;
+            if (pipe_queue(p, 0) != 0) {
+                goto FAIL;
+            }
+        }
+    }
+    rv = (ptrdiff_t)total;
+    goto DONE;
+
+FAIL:
+    rv = B32_ESYS;
+
+DONE:
+    err = errno;
+    // the buffers must outlive the requests in flight
+    while (p->ninflight) {
+        uint64_t idx = 0;
+        int res      = 0;
+        if (b32_ring_wait(&p->ring, &idx, &res) != 0) {
+            break;
+        }
+        p->ninflight--;
+    }
+    if (p->ring.fd != -1) {
+        b32_ring_exit(&p->ring);
+    }
+    free(mem);
+    errno = err;
+    return rv;
+}
+
+/**
+ * @brief Open the files and convert them through the pipeline.
+ *
+ * @return ptrdiff_t Number of bytes written, or a negative error code
+ */
+static ptrdiff_t pipe_file(pipe_job_t *p, const char *inpath,
+                           const char *outpath, int flags)
+{
+    mapping_t m  = {.infd = -1, .outfd = -1};
+    struct stat st;
+    ptrdiff_t rv = 0;
+
+    p->ring.fd = -1;
+    if ((m.infd = open(inpath, O_RDONLY | O_CLOEXEC)) == -1 ||
+        fstat(m.infd, &st) != 0) {
+        return unmap(&m, B32_ESYS);
+    } else if ((uintmax_t)st.st_size > SIZE_MAX) {
+        errno = EFBIG;
+        return unmap(&m, B32_ESYS);
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(m.infd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    if ((rv = open_output(&m, outpath, O_WRONLY)) != 0) {
+        return unmap(&m, rv);
+    }
+
+    p->infd  = m.infd;
+    p->outfd = m.outfd;
+    rv       = pipe_run(p, (size_t)st.st_size, flags);
+    return unmap(&m, rv);
+}
+
+// Flags accepted by the file functions
+#define FILE_FLAGS (B32_NOTHREADS | B32_PIPELINE | B32_NOURING)
+
+/**
+ * @brief Encode the file `inpath` into the file `outpath`.
+ *
+ * Both files are mapped into memory; the output file is created or truncated
+ * to the exact encoded length. Large files are encoded by the worker threads
+ * as by b32_encode(). With B32_PIPELINE, the files are read and written
+ * through the pipeline of buffers instead.
+ *
+ * @param inpath Path of the input file
+ * @param outpath Path of the output file
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param flags 0, or a combination of B32_NOTHREADS, B32_PIPELINE and
+ *              B32_NOURING
+ * @return ptrdiff_t Number of characters written, or a negative error code;
+ *         B32_EINVAL if `outpath` is the input file, and B32_ESYS with errno
+ *         set if a file cannot be opened, mapped, read or written
+ */
+ptrdiff_t b32_encode_file(const char *inpath, const char *outpath, int fmt,
+                          int flags)
+{
+    mapping_t m  = {.infd = -1, .outfd = -1};
+    ptrdiff_t rv = 0;
+
+    if ((fmt != B32_RFC && fmt != B32_CROCKFORD) || (flags & ~FILE_FLAGS)) {
+        return B32_EINVAL;
+    } else if (flags & B32_PIPELINE) {
+        pipe_job_t p = {.fmt = fmt};
+        return pipe_file(&p, inpath, outpath, flags);
+    } else if ((rv = map_input(&m, inpath)) != 0 ||
+               (rv = open_output(&m, outpath, O_RDWR)) != 0 ||
+               (rv = map_output(&m, b32_encoded_len(m.srclen, fmt))) != 0) {
+        return unmap(&m, rv);
+    }
+
+    rv = b32_encode(m.dst, m.dstlen, m.src, m.srclen, fmt, flags);
+    return unmap(&m, rv);
+}
+
+/**
+ * @brief Return the exact decoded length of `srclen` characters of `src`.
+ *
+ * The length and the padding are checked first; then the hyphens of
+ * Crockford's Base32 strings are counted by a loop the compiler vectorizes.
+ * Illegal characters are detected while decoding.
+ *
+ * @return ptrdiff_t Decoded length, or a negative error code
+ */
+static ptrdiff_t decoded_len(const char *src, size_t srclen, int fmt)
+{
+    size_t nchars = srclen;
+    int rv        = b32_decode_check(src, srclen, fmt);
+
+    if (rv != 0) {
+        return rv;
+    } else if (fmt == B32_RFC) {
+        // remove padding characters
+        for (; nchars > 0 && src[nchars - 1] == '='; nchars--) {
+        }
+    } else {
+        size_t nhyphens = 0;
+        for (size_t i = 0; i < srclen; i++) {
+            nhyphens += src[i] == '-';
+        }
+        nchars -= nhyphens;
+    }
+    return (ptrdiff_t)(nchars / 8 * 5 + nchars % 8 * 5 / 8);
+}
+
+/**
+ * @brief Decode the file `inpath` into the file `outpath`.
+ *
+ * The exact decoded length is computed in a first pass over the input, so
+ * that the output file can be extended to its final size and mapped; it is
+ * truncated before, so that it is left empty if the length or the padding is
+ * invalid. The decoding itself runs as b32_decode(). With B32_PIPELINE, the
+ * input is read and decoded in a single pass through the pipeline of buffers
+ * instead, and the length and the padding are checked at the end. The blocks
+ * of the pipeline are decoded in parallel in the RFC 4648 format, and in order
+ * by a single thread in the Crockford format. On failure, the output file is
+ * left empty, except that no file is opened if `fmt` or `flags` is invalid.
+ *
+ * @param inpath Path of the input file
+ * @param outpath Path of the output file
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param flags 0, or a combination of B32_NOTHREADS, B32_PIPELINE and
+ *              B32_NOURING
+ * @param errpos If not NULL, receives the 0-based offset of the illegal
+ *               character on B32_EILSEQ
+ * @param errc If not NULL, receives the illegal character on B32_EILSEQ
+ * @return ptrdiff_t Number of bytes written, or a negative error code;
+ *         B32_EINVAL if `outpath` is the input file, and B32_ESYS with errno
+ *         set if a file cannot be opened, mapped, read or written
+ */
+ptrdiff_t b32_decode_file(const char *inpath, const char *outpath, int fmt,
+                          int flags, size_t *errpos, int *errc)
+{
+    mapping_t m  = {.infd = -1, .outfd = -1};
+    ptrdiff_t rv = 0;
+    size_t pos   = 0;
+
+    if ((fmt != B32_RFC && fmt != B32_CROCKFORD) || (flags & ~FILE_FLAGS)) {
+        return B32_EINVAL;
+    } else if (flags & B32_PIPELINE) {
+        pipe_job_t p = {.decode = 1, .fmt = fmt};
+        b32_decoder_init(&p.dec, fmt);
+        rv = pipe_file(&p, inpath, outpath, flags);
+        if (rv == B32_EILSEQ) {
+            if (errpos) {
+                *errpos = p.errpos;
+            }
+            if (errc) {
+                *errc = p.errc;
+            }
+        }
+        return rv;
+    } else if ((rv = map_input(&m, inpath)) != 0 ||
+               (rv = open_output(&m, outpath, O_RDWR)) != 0 ||
+               (rv = decoded_len(m.src, m.srclen, fmt)) < 0 ||
+               (rv = map_output(&m, (size_t)rv)) != 0) {
+        return unmap(&m, rv);
+    }
+
+    rv = b32_decode(m.dst, m.dstlen, m.src, m.srclen, fmt, flags, &pos);
+    if (rv == B32_EILSEQ) {
+        // the input is still mapped
+        if (errpos) {
+            *errpos = pos;
+        }
+        if (errc) {
+            *errc = (uint8_t)m.src[pos];
+        }
+    }
+    return unmap(&m, rv);
+}
+
+/*
+ * Streams
+ *
+ * The input is read into two buffers in turn. When more than one thread is
+ * set by b32_set_threads(), a buffer is converted by a worker thread while
+ * the next one is being read, so reading and converting overlap.
+ */
+
+// Default size of the stream buffers
+#define STREAM_BUFSIZE (64 * 1024)
+
+typedef struct {
+    b32_job_t job;
+    int decode;
+    b32_encoder_t enc;
+    b32_decoder_t dec;
+    // input buffer and output buffer of the current step
+    const char *src;
+    size_t srclen;
+    char *dst;
+    size_t dstlen;
+    // result of the current step
+    ptrdiff_t rv;
+    size_t errpos;
+} stream_job_t;
+
+static void stream_task(b32_job_t *job, size_t idx)
+{
+    stream_job_t *j = (stream_job_t *)job;
+
+    (void)idx;
+    if (j->decode) {
+        j->rv = b32_decoder_update(&j->dec, j->dst, j->dstlen, j->src,
+                                   j->srclen, &j->errpos);
+    } else {
+        j->rv = b32_encoder_update(&j->enc, j->dst, j->dstlen, j->src,
+                                   j->srclen);
+    }
+}
+
+/**
+ * @brief Read up to `len` bytes from `fp`, retrying short reads until the
+ * end of the file.
+ *
+ * @return size_t Number of bytes read; less than `len` at the end of the
+ *         file or on error
+ */
+static size_t readfull(FILE *fp, char *buf, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len) {
+        size_t rv = fread(buf + n, 1, len - n, fp);
+        if (rv == 0) {
+            break;
+        }
+        n += rv;
+    }
+    return n;
+}
+
+/**
+ * @brief Convert `in` into `out` with the encoder or the decoder of `j`.
+ *
+ * @param j Stream job with an initialized encoder or decoder
+ * @param in Input stream
+ * @param out Output stream
+ * @param bufsize Size of each input buffer
+ * @param errc If not NULL, receives the illegal character on B32_EILSEQ
+ * @return ptrdiff_t Total number of bytes written, or a negative error code
+ */
+static ptrdiff_t stream_run(stream_job_t *j, FILE *in, FILE *out,
+                            size_t bufsize, int *errc)
+{
+    // the final step writes at most 8 characters or 4 bytes
+    size_t dstlen = (j->decode ? bufsize / 8 * 5 + 5 : bufsize / 5 * 8) + 8;
+    char *mem     = malloc(bufsize * 2 + dstlen);
+    char *bufs[2] = {mem, mem + bufsize};
+    int pipelined = b32_get_threads(NULL) > 1;
+    ptrdiff_t rv  = 0;
+    size_t total  = 0;
+    size_t n      = 0;
+    int k         = 0;
+
+    if (!mem) {
+        return B32_ESYS;
+    }
+    j->job.fn     = stream_task;
+    j->job.ntasks = 1;
+    j->dst        = mem + bufsize * 2;
+    j->dstlen     = dstlen;
+
+    n = readfull(in, bufs[k], bufsize);
+    while (n > 0) {
+        size_t next = 0;
+
+        j->src    = bufs[k];
+        j->srclen = n;
+        if (pipelined && n == bufsize) {
+            // read the next buffer while a worker converts this one
+            b32_pool_submit(&j->job, 1);
+            next = readfull(in, bufs[k ^ 1], bufsize);
+            b32_pool_wait(&j->job);
+        } else {
+            stream_task(&j->job, 0);
+            if (n == bufsize) {
+                next = readfull(in, bufs[k ^ 1], bufsize);
+            }
+        }
+        if (j->rv < 0) {
+            if (j->rv == B32_EILSEQ && errc) {
+                // the decoder has not counted this buffer yet; only
+                // misplaced padding characters can be in a previous one
+                *errc = j->errpos >= j->dec.pos ?
+                            (uint8_t)bufs[k][j->errpos - j->dec.pos] :
+                            '=';
+            }
+            rv = j->rv;
+            goto DONE;
+        } else if (fwrite(j->dst, 1, (size_t)j->rv, out) != (size_t)j->rv) {
+            rv = B32_ESYS;
+            goto DONE;
+        }
+        total += (size_t)j->rv;
+        k ^= 1;
+        n = next;
+    }
+    if (ferror(in)) {
+        rv = B32_ESYS;
+        goto DONE;
+    }
+
+    if (j->decode) {
+        rv = b32_decoder_final(&j->dec, j->dst, j->dstlen);
+    } else {
+        rv = b32_encoder_final(&j->enc, j->dst, j->dstlen);
+    }
+    if (rv >= 0) {
+        if (fwrite(j->dst, 1, (size_t)rv, out) != (size_t)rv) {
+            rv = B32_ESYS;
+        } else {
+            rv = (ptrdiff_t)(total + (size_t)rv);
+        }
+    }
+
+DONE:
+    free(mem);
+    return rv;
+}
+
+/**
+ * @brief Encode the stream `in` into the stream `out` with bounded memory.
+ *
+ * @param in Input stream
+ * @param out Output stream
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param bufsize Size of each of the two input buffers, or 0 for the default
+ *                (64 KiB); rounded up to a multiple of 40 bytes
+ * @return ptrdiff_t Number of characters written, or a negative error code;
+ *         B32_EINVAL if `bufsize` is above B32_STREAM_MAX_BUFSIZE, B32_ESYS
+ *         with errno set on read or write errors
+ */
+ptrdiff_t b32_encode_stream(FILE *in, FILE *out, int fmt, size_t bufsize)
+{
+    stream_job_t j = {0};
+
+    // the buffer sizes computed by stream_run() must not overflow
+    if (b32_encoder_init(&j.enc, fmt) != 0 ||
+        bufsize > B32_STREAM_MAX_BUFSIZE) {
+        return B32_EINVAL;
+    }
+    bufsize = (bufsize ? bufsize + 39 : STREAM_BUFSIZE) / 40 * 40;
+    return stream_run(&j, in, out, bufsize, NULL);
+}
+
+/**
+ * @brief Decode the stream `in` into the stream `out` with bounded memory.
+ *
+ * Bytes decoded before an error are already written to `out`.
+ *
+ * @param in Base32 encoded input stream
+ * @param out Output stream
+ * @param fmt Base32 format (B32_RFC or B32_CROCKFORD)
+ * @param bufsize Size of each of the two input buffers, or 0 for the default
+ *                (64 KiB); rounded up to a multiple of 40 bytes
+ * @param errpos If not NULL, receives the 0-based offset of the illegal
+ *               character in the stream on B32_EILSEQ
+ * @param errc If not NULL, receives the illegal character on B32_EILSEQ
+ * @return ptrdiff_t Number of bytes written, or a negative error code;
+ *         B32_EINVAL if `bufsize` is above B32_STREAM_MAX_BUFSIZE, B32_ESYS
+ *         with errno set on read or write errors
+ */
+ptrdiff_t b32_decode_stream(FILE *in, FILE *out, int fmt, size_t bufsize,
+                            size_t *errpos, int *errc)
+{
+    stream_job_t j = {.decode = 1};
+    ptrdiff_t rv   = 0;
+
+    if (b32_decoder_init(&j.dec, fmt) != 0 ||
+        bufsize > B32_STREAM_MAX_BUFSIZE) {
+        return B32_EINVAL;
+    }
+    bufsize = (bufsize ? bufsize + 39 : STREAM_BUFSIZE) / 40 * 40;
+    rv      = stream_run(&j, in, out, bufsize, errc);
+    if (rv == B32_EILSEQ && errpos) {
+        *errpos = j.errpos;
+    }
+    return rv;
+}
@@ -0,0 +1,280 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "b32pool.h"
+// include system headers
+#include <pthread.h>
+#include <signal.h>
+
+static pthread_mutex_t Mutex   = PTHREAD_MUTEX_INITIALIZER;
+// signaled when a job is queued
+static pthread_cond_t WorkCond = PTHREAD_COND_INITIALIZER;
+// signaled when the last task of a job is completed
+static pthread_cond_t DoneCond = PTHREAD_COND_INITIALIZER;
+// queue of jobs that have unclaimed tasks
+static b32_job_t *Head         = NULL;
+static b32_job_t *Tail         = NULL;
+static int NWorkers            = 0;
+
+// registers the fork handlers when the first worker is started
+static pthread_once_t AtforkOnce = PTHREAD_ONCE_INIT;
+
+static void enqueue(b32_job_t *job)
+{
+    job->link = NULL;
+    if (Tail) {
+        Tail->link = job;
+    } else {
+        Head = job;
+    }
+    Tail = job;
+}
+
+static void dequeue(b32_job_t *job)
+{
+    b32_job_t *prev = NULL;
+
+    for (b32_job_t *it = Head; it; prev = it, it = it->link) {
+        if (it == job) {
+            if (prev) {
+                prev->link = job->link;
+            } else {
+                Head = job->link;
+            }
+            if (Tail == job) {
+                Tail = prev;
+            }
+            job->link = NULL;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Claim the next task of `job`. Must be called with the lock held.
+ *
+ * The job is removed from the queue when its last task is claimed, so that
+ * no worker refers to it after its tasks are completed.
+ *
+ * @param job Job to claim a task from
+ * @param idx Receives the task index
+ * @return int 1 if a task was claimed, 0 if all tasks are already claimed
+ */
+static int claim(b32_job_t *job, size_t *idx)
+{
+    if (job->next >= job->ntasks) {
+        return 0;
+    }
+    *idx = job->next++;
+    if (job->next == job->ntasks) {
+        dequeue(job);
+    }
+    return 1;
+}
+
+// Mark `n` tasks of `job` as completed. Must be called with the lock held.
+static void complete(b32_job_t *job, size_t n)
+{
+    job->ndone += n;
+    if (job->ndone == job->ntasks) {
+        if (job->done) {
+            job->done(job);
+        }
+        pthread_cond_broadcast(&DoneCond);
+    }
+}
+
+static void *worker(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&Mutex);
+    for (;;) {
+        b32_job_t *job = NULL;
+        size_t idx     = 0;
+
+        while (!Head) {
+            pthread_cond_wait(&WorkCond, &Mutex);
+        }
+        job = Head;
+        claim(job, &idx);
+        pthread_mutex_unlock(&Mutex);
+        job->fn(job, idx);
+        pthread_mutex_lock(&Mutex);
+        complete(job, 1);
+    }
+    return NULL;
+}
+
+static void atfork_prepare(void)
+{
+    pthread_mutex_lock(&Mutex);
+}
+
+static void atfork_parent(void)
+{
+    pthread_mutex_unlock(&Mutex);
+}
+
+/**
+ * @brief Reset the pool in the child of fork(), where only the forking thread
+ * exists, so that the workers are started again by the next job.
+ *
+ * The jobs queued before fork() are dropped; the tasks that the workers of
+ * the parent were running are never completed in the child.
+ */
+static void atfork_child(void)
+{
+    pthread_mutex_init(&Mutex, NULL);
+    pthread_cond_init(&WorkCond, NULL);
+    pthread_cond_init(&DoneCond, NULL);
+    Head     = NULL;
+    Tail     = NULL;
+    NWorkers = 0;
+}
+
+static void register_atfork(void)
+{
+    pthread_atfork(atfork_prepare, atfork_parent, atfork_child);
+}
+
+/**
+ * @brief Start worker threads until there are `n` of them. Must be called
+ * with the lock held.
+ *
+ * Workers block all signals so that they are delivered to the threads of the
+ * host application. If a thread cannot be created, the pool simply runs with
+ * fewer workers.
+ *
+ * @param n Number of workers
+ */
+static void spawn_workers(int n)
+{
+    sigset_t all, old;
+    pthread_attr_t attr;
+
+    if (NWorkers >= n) {
+        return;
+    }
+    pthread_once(&AtforkOnce, register_atfork);
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    while (NWorkers < n) {
+        pthread_t tid;
+        if (pthread_create(&tid, &attr, worker, NULL) != 0) {
+            break;
+        }
+        NWorkers++;
+    }
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void b32_pool_run(b32_job_t *job, int nworkers)
+{
+    job->next  = 0;
+    job->ndone = 0;
+    if (job->ntasks == 0) {
+        return;
+    } else if (job->ntasks == 1 || nworkers < 1) {
+        // nothing to share with the workers
+        for (; job->next < job->ntasks; job->next++) {
+            job->fn(job, job->next);
+        }
+        job->ndone = job->ntasks;
+        if (job->done) {
+            pthread_mutex_lock(&Mutex);
+            job->done(job);
+            pthread_mutex_unlock(&Mutex);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&Mutex);
+    spawn_workers(nworkers);
+    enqueue(job);
+    pthread_cond_broadcast(&WorkCond);
+    pthread_mutex_unlock(&Mutex);
+
+    // the calling thread also runs the tasks of its own job
+    b32_pool_wait(job);
+}
+
+void b32_pool_submit(b32_job_t *job, int nworkers)
+{
+    job->next  = 0;
+    job->ndone = 0;
+
+    pthread_mutex_lock(&Mutex);
+    if (job->ntasks == 0) {
+        if (job->done) {
+            job->done(job);
+        }
+        pthread_mutex_unlock(&Mutex);
+        return;
+    }
+    spawn_workers(nworkers < 1 ? 1 : nworkers);
+    enqueue(job);
+    if (NWorkers > 0) {
+        pthread_cond_broadcast(&WorkCond);
+        pthread_mutex_unlock(&Mutex);
+        return;
+    }
+    pthread_mutex_unlock(&Mutex);
+
+    // no worker could be started
+    b32_pool_wait(job);
+}
+
+void b32_pool_wait(b32_job_t *job)
+{
+    size_t idx = 0;
+
+    pthread_mutex_lock(&Mutex);
+    while (claim(job, &idx)) {
+        pthread_mutex_unlock(&Mutex);
+        job->fn(job, idx);
+        pthread_mutex_lock(&Mutex);
+        complete(job, 1);
+    }
+    while (job->ndone < job->ntasks) {
+        pthread_cond_wait(&DoneCond, &Mutex);
+    }
+    pthread_mutex_unlock(&Mutex);
+}
+
+size_t b32_pool_cancel(b32_job_t *job)
+{
+    size_t n = 0;
+
+    pthread_mutex_lock(&Mutex);
+    n = job->ntasks - job->next;
+    if (n > 0) {
+        dequeue(job);
+        job->next = job->ntasks;
+        complete(job, n);
+    }
+    pthread_mutex_unlock(&Mutex);
+    return n;
+}
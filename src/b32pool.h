@@ -0,0 +1,68 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef b32pool_h
+#define b32pool_h
+
+#include <stddef.h>
+
+/*
+ * Worker pool
+ *
+ * A job is split into `ntasks` independent tasks that are run by a lazily
+ * started pool of detached worker threads. The pool is shared by every caller
+ * in the process; jobs are queued in FIFO order.
+ */
+
+typedef struct b32_job_t b32_job_t;
+
+struct b32_job_t {
+    // called once for each task index in [0, ntasks)
+    void (*fn)(b32_job_t *job, size_t idx);
+    size_t ntasks;
+    // if not NULL, called once with the pool lock held when the last task is
+    // completed; it must not call back into the pool
+    void (*done)(b32_job_t *job);
+    // private: managed by the pool under its lock
+    size_t next;
+    size_t ndone;
+    b32_job_t *link;
+};
+
+// Run all tasks of `job` with up to `nworkers` pool threads plus the calling
+// thread, and return when every task has completed.
+void b32_pool_run(b32_job_t *job, int nworkers);
+
+// Queue all tasks of `job` for at least one and up to `nworkers` pool threads
+// and return without waiting. If no thread can be started, the tasks are run
+// on the calling thread before returning.
+void b32_pool_submit(b32_job_t *job, int nworkers);
+
+// Run the unclaimed tasks of a submitted `job` on the calling thread and wait
+// until every task has completed.
+void b32_pool_wait(b32_job_t *job);
+
+// Drop the unclaimed tasks of a submitted `job` and return their number.
+// Tasks that are already running are not interrupted.
+size_t b32_pool_cancel(b32_job_t *job);
+
+#endif
@@ -0,0 +1,252 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "b32ring.h"
+// include system headers
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  include <sys/syscall.h>
+#  if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) &&          \
+      defined(__NR_io_uring_register)
+#   define HAVE_IO_URING 1
+#  endif
+# endif
+#endif
+
+#if defined(HAVE_IO_URING)
+
+static int enter(b32_ring_t *r, unsigned nwait)
+{
+    unsigned flags = nwait ? IORING_ENTER_GETEVENTS : 0;
+    long rv        = 0;
+
+    do {
+        rv = syscall(__NR_io_uring_enter, r->fd, r->nqueued, nwait, flags, NULL,
+                     0);
+    } while (rv == -1 && errno == EINTR);
+    if (rv == -1) {
+        return -1;
+    }
+    r->nqueued -= (unsigned)rv;
+    return 0;
+}
+
+static void *map_ring(int fd, size_t len, off_t off)
+{
+    void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, off);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+int b32_ring_init(b32_ring_t *r, unsigned entries)
+{
+    struct io_uring_params p = {0};
+    int fd                   = 0;
+
+    *r = (b32_ring_t){.fd = -1};
+    fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd == -1) {
+        // ENOSYS on old kernels; EPERM if disabled by a sysctl or seccomp
+        return -1;
+    }
+    r->fd       = fd;
+    r->sqmaplen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cqmaplen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->sqeslen  = p.sq_entries * sizeof(struct io_uring_sqe);
+# if defined(IORING_FEAT_SINGLE_MMAP)
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        // both rings share a single mapping since Linux 5.4
+        if (r->cqmaplen > r->sqmaplen) {
+            r->sqmaplen = r->cqmaplen;
+        }
+        r->cqmaplen = 0;
+    }
+# endif
+
+    if (!(r->sqmap = map_ring(fd, r->sqmaplen, IORING_OFF_SQ_RING)) ||
+        (r->cqmaplen &&
+         !(r->cqmap = map_ring(fd, r->cqmaplen, IORING_OFF_CQ_RING))) ||
+        !(r->sqes = map_ring(fd, r->sqeslen, IORING_OFF_SQES))) {
+        int err = errno;
+        b32_ring_exit(r);
+        errno = err;
+        return -1;
+    } else if (!r->cqmap) {
+        r->cqmap = r->sqmap;
+    }
+
+    r->sqhead  = (unsigned *)((char *)r->sqmap + p.sq_off.head);
+    r->sqtail  = (unsigned *)((char *)r->sqmap + p.sq_off.tail);
+    r->sqmask  = *(unsigned *)((char *)r->sqmap + p.sq_off.ring_mask);
+    r->sqarray = (unsigned *)((char *)r->sqmap + p.sq_off.array);
+    r->cqhead  = (unsigned *)((char *)r->cqmap + p.cq_off.head);
+    r->cqtail  = (unsigned *)((char *)r->cqmap + p.cq_off.tail);
+    r->cqmask  = *(unsigned *)((char *)r->cqmap + p.cq_off.ring_mask);
+    r->cqes    = (char *)r->cqmap + p.cq_off.cqes;
+    return 0;
+}
+
+int b32_ring_register(b32_ring_t *r, void *buf, size_t len)
+{
+    struct iovec iov = {.iov_base = buf, .iov_len = len};
+
+    // fails with ENOMEM if the buffer exceeds RLIMIT_MEMLOCK before Linux
+    // 5.12, which accounts it to the memory cgroup instead
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS, &iov,
+                1) != 0) {
+        return -1;
+    }
+    r->fixed = 1;
+    return 0;
+}
+
+int b32_ring_prep(b32_ring_t *r, int write, int fd, const struct iovec *iov,
+                  uint64_t off, uint64_t data)
+{
+    unsigned tail = *r->sqtail;
+    unsigned head = __atomic_load_n(r->sqhead, __ATOMIC_ACQUIRE);
+    unsigned idx  = tail & r->sqmask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)r->sqes + idx;
+
+    if (tail - head > r->sqmask) {
+        return -1;
+    }
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd        = fd;
+    sqe->off       = off;
+    sqe->user_data = data;
+    if (r->fixed) {
+        sqe->opcode    = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->addr      = (uintptr_t)iov->iov_base;
+        sqe->len       = (unsigned)iov->iov_len;
+        sqe->buf_index = 0;
+    } else {
+        sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->addr   = (uintptr_t)iov;
+        sqe->len    = 1;
+    }
+    r->sqarray[idx] = idx;
+    // publish the entry before the new tail
+    __atomic_store_n(r->sqtail, tail + 1, __ATOMIC_RELEASE);
+    r->nqueued++;
+    return 0;
+}
+
+int b32_ring_submit(b32_ring_t *r)
+{
+    return r->nqueued ? enter(r, 0) : 0;
+}
+
+int b32_ring_wait(b32_ring_t *r, uint64_t *data, int *res)
+{
+    for (;;) {
+        unsigned head = *r->cqhead;
+        if (head != __atomic_load_n(r->cqtail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe =
+                (struct io_uring_cqe *)r->cqes + (head & r->cqmask);
+            *data = cqe->user_data;
+            *res  = cqe->res;
+            // release the entry to the kernel
+            __atomic_store_n(r->cqhead, head + 1, __ATOMIC_RELEASE);
+            return 0;
+        } else if (enter(r, 1) != 0) {
+            return -1;
+        }
+    }
+}
+
+void b32_ring_exit(b32_ring_t *r)
+{
+    if (r->sqes) {
+        munmap(r->sqes, r->sqeslen);
+    }
+    if (r->cqmap && r->cqmap != r->sqmap) {
+        munmap(r->cqmap, r->cqmaplen);
+    }
+    if (r->sqmap) {
+        munmap(r->sqmap, r->sqmaplen);
+    }
+    if (r->fd != -1) {
+        close(r->fd);
+    }
+    *r = (b32_ring_t){.fd = -1};
+}
+
+#else
+
+int b32_ring_init(b32_ring_t *r, unsigned entries)
+{
+    (void)entries;
+    *r    = (b32_ring_t){.fd = -1};
+    errno = ENOSYS;
+    return -1;
+}
+
+int b32_ring_register(b32_ring_t *r, void *buf, size_t len)
+{
+    (void)r;
+    (void)buf;
+    (void)len;
+    errno = ENOSYS;
+    return -1;
+}
+
+int b32_ring_prep(b32_ring_t *r, int write, int fd, const struct iovec *iov,
+                  uint64_t off, uint64_t data)
+{
+    (void)r;
+    (void)write;
+    (void)fd;
+    (void)iov;
+    (void)off;
+    (void)data;
+    return -1;
+}
+
+int b32_ring_submit(b32_ring_t *r)
+{
+    (void)r;
+    errno = ENOSYS;
+    return -1;
+}
+
+int b32_ring_wait(b32_ring_t *r, uint64_t *data, int *res)
+{
+    (void)r;
+    (void)data;
+    (void)res;
+    errno = ENOSYS;
+    return -1;
+}
+
+void b32_ring_exit(b32_ring_t *r)
+{
+    (void)r;
+}
+
+#endif
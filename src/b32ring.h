@@ -0,0 +1,90 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef b32ring_h
+#define b32ring_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/*
+ * I/O ring
+ *
+ * A minimal io_uring submission and completion queue driven by raw system
+ * calls, without liburing. On systems without io_uring, b32_ring_init()
+ * fails with errno set to ENOSYS and the callers use blocking pread(2) and
+ * pwrite(2) instead.
+ */
+
+typedef struct {
+    int fd;
+    // submission queue
+    unsigned *sqhead;
+    unsigned *sqtail;
+    unsigned sqmask;
+    unsigned *sqarray;
+    void *sqes;
+    // completion queue
+    unsigned *cqhead;
+    unsigned *cqtail;
+    unsigned cqmask;
+    void *cqes;
+    // number of queued entries that are not submitted yet
+    unsigned nqueued;
+    // 1 if b32_ring_register() succeeded
+    int fixed;
+    // private: mappings of the rings
+    void *sqmap;
+    size_t sqmaplen;
+    void *cqmap;
+    size_t cqmaplen;
+    size_t sqeslen;
+} b32_ring_t;
+
+// Create a ring with at least `entries` submission queue entries.
+// Return 0, or -1 with errno set.
+int b32_ring_init(b32_ring_t *r, unsigned entries);
+
+// Register `len` bytes at `buf` as the fixed buffer of the ring, so that
+// reads and writes within it skip mapping the pages for every request.
+// Return 0, or -1 with errno set; the ring remains usable without it.
+int b32_ring_register(b32_ring_t *r, void *buf, size_t len);
+
+// Queue a read (`write` == 0) or a write of the buffer `iov` at offset `off`
+// of `fd`, tagged with `data`. `iov` must stay valid until the request is
+// completed. Return 0, or -1 if the submission queue is full.
+int b32_ring_prep(b32_ring_t *r, int write, int fd, const struct iovec *iov,
+                  uint64_t off, uint64_t data);
+
+// Submit the queued entries without waiting. Return 0, or -1 with errno set.
+int b32_ring_submit(b32_ring_t *r);
+
+// Submit the queued entries, wait for a completion and return its `data` and
+// its result (a byte count or a negated errno value). Return 0, or -1 with
+// errno set.
+int b32_ring_wait(b32_ring_t *r, uint64_t *data, int *res);
+
+// Release the ring; requests in flight must have been completed.
+void b32_ring_exit(b32_ring_t *r);
+
+#endif
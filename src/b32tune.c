@@ -0,0 +1,329 @@
+/**
+ *  Copyright 2025 Masatoshi Fukunaga. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "base32.h"
+// include system headers
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Calibration
+ *
+ * b32_calibrate() times the scalar and the block kernels of b32_encode() and
+ * b32_decode() at a few input lengths, the non-temporal stores against the
+ * cached ones and the parallel path against the calling thread alone at
+ * larger ones, and moves the thresholds to where the faster path starts
+ * winning. The thresholds can be saved to a small text file, so that other
+ * processes on the same host can load them instead of measuring again.
+ */
+
+// Input lengths in bytes at which the kernels are compared; the decoding
+// kernels are compared at the encoded lengths
+static const size_t KERNEL_SIZES[] = {10,  20,  40,   80,  160,
+                                      320, 640, 1280, 5120};
+#define NKERNEL_SIZES         (sizeof(KERNEL_SIZES) / sizeof(KERNEL_SIZES[0]))
+// Range of input lengths at which the parallel path is compared, doubling
+#define PARALLEL_MIN          (64 * 1024)
+#define PARALLEL_MAX          (8 * 1024 * 1024)
+#define NPARALLEL             8
+// Input lengths at which the non-temporal stores are compared, doubling up
+// to PARALLEL_MAX
+#define NONTEMPORAL_MIN       (1024 * 1024)
+#define NNONTEMPORAL          4
+// Percentage by which the non-temporal stores may be slower and still be
+// chosen, since the caches they leave to the other threads are not measured
+#define NONTEMPORAL_TOLERANCE 2
+// Bytes converted per round of a measurement, and number of rounds
+#define ROUND_BYTES           (256 * 1024)
+#define NROUNDS               5
+
+typedef struct {
+    // random input, its RFC 4648 encoding, and an output buffer
+    uint8_t *src;
+    char *enc;
+    char *out;
+    size_t outlen;
+} calib_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Return the shortest time in nanoseconds of a call converting `len`
+ * bytes of the input, or `len` characters of its encoding if `decode` is
+ * non-zero, with `flags`.
+ */
+static uint64_t measure(const calib_t *c, int decode, size_t len, int flags)
+{
+    size_t ncalls = ROUND_BYTES / len + 1;
+    uint64_t best = UINT64_MAX;
+
+    for (int r = 0; r < NROUNDS; r++) {
+        uint64_t t = now_ns();
+
+        for (size_t i = 0; i < ncalls; i++) {
+            if (decode) {
+                b32_decode(c->out, c->outlen, c->enc, len, B32_RFC, flags,
+                           NULL);
+            } else {
+                b32_encode(c->out, c->outlen, c->src, len, B32_RFC, flags);
+            }
+        }
+        t = (now_ns() - t) / ncalls;
+        if (t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Return the smallest of the `n` lengths `sizes` from which the times
+ * `fast` are shorter than `slow` plus `tolerance` percent at every length, or
+ * SIZE_MAX if they are not shorter at the largest one.
+ */
+static size_t crossover(const size_t *sizes, const uint64_t *slow,
+                        const uint64_t *fast, size_t n, int tolerance)
+{
+    size_t i = n;
+
+    while (i > 0 &&
+           fast[i - 1] * 100 < slow[i - 1] * (uint64_t)(100 + tolerance)) {
+        i--;
+    }
+    return i == n ? SIZE_MAX : sizes[i];
+}
+
+/**
+ * @brief Measure the kernels and the parallel path on this CPU, and set the
+ * dispatch thresholds.
+ *
+ * The parallel threshold is measured only if more than one thread is set by
+ * b32_set_threads(); while it is measured, concurrent calls may take the
+ * parallel path for any input length. The non-temporal stores are then
+ * measured on the parallel path, and on the calling thread otherwise. The
+ * calibration takes up to about a second.
+ *
+ * @param t Receives the new thresholds
+ * @return int 0 on success, or B32_ESYS with errno set
+ */
+int b32_calibrate(b32_tuning_t *t)
+{
+    int nthr                        = b32_get_threads(NULL);
+    int flags                       = B32_NOTHREADS;
+    size_t dsizes[NKERNEL_SIZES]    = {0};
+    uint64_t slow[2][NKERNEL_SIZES] = {{0}};
+    uint64_t fast[2][NKERNEL_SIZES] = {{0}};
+    size_t sizes[NPARALLEL]         = {0};
+    uint64_t serial[NPARALLEL]      = {0};
+    uint64_t parallel[NPARALLEL]    = {0};
+    size_t ntsizes[NNONTEMPORAL]    = {0};
+    uint64_t cached[NNONTEMPORAL]   = {0};
+    uint64_t nt[NNONTEMPORAL]       = {0};
+    uint32_t x                      = 2463534242u;
+    calib_t c                       = {0};
+
+    c.src    = malloc(PARALLEL_MAX);
+    c.outlen = b32_encoded_len(PARALLEL_MAX, B32_RFC);
+    c.enc    = malloc(c.outlen);
+    c.out    = malloc(c.outlen);
+    if (!c.src || !c.enc || !c.out) {
+        free(c.src);
+        free(c.enc);
+        free(c.out);
+        errno = ENOMEM;
+        return B32_ESYS;
+    }
+    for (size_t i = 0; i < PARALLEL_MAX; i++) {
+        // xorshift32
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        c.src[i] = (uint8_t)x;
+    }
+    b32_encode(c.enc, c.outlen, c.src, PARALLEL_MAX, B32_RFC, 0);
+    b32_get_tuning(t);
+
+    for (size_t i = 0; i < NKERNEL_SIZES; i++) {
+        size_t len = KERNEL_SIZES[i];
+
+        dsizes[i]  = len / 5 * 8;
+        slow[0][i] = measure(&c, 0, len, B32_NOTHREADS | B32_SCALAR);
+        fast[0][i] = measure(&c, 0, len, B32_NOTHREADS | B32_BLOCK);
+        slow[1][i] = measure(&c, 1, dsizes[i], B32_NOTHREADS | B32_SCALAR);
+        fast[1][i] = measure(&c, 1, dsizes[i], B32_NOTHREADS | B32_BLOCK);
+    }
+    t->encode_block =
+        crossover(KERNEL_SIZES, slow[0], fast[0], NKERNEL_SIZES, 0);
+    t->decode_block = crossover(dsizes, slow[1], fast[1], NKERNEL_SIZES, 0);
+    b32_set_tuning(t);
+
+    if (nthr > 1) {
+        // take the parallel path at every length while it is measured
+        b32_set_threads(nthr, 0);
+        for (size_t i = 0; i < NPARALLEL; i++) {
+            size_t len = (size_t)PARALLEL_MIN << i;
+            size_t n   = len / 5 * 8;
+
+            sizes[i]    = len;
+            serial[i]   = measure(&c, 0, len, B32_NOTHREADS) +
+                          measure(&c, 1, n, B32_NOTHREADS);
+            parallel[i] = measure(&c, 0, len, 0) + measure(&c, 1, n, 0);
+        }
+        t->parallel = crossover(sizes, serial, parallel, NPARALLEL, 0);
+        flags       = 0;
+    }
+
+    for (size_t i = 0; i < NNONTEMPORAL; i++) {
+        size_t len = (size_t)NONTEMPORAL_MIN << i;
+
+        ntsizes[i] = len;
+        cached[i]  = measure(&c, 0, len, flags | B32_BLOCK);
+        nt[i]      = measure(&c, 0, len, flags | B32_NONTEMPORAL);
+    }
+    t->nontemporal =
+        crossover(ntsizes, cached, nt, NNONTEMPORAL, NONTEMPORAL_TOLERANCE);
+    b32_set_tuning(t);
+
+    free(c.src);
+    free(c.enc);
+    free(c.out);
+    return 0;
+}
+
+/**
+ * @brief Write the thresholds `t` to the file `path`.
+ *
+ * The file is written under a temporary name and renamed, so that a process
+ * loading it concurrently reads either the old or the new thresholds.
+ *
+ * @param path Path of the file
+ * @param t Thresholds
+ * @return int 0 on success, or B32_ESYS with errno set
+ */
+int b32_save_tuning(const char *path, const b32_tuning_t *t)
+{
+    size_t len = strlen(path);
+    char *tmp  = malloc(len + 5);
+    FILE *fp   = NULL;
+    int err    = 0;
+
+    if (!tmp) {
+        errno = ENOMEM;
+        return B32_ESYS;
+    }
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    fp = fopen(tmp, "w");
+    if (!fp) {
+        free(tmp);
+        return B32_ESYS;
+    }
+    fprintf(fp,
+            "# base32 dispatch thresholds; see base32.calibrate()\n"
+            "encode_block %zu\n"
+            "decode_block %zu\n"
+            "parallel %zu\n"
+            "nontemporal %zu\n",
+            t->encode_block, t->decode_block, t->parallel, t->nontemporal);
+    if (ferror(fp)) {
+        err = errno;
+        fclose(fp);
+    } else if (fclose(fp) != 0) {
+        err = errno;
+    } else if (rename(tmp, path) != 0) {
+        err = errno;
+    }
+    if (err) {
+        remove(tmp);
+        errno = err;
+    }
+    free(tmp);
+    return err ? B32_ESYS : 0;
+}
+
+/**
+ * @brief Read the thresholds written by b32_save_tuning() from the file
+ * `path`.
+ *
+ * Thresholds missing from the file are left unchanged in `t`, and unknown
+ * names are ignored. `t` is not modified if the file cannot be read or is
+ * malformed.
+ *
+ * @param path Path of the file
+ * @param t Thresholds to update
+ * @return int 0 on success, B32_EINVAL if the file is malformed, or B32_ESYS
+ *         with errno set if it cannot be read
+ */
+int b32_load_tuning(const char *path, b32_tuning_t *t)
+{
+    b32_tuning_t v = *t;
+    FILE *fp       = fopen(path, "r");
+    int rv         = 0;
+    char line[128];
+
+    if (!fp) {
+        return B32_ESYS;
+    }
+    while (rv == 0 && fgets(line, sizeof(line), fp)) {
+        char name[32];
+        unsigned long long n = 0;
+        size_t *dst          = NULL;
+
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        } else if (sscanf(line, "%31s %llu", name, &n) != 2) {
+            rv = B32_EINVAL;
+            break;
+        }
+        if (strcmp(name, "encode_block") == 0) {
+            dst = &v.encode_block;
+        } else if (strcmp(name, "decode_block") == 0) {
+            dst = &v.decode_block;
+        } else if (strcmp(name, "parallel") == 0) {
+            dst = &v.parallel;
+        } else if (strcmp(name, "nontemporal") == 0) {
+            dst = &v.nontemporal;
+        }
+        if (dst) {
+            *dst = n > SIZE_MAX ? SIZE_MAX : (size_t)n;
+        }
+    }
+    if (rv == 0 && ferror(fp)) {
+        rv = B32_ESYS;
+    }
+    fclose(fp);
+    if (rv == 0) {
+        *t = v;
+    }
+    return rv;
+}
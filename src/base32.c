@@ -20,15 +20,22 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
+#include "base32.h"
+#include "lua_base32.h"
 #include "lua_errno.h"
 #include <lauxlib.h>
 #include <lua.h>
+#include <lualib.h>
 // include system headers
 #include <ctype.h>
 #include <errno.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /**
  * @brief Check if the argument at index `arg` is a string and return its value.
@@ -44,297 +51,1761 @@ static inline const uint8_t *checklbytes(lua_State *L, int arg, size_t *len)
     return (const uint8_t *)lua_tolstring(L, arg, len);
 }
 
-// RFC 4648 Base32 Decoding table
-// https://datatracker.ietf.org/doc/html/rfc4648#section-6
-static const uint8_t RFC_DECODE_TABLE[256] = {
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF,
-
-    // 2-7
-    26, 27, 28, 29, 30, 31,
-
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-
-    // A-Z
-    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
-    21, 22, 23, 24, 25,
-
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-
-    // a-z
-    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
-    21, 22, 23, 24, 25,
-
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF};
-
-// Crockford's Base32 Decoding table (0xFF means invalid character)
-static const uint8_t CROCKFORD_DECODE_TABLE[256] = {
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-
-    // 0-9
-    0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
-
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-
-    // A-Z (I=1, L=1, O=0, U=0xFF)
-    10, 11, 12, 13, 14, 15, 16, 17, 1, 18, 19, 1, 20, 21, 0, 22, 23, 24, 25, 26,
-    0xFF, 27, 28, 29, 30, 31,
-
-    //
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-
-    // a-z (i=1, l=1, o=0, u=0xFF)
-    10, 11, 12, 13, 14, 15, 16, 17, 1, 18, 19, 1, 20, 21, 0, 22, 23, 24, 25, 26,
-    0xFF, 27, 28, 29, 30, 31,
-
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, -1};
+/**
+ * @brief Return the raw length of the table at index `idx`.
+ *
+ * @param L Lua state
+ * @param idx Stack index
+ * @return size_t Length of the table
+ */
+static inline size_t rawlen(lua_State *L, int idx)
+{
+#if LUA_VERSION_NUM >= 502
+    return (size_t)lua_rawlen(L, idx);
+#else
+    return lua_objlen(L, idx);
+#endif
+}
+
+/**
+ * @brief Check if the argument at index `arg` is a Base32 format name and
+ * return its B32_* value.
+ *
+ * @param L Lua state
+ * @param arg Argument index
+ * @return int B32_RFC (default) or B32_CROCKFORD
+ */
+static inline int checkformat(lua_State *L, int arg)
+{
+    static const char *const opts[] = {"rfc", "crockford", NULL};
+    return luaL_checkoption(L, arg, "rfc", opts);
+}
+
+/**
+ * @brief Prepare a writable buffer of `size` bytes for the result string.
+ *
+ * Lua 5.1 and LuaJIT lack luaL_buffinitsize, so a userdata is used as a
+ * scratch buffer instead.
+ *
+ * @param L Lua state
+ * @param b Buffer to initialize
+ * @param size Size of the buffer
+ * @return char* Pointer to the writable buffer
+ */
+static inline char *prepresult(lua_State *L, luaL_Buffer *b, size_t size)
+{
+#if LUA_VERSION_NUM >= 502
+    return luaL_buffinitsize(L, b, size);
+#else
+    (void)b;
+    return (char *)lua_newuserdata(L, size);
+#endif
+}
+
+/**
+ * @brief Push the first `len` bytes of the buffer prepared by prepresult() as
+ * a Lua string.
+ *
+ * @param L Lua state
+ * @param b Buffer initialized by prepresult()
+ * @param buf Pointer returned by prepresult()
+ * @param len Length of the result string
+ */
+static inline void pushresult(lua_State *L, luaL_Buffer *b, const char *buf,
+                              size_t len)
+{
+#if LUA_VERSION_NUM >= 502
+    (void)L;
+    (void)buf;
+    luaL_pushresultsize(b, len);
+#else
+    (void)b;
+    lua_pushlstring(L, buf, len);
+    // replace the scratch buffer with the result string
+    lua_replace(L, -2);
+#endif
+}
+
+/**
+ * @brief Push nil and an error object for the error code returned by
+ * b32_decode.
+ *
+ * @param L Lua state
+ * @param op Name of the operation
+ * @param rv Error code
+ * @param c Illegal character on B32_EILSEQ
+ * @param pos 0-based position of the illegal character on B32_EILSEQ
+ * @param item 1-based index of the batch item, or 0 for a single string
+ * @return int Number of return values (2)
+ */
+static int decode_error(lua_State *L, const char *op, ptrdiff_t rv, uint8_t c,
+                        size_t pos, size_t item)
+{
+    char errmsg[256] = {0};
+    int len          = 0;
+
+    if (item) {
+        len = snprintf(errmsg, sizeof(errmsg), "item #%d: ", (int)item);
+    }
+
+    switch (rv) {
+    case B32_ELENGTH:
+        errno = EINVAL;
+        snprintf(errmsg + len, sizeof(errmsg) - len,
+                 "RFC 4648 Base32 requires input length to be a multiple of "
+                 "8");
+        break;
+
+    case B32_EPADDING:
+        errno = EINVAL;
+        snprintf(errmsg + len, sizeof(errmsg) - len,
+                 "RFC 4648 Base32 padding length must be 0, 1, 3, 4, or 6");
+        break;
+
+    default:
+        errno = EILSEQ;
+        snprintf(errmsg + len, sizeof(errmsg) - len,
+                 "Illegal character in Base32 string: '%c' (0x%02X) at "
+                 "position %zu",
+                 c, c, pos + 1);
+    }
+
+    lua_pushnil(L);
+    lua_errno_new_with_message(L, errno, op, errmsg);
+    return 2;
+}
+
+/*
+ * Runtime statistics
+ *
+ * Counters of the base32.encode and base32.decode calls of every Lua state in
+ * the process, per direction and format. The clock is read and the counters
+ * are updated with relaxed atomic additions only while the statistics are
+ * enabled by base32.set_stats(true); otherwise a call costs a single load.
+ * Building with -DBASE32_NOSTATS compiles them out.
+ *
+ * Each thread updates one of STATS_NSHARDS copies of the counters, assigned
+ * round-robin on its first call, and base32.stats() sums them. The copies
+ * start on separate cache lines, so threads of different copies do not
+ * contend for them.
+ */
+
+// Number of log2 buckets of the input sizes and of the call durations
+#define STATS_NBUCKETS 40
+// Number of copies of the counters
+#define STATS_NSHARDS  16
+
+typedef struct {
+    uint64_t inbytes;
+    uint64_t outbytes;
+    // B32_ELENGTH, B32_EPADDING and B32_EILSEQ errors
+    uint64_t errors[3];
+    // calls and their total duration in nanoseconds per log2 input size
+    uint64_t calls[STATS_NBUCKETS];
+    uint64_t ns[STATS_NBUCKETS];
+    // calls per log2 duration in nanoseconds
+    uint64_t latency[STATS_NBUCKETS];
+} __attribute__((aligned(64))) stats_t;
+
+// statistics per copy, direction (0: encode, 1: decode) and format
+static stats_t Stats[STATS_NSHARDS][2][2];
+static int StatsEnabled = 0;
+// next copy to assign, and the copy of the calling thread (-1 if unassigned)
+static unsigned StatsNextShard = 0;
+static __thread int StatsShard = -1;
+
+/**
+ * @brief Return the log2 bucket of `v`: 0 for 0, and k for [2^(k-1), 2^k).
+ */
+static inline int stats_bucket(uint64_t v)
+{
+    int b = v ? 64 - __builtin_clzll(v) : 0;
+    return b < STATS_NBUCKETS ? b : STATS_NBUCKETS - 1;
+}
+
+static inline uint64_t stats_now(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// Return non-zero if the statistics are enabled.
+static inline int stats_enabled(void)
+{
+#if defined(BASE32_NOSTATS)
+    return 0;
+#else
+    return __atomic_load_n(&StatsEnabled, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+ * @brief Record a call.
+ *
+ * @param decode Non-zero for a decode call
+ * @param fmt Base32 format
+ * @param inlen Length of the input
+ * @param rv Length of the output, or a negative error code
+ * @param ns Duration of the call in nanoseconds
+ */
+static void stats_add(int decode, int fmt, size_t inlen, ptrdiff_t rv,
+                      uint64_t ns)
+{
+    stats_t *s = NULL;
+    int b      = stats_bucket(inlen);
+
+    if (StatsShard < 0) {
+        StatsShard = (int)(__atomic_fetch_add(&StatsNextShard, 1,
+                                              __ATOMIC_RELAXED) %
+                           STATS_NSHARDS);
+    }
+    s = &Stats[StatsShard][decode][fmt];
+
+    __atomic_fetch_add(&s->calls[b], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->ns[b], ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->latency[stats_bucket(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->inbytes, inlen, __ATOMIC_RELAXED);
+    if (rv >= 0) {
+        __atomic_fetch_add(&s->outbytes, (uint64_t)rv, __ATOMIC_RELAXED);
+    } else if (rv <= B32_ELENGTH && rv >= B32_EILSEQ) {
+        __atomic_fetch_add(&s->errors[B32_ELENGTH - rv], 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * USDT probes
+ *
+ * Static probes for bpftrace, perf and SystemTap, from <sys/sdt.h>. A probe
+ * is a single nop until a tracer attaches to it. Without the header, or with
+ * -DBASE32_NOSDT, they are compiled out.
+ *
+ *   base32:encode__entry(fmt, inlen)
+ *   base32:encode__return(fmt, inlen, rv)
+ *   base32:decode__entry(fmt, inlen)
+ *   base32:decode__return(fmt, inlen, rv)
+ *   base32:decode__error(fmt, inlen, rv, errpos)
+ *
+ * where fmt is B32_RFC (0) or B32_CROCKFORD (1), rv is the output length or
+ * a negative B32_E* error code, and errpos is the 0-based offset of the
+ * illegal character on B32_EILSEQ.
+ */
+#if !defined(BASE32_NOSDT) && defined(__linux__) && defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  include <sys/sdt.h>
+#  define HAVE_SDT 1
+# endif
+#endif
+
+#if defined(HAVE_SDT)
+# define PROBE2(name, a1, a2)     DTRACE_PROBE2(base32, name, a1, a2)
+# define PROBE3(name, a1, a2, a3) DTRACE_PROBE3(base32, name, a1, a2, a3)
+# define PROBE4(name, a1, a2, a3, a4)                                          \
+     DTRACE_PROBE4(base32, name, a1, a2, a3, a4)
+#else
+# define PROBE2(name, a1, a2)     ((void)(a1), (void)(a2))
+# define PROBE3(name, a1, a2, a3) ((void)(a1), (void)(a2), (void)(a3))
+# define PROBE4(name, a1, a2, a3, a4)                                          \
+     ((void)(a1), (void)(a2), (void)(a3), (void)(a4))
+#endif
+
+/**
+ * @brief Fire the return probes of a base32.encode/decode call.
+ */
+static inline void probe_return(int decode, int fmt, size_t inlen,
+                                ptrdiff_t rv, size_t errpos)
+{
+    if (!decode) {
+        PROBE3(encode__return, fmt, inlen, rv);
+        return;
+    } else if (rv < 0) {
+        PROBE4(decode__error, fmt, inlen, rv, rv == B32_EILSEQ ? errpos : 0);
+    }
+    PROBE3(decode__return, fmt, inlen, rv);
+}
+
+/*
+ * Settings of a Lua state
+ *
+ * They are kept in a userdata shared as the first upvalue of encode, decode,
+ * set_yield and set_slow_hook. The function of the slow-call hook is stored
+ * in the registry, with the address of the settings as the key.
+ */
+typedef struct {
+    // input bytes per step of a yielding call, or 0 if the calls must not
+    // yield
+    size_t slice;
+    // minimum duration in nanoseconds of the calls passed to the hook
+    uint64_t slow_ns;
+    // non-zero if a slow-call hook is set, and while it is running
+    int hooked;
+    int inhook;
+} settings_t;
+
+static inline settings_t *settings(lua_State *L)
+{
+    return lua_touserdata(L, lua_upvalueindex(1));
+}
+
+/**
+ * @brief Return the start time of a base32.encode/decode call, or 0 if
+ * neither the statistics nor a slow-call hook need it.
+ */
+static inline uint64_t call_start(lua_State *L)
+{
+    if (!stats_enabled() && !settings(L)->hooked) {
+        return 0;
+    }
+    return stats_now();
+}
+
+/**
+ * @brief Record a completed call of `ns` nanoseconds in the statistics, and
+ * pass it to the slow-call hook if it took at least the threshold.
+ *
+ * The result of the call is kept if the hook raises an error: the hook is
+ * removed and the error is written to stderr instead.
+ */
+static void call_done(lua_State *L, int decode, int fmt, size_t inlen,
+                      ptrdiff_t rv, uint64_t ns)
+{
+    settings_t *cfg = settings(L);
+
+    if (stats_enabled()) {
+        stats_add(decode, fmt, inlen, rv, ns);
+    }
+    if (!cfg->hooked || cfg->inhook || ns < cfg->slow_ns) {
+        return;
+    }
+
+    lua_pushlightuserdata(L, cfg);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    lua_pushstring(L, decode ? "decode" : "encode");
+    lua_pushstring(L, fmt == B32_RFC ? "rfc" : "crockford");
+    lua_pushinteger(L, (lua_Integer)inlen);
+    lua_pushinteger(L, (lua_Integer)ns);
+    // calls made by the hook itself are not passed to it
+    cfg->inhook = 1;
+    if (lua_pcall(L, 4, 0, 0) != 0) {
+        const char *msg = lua_tostring(L, -1);
+        fprintf(stderr, "base32: slow-call hook removed after an error: %s\n",
+                msg ? msg : "(error object is not a string)");
+        lua_pop(L, 1);
+        lua_pushlightuserdata(L, cfg);
+        lua_pushnil(L);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+        cfg->hooked = 0;
+    }
+    cfg->inhook = 0;
+}
+
+/**
+ * @brief Complete a base32.encode/decode call started at `start`, whose
+ * results are on the top of the stack: fire the return probes, record the
+ * call in the statistics and run the slow-call hook.
+ *
+ * @return int Number of results: 2 (nil and the error) if `rv` is negative,
+ *         1 otherwise
+ */
+static int call_end(lua_State *L, int decode, int fmt, size_t inlen,
+                    ptrdiff_t rv, size_t errpos, uint64_t start)
+{
+    probe_return(decode, fmt, inlen, rv, errpos);
+    if (start) {
+        call_done(L, decode, fmt, inlen, rv, stats_now() - start);
+    }
+    return rv < 0 ? 2 : 1;
+}
+
+#if LUA_VERSION_NUM >= 502
+// State of an encode/decode call that yields between slices; kept in a
+// userdata at stack index 3 together with the output buffer
+typedef struct {
+    const char *src;
+    size_t len;
+    // input bytes processed
+    size_t off;
+    size_t slice;
+    // output bytes written
+    size_t outlen;
+    // time spent in the previous steps, for the statistics
+    uint64_t ns;
+    int fmt;
+    b32_decoder_t dec;
+    char buf[];
+} stepper_t;
+
+/**
+ * @brief End a step started at `start` and add its time to the stepper. If
+ * the call is completed with `rv`, complete it as call_end() does with the
+ * time of all its steps.
+ *
+ * @return int Number of results of a completed call
+ */
+static int step_end(lua_State *L, stepper_t *st, int decode, int done,
+                    ptrdiff_t rv, size_t errpos, uint64_t start)
+{
+    if (start) {
+        st->ns += stats_now() - start;
+    }
+    if (!done) {
+        return 0;
+    }
+    probe_return(decode, st->fmt, st->len, rv, errpos);
+    if (start) {
+        call_done(L, decode, st->fmt, st->len, rv, st->ns);
+    }
+    return rv < 0 ? 2 : 1;
+}
+
+/**
+ * @brief Push a stepper for the string at index 1 to stack index 3.
+ *
+ * @param L Lua state
+ * @param fmt Base32 format
+ * @param bufsize Size of the output buffer
+ * @return stepper_t* New stepper
+ */
+static stepper_t *new_stepper(lua_State *L, int fmt, size_t bufsize)
+{
+    size_t len      = 0;
+    const char *src = lua_tolstring(L, 1, &len);
+    stepper_t *st   = NULL;
+
+    lua_settop(L, 2);
+    st  = lua_newuserdata(L, sizeof(stepper_t) + bufsize);
+    *st = (stepper_t){
+        .src   = src,
+        .len   = len,
+        .slice = settings(L)->slice,
+        .fmt   = fmt,
+    };
+    return st;
+}
+
+static int encode_step(lua_State *L);
+static int decode_step(lua_State *L);
+
+// Continuation of a call that yielded; the context is non-zero for a decode
+#if LUA_VERSION_NUM >= 503
+static int resume_step(lua_State *L, int status, lua_KContext ctx)
+{
+    (void)status;
+    return ctx ? decode_step(L) : encode_step(L);
+}
+#else
+static int resume_step(lua_State *L)
+{
+    int ctx = 0;
+
+    lua_getctx(L, &ctx);
+    return ctx ? decode_step(L) : encode_step(L);
+}
+#endif
+
+/**
+ * @brief Yield with no values; the next step of the call is run when the
+ * coroutine is resumed.
+ *
+ * @param L Lua state
+ * @param decode Non-zero if the call decodes
+ * @return int Result of lua_yieldk(), to be returned by the caller
+ */
+static int yield_step(lua_State *L, int decode)
+{
+    return lua_yieldk(L, 0, decode, resume_step);
+}
+
+/**
+ * @brief Check if the running call can yield between slices.
+ *
+ * Lua 5.2 has no lua_isyieldable, so only the main thread is ruled out there.
+ *
+ * @param L Lua state
+ * @return int Non-zero if the call can yield
+ */
+static inline int isyieldable(lua_State *L)
+{
+#if LUA_VERSION_NUM >= 503
+    return lua_isyieldable(L);
+#else
+    int ismain = lua_pushthread(L);
+
+    lua_pop(L, 1);
+    return !ismain;
+#endif
+}
+
+static int encode_step(lua_State *L)
+{
+    stepper_t *st  = lua_touserdata(L, 3);
+    size_t n       = st->len - st->off;
+    size_t done    = st->off / 5 * 8;
+    uint64_t start = call_start(L);
+
+    // discard the values passed to coroutine.resume
+    lua_settop(L, 3);
+
+    if (n > st->slice) {
+        n = st->slice;
+    }
+    // every slice but the last is a multiple of 5 bytes, so the output of a
+    // slice does not depend on the next one
+    b32_encode(st->buf + done, st->outlen - done,
+               (const uint8_t *)st->src + st->off, n, st->fmt, B32_NOTHREADS);
+    st->off += n;
+    if (st->off < st->len) {
+        step_end(L, st, 0, 0, 0, 0, start);
+        return yield_step(L, 0);
+    }
+
+    lua_pushlstring(L, st->buf, st->outlen);
+    return step_end(L, st, 0, 1, (ptrdiff_t)st->outlen, 0, start);
+}
+
+static int decode_step(lua_State *L)
+{
+    stepper_t *st  = lua_touserdata(L, 3);
+    size_t n       = st->len - st->off;
+    size_t bufsize = b32_decoded_maxlen(st->len);
+    size_t pos     = 0;
+    uint64_t start = call_start(L);
+    ptrdiff_t rv   = 0;
+
+    // discard the values passed to coroutine.resume
+    lua_settop(L, 3);
+
+    if (n > st->slice) {
+        n = st->slice;
+    }
+    rv = b32_decoder_update(&st->dec, st->buf + st->outlen,
+                            bufsize - st->outlen, st->src + st->off, n, &pos);
+    if (rv < 0) {
+        decode_error(L, "base32.decode", rv, st->src[pos], pos, 0);
+        return step_end(L, st, 1, 1, rv, pos, start);
+    }
+    st->outlen += (size_t)rv;
+    st->off += n;
+    if (st->off < st->len) {
+        step_end(L, st, 1, 0, 0, 0, start);
+        return yield_step(L, 1);
+    }
+
+    rv = b32_decoder_final(&st->dec, st->buf + st->outlen,
+                           bufsize - st->outlen);
+    if (rv < 0) {
+        decode_error(L, "base32.decode", rv, 0, 0, 0);
+        return step_end(L, st, 1, 1, rv, 0, start);
+    }
+    st->outlen += (size_t)rv;
+    lua_pushlstring(L, st->buf, st->outlen);
+    return step_end(L, st, 1, 1, (ptrdiff_t)st->outlen, 0, start);
+}
+#endif
+
+/*
+ * Size classes of base32.encode and base32.decode
+ *
+ * Tiny inputs are converted into a buffer on the C stack and copied into the
+ * result string, without a luaL_Buffer or, on Lua 5.1 and LuaJIT, a scratch
+ * userdata. Larger inputs are converted in a result buffer of the exact
+ * encoded length, or of the decoded length bound, where b32_encode() and
+ * b32_decode() select the kernel, the threads and the stores for their
+ * length as set by base32.set_tuning().
+ */
+
+// Longest input converted in a buffer on the C stack
+#define TINY_MAX 64
+
+static int decode_lua(lua_State *L)
+{
+    size_t len      = 0;
+    const char *src = (const char *)checklbytes(L, 1, &len);
+    int opt         = checkformat(L, 2);
+    size_t pos      = 0;
+    luaL_Buffer b   = {0};
+    char *dst       = NULL;
+    uint64_t start  = call_start(L);
+    ptrdiff_t rv    = 0;
+
+    PROBE2(decode__entry, opt, len);
+    // If the input string is empty, return empty string
+    if (len == 0) {
+        lua_pushliteral(L, "");
+        return call_end(L, 1, opt, 0, 0, 0, start);
+    }
+
+#if LUA_VERSION_NUM >= 502
+    // decode a slice at a time, yielding in between; the steps record the
+    // call when it is completed
+    if (len > settings(L)->slice && settings(L)->slice &&
+        isyieldable(L)) {
+        rv = b32_decode_check(src, len, opt);
+        if (rv < 0) {
+            decode_error(L, "base32.decode", rv, 0, 0, 0);
+            return call_end(L, 1, opt, len, rv, 0, start);
+        }
+        b32_decoder_init(&new_stepper(L, opt, b32_decoded_maxlen(len))->dec,
+                         opt);
+        return decode_step(L);
+    }
+#endif
+
+    if (len <= TINY_MAX) {
+        char buf[TINY_MAX / 8 * 5];
+
+        rv = b32_decode(buf, sizeof(buf), src, len, opt, B32_NOTHREADS, &pos);
+        if (rv < 0) {
+            decode_error(L, "base32.decode", rv, src[pos], pos, 0);
+            return call_end(L, 1, opt, len, rv, pos, start);
+        }
+        lua_pushlstring(L, buf, (size_t)rv);
+        return call_end(L, 1, opt, len, rv, 0, start);
+    }
+
+    dst = prepresult(L, &b, b32_decoded_maxlen(len));
+    rv  = b32_decode(dst, b32_decoded_maxlen(len), src, len, opt, 0, &pos);
+    if (rv < 0) {
+        decode_error(L, "base32.decode", rv, src[pos], pos, 0);
+        return call_end(L, 1, opt, len, rv, pos, start);
+    }
+
+    // Push result as Lua string
+    pushresult(L, &b, dst, (size_t)rv);
+    return call_end(L, 1, opt, len, rv, 0, start);
+}
+
+static int encode_lua(lua_State *L)
+{
+    size_t len         = 0;
+    const uint8_t *src = checklbytes(L, 1, &len);
+    int opt            = checkformat(L, 2);
+    size_t outlen      = b32_encoded_len(len, opt);
+    luaL_Buffer b      = {0};
+    char *dst          = NULL;
+    uint64_t start     = call_start(L);
+
+    PROBE2(encode__entry, opt, len);
+    // If the input string is empty, return empty string
+    if (len == 0) {
+        lua_pushliteral(L, "");
+        return call_end(L, 0, opt, 0, 0, 0, start);
+    }
+
+#if LUA_VERSION_NUM >= 502
+    // encode a slice at a time, yielding in between; the steps record the
+    // call when it is completed
+    if (len > settings(L)->slice && settings(L)->slice &&
+        isyieldable(L)) {
+        stepper_t *st = new_stepper(L, opt, outlen);
+        st->outlen    = outlen;
+        // slices must be a multiple of the quantum
+        st->slice     = (st->slice + 4) / 5 * 5;
+        return encode_step(L);
+    }
+#endif
+
+    if (len <= TINY_MAX) {
+        char buf[(TINY_MAX + 4) / 5 * 8];
+
+        b32_encode(buf, sizeof(buf), src, len, opt, B32_NOTHREADS);
+        lua_pushlstring(L, buf, outlen);
+        return call_end(L, 0, opt, len, (ptrdiff_t)outlen, 0, start);
+    }
+
+    dst = prepresult(L, &b, outlen);
+    b32_encode(dst, outlen, src, len, opt, 0);
+    pushresult(L, &b, dst, outlen);
+    return call_end(L, 0, opt, len, (ptrdiff_t)outlen, 0, start);
+}
+
+/**
+ * @brief Encode or decode every string of the list at index 1.
+ *
+ * The string pointers and lengths are copied out of the list, so that the
+ * items can be processed by the worker threads without touching the Lua
+ * state. Results are returned in a new list in the same order.
+ *
+ * @param L Lua state
+ * @param op Name of the operation
+ * @param run Batch function of the core library
+ * @param decode Non-zero if `run` decodes
+ * @return int Number of return values
+ */
+static int batch_lua(lua_State *L, const char *op,
+                     void (*run)(b32_item_t *, size_t, int, int), int decode)
+{
+    int fmt           = 0;
+    size_t n          = 0;
+    size_t total      = 0;
+    b32_item_t *items = NULL;
+    char *buf         = NULL;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    fmt   = checkformat(L, 2);
+    n     = rawlen(L, 1);
+    items = (b32_item_t *)lua_newuserdata(L, sizeof(b32_item_t) * n);
+    for (size_t i = 0; i < n; i++) {
+        b32_item_t *it = items + i;
+
+        lua_rawgeti(L, 1, (lua_Integer)i + 1);
+        if (lua_type(L, -1) != LUA_TSTRING) {
+            return luaL_argerror(
+                L, 1,
+                lua_pushfstring(L, "string expected at index %d, got %s",
+                                (int)i + 1, luaL_typename(L, -1)));
+        }
+        // the string is kept alive by the list
+        it->src    = lua_tolstring(L, -1, &it->srclen);
+        it->dstlen = decode ? b32_decoded_maxlen(it->srclen) :
+                              b32_encoded_len(it->srclen, fmt);
+        total += it->dstlen;
+        lua_pop(L, 1);
+    }
+
+    // allocate one output buffer for all items
+    buf = (char *)lua_newuserdata(L, total);
+    for (size_t i = 0; i < n; i++) {
+        items[i].dst = buf;
+        buf += items[i].dstlen;
+    }
+
+    run(items, n, fmt, 0);
+    for (size_t i = 0; decode && i < n; i++) {
+        if (items[i].rv < 0) {
+            b32_item_t *it = items + i;
+            return decode_error(L, op, it->rv,
+                                it->rv == B32_EILSEQ ? it->src[it->errpos] : 0,
+                                it->errpos, i + 1);
+        }
+    }
+
+    lua_createtable(L, (int)n, 0);
+    for (size_t i = 0; i < n; i++) {
+        lua_pushlstring(L, items[i].dst, (size_t)items[i].rv);
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+    return 1;
+}
+
+static int encode_batch_lua(lua_State *L)
+{
+    return batch_lua(L, "base32.encode_batch", b32_encode_batch, 0);
+}
+
+static int decode_batch_lua(lua_State *L)
+{
+    return batch_lua(L, "base32.decode_batch", b32_decode_batch, 1);
+}
+
+static int encode_many_lua(lua_State *L)
+{
+    return batch_lua(L, "base32.encode_many", b32_encode_many, 0);
+}
+
+static int decode_many_lua(lua_State *L)
+{
+    return batch_lua(L, "base32.decode_many", b32_decode_many, 1);
+}
+
+#define BASE32_FUTURE_MT "base32.future"
+
+// Asynchronous conversion started by encode_async/decode_async
+typedef struct {
+    b32_async_t *task;
+    const char *op;
+    // input string and output buffer, anchored in the registry until the
+    // conversion is completed
+    const char *src;
+    char *dst;
+    int srcref;
+    int dstref;
+    // cached result string or error object
+    int resref;
+    int failed;
+} future_t;
+
+/**
+ * @brief Wait for the conversion of `f` and cache its result.
+ *
+ * The input string and the output buffer are released once the result is
+ * cached.
+ *
+ * @param L Lua state
+ * @param f Future
+ */
+static void future_settle(lua_State *L, future_t *f)
+{
+    size_t pos   = 0;
+    ptrdiff_t rv = b32_async_wait(f->task, &pos);
+
+    if (rv == B32_ECANCELED) {
+        errno = ECANCELED;
+        lua_errno_new_with_message(L, errno, f->op, "operation canceled");
+        f->failed = 1;
+    } else if (rv < 0) {
+        decode_error(L, f->op, rv, f->src[pos], pos, 0);
+        lua_replace(L, -2);
+        f->failed = 1;
+    } else {
+        lua_pushlstring(L, f->dst, (size_t)rv);
+    }
+    f->resref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    luaL_unref(L, LUA_REGISTRYINDEX, f->srcref);
+    luaL_unref(L, LUA_REGISTRYINDEX, f->dstref);
+    f->srcref = f->dstref = LUA_NOREF;
+    f->src = f->dst = NULL;
+}
+
+static int future_fd_lua(lua_State *L)
+{
+    future_t *f = luaL_checkudata(L, 1, BASE32_FUTURE_MT);
+    lua_pushinteger(L, b32_async_fd(f->task));
+    return 1;
+}
+
+static int future_ready_lua(lua_State *L)
+{
+    future_t *f = luaL_checkudata(L, 1, BASE32_FUTURE_MT);
+    lua_pushboolean(L, b32_async_ready(f->task));
+    return 1;
+}
+
+static int future_result_lua(lua_State *L)
+{
+    future_t *f = luaL_checkudata(L, 1, BASE32_FUTURE_MT);
+
+    if (f->resref == LUA_NOREF) {
+        future_settle(L, f);
+    }
+    if (f->failed) {
+        lua_pushnil(L);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, f->resref);
+        return 2;
+    }
+    lua_rawgeti(L, LUA_REGISTRYINDEX, f->resref);
+    return 1;
+}
 
-static int decode_lua(lua_State *L)
+static int future_cancel_lua(lua_State *L)
 {
-    size_t len               = 0;
-    const uint8_t *src       = checklbytes(L, 1, &len);
-    const char *const opts[] = {"rfc", "crockford", NULL};
-    int opt                  = luaL_checkoption(L, 2, "rfc", opts);
-    const uint8_t *tbl       = NULL;
-    uint64_t acc             = 0;
-    int nbits                = 0;
-    luaL_Buffer b            = {0};
+    future_t *f = luaL_checkudata(L, 1, BASE32_FUTURE_MT);
+    b32_async_cancel(f->task);
+    return 0;
+}
 
-    // If the input string is empty, return empty string
-    if (len == 0) {
-        lua_pushliteral(L, "");
-        return 1;
+static int future_gc_lua(lua_State *L)
+{
+    future_t *f = luaL_checkudata(L, 1, BASE32_FUTURE_MT);
+
+    // wait for the running chunks before the buffers can be collected
+    b32_async_free(f->task);
+    f->task = NULL;
+    luaL_unref(L, LUA_REGISTRYINDEX, f->srcref);
+    luaL_unref(L, LUA_REGISTRYINDEX, f->dstref);
+    luaL_unref(L, LUA_REGISTRYINDEX, f->resref);
+    f->srcref = f->dstref = f->resref = LUA_NOREF;
+    return 0;
+}
+
+/**
+ * @brief Start converting the string at index 1 on the worker threads and
+ * push a future for its result.
+ *
+ * @param L Lua state
+ * @param op Name of the operation
+ * @param decode Non-zero to decode
+ * @return int Number of return values
+ */
+static int async_lua(lua_State *L, const char *op, int decode)
+{
+    size_t len      = 0;
+    const char *src = (const char *)checklbytes(L, 1, &len);
+    int fmt         = checkformat(L, 2);
+    size_t outlen   = decode ? b32_decoded_maxlen(len) :
+                               b32_encoded_len(len, fmt);
+    future_t *f     = lua_newuserdata(L, sizeof(future_t));
+    int rv          = 0;
+
+    *f = (future_t){
+        .op     = op,
+        .src    = src,
+        .srcref = LUA_NOREF,
+        .dstref = LUA_NOREF,
+        .resref = LUA_NOREF,
+    };
+    luaL_getmetatable(L, BASE32_FUTURE_MT);
+    lua_setmetatable(L, -2);
+
+    f->dst    = lua_newuserdata(L, outlen);
+    f->dstref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_pushvalue(L, 1);
+    f->srcref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    if (decode) {
+        rv = b32_decode_async(&f->task, f->dst, outlen, src, len, fmt);
+    } else {
+        rv = b32_encode_async(&f->task, f->dst, outlen, src, len, fmt);
     }
+    if (rv == B32_ESYS) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, op);
+        return 2;
+    } else if (rv < 0) {
+        return decode_error(L, op, rv, 0, 0, 0);
+    }
+    return 1;
+}
 
-    // reset errno for error handling
-    errno = 0;
-
-    // select lookup table based on format
-    switch (opt) {
-    case 0: { // RFC 4648 Base32
-        tbl = RFC_DECODE_TABLE;
-        // RFC 4648 Base32 requires input length to be a multiple of 8
-        if (len % 8 != 0) {
-            lua_pushnil(L);
-            errno = EINVAL;
-            lua_errno_new_with_message(
-                L, errno, "base32.decode",
-                "RFC 4648 Base32 requires input length to be a multiple of 8");
-            return 2;
-        }
+/**
+ * @brief Get the file conversion flags from the `io` field of the options
+ * table at index `arg`.
+ *
+ * @param L Lua state
+ * @param arg Argument index of the options table
+ * @return int 0, or B32_PIPELINE optionally combined with B32_NOURING
+ */
+static int optio(lua_State *L, int arg)
+{
+    static const char *const opts[] = {"mmap", "uring", "pread", NULL};
+    static const int flags[]        = {
+        0,
+        B32_PIPELINE,
+        B32_PIPELINE | B32_NOURING,
+    };
+    int opt = 0;
 
-        // remove padding characters
-        int npad      = 0;
-        uint8_t *tail = (uint8_t *)src + len;
-        for (; tail > src && tail[-1] == '='; --tail) {
-            len--;
-            npad++;
-            if (npad > 6) {
-                // RFC 4648 Base32 allows at most 6 padding characters
-                lua_pushnil(L);
-                errno = EINVAL;
-                lua_errno_new_with_message(
-                    L, errno, "base32.decode",
-                    "RFC 4648 Base32 padding length must be 0, 1, 3, 4, or 6");
-                return 2;
+    if (lua_isnoneornil(L, arg)) {
+        return 0;
+    }
+    luaL_checktype(L, arg, LUA_TTABLE);
+    lua_getfield(L, arg, "io");
+    if (!lua_isnil(L, -1)) {
+        const char *name = lua_tostring(L, -1);
+        for (opt = 0; opts[opt]; opt++) {
+            if (name && strcmp(name, opts[opt]) == 0) {
+                break;
             }
         }
-        // number of padding characters must be 0, 1, 3, 4, or 6
-        if (npad != 0 && npad != 1 && npad != 3 && npad != 4 && npad != 6) {
-            lua_pushnil(L);
-            errno = EINVAL;
-            lua_errno_new_with_message(
-                L, errno, "base32.decode",
-                "RFC 4648 Base32 padding length must be 0, 1, 3, 4, or 6");
-            return 2;
+        if (!opts[opt]) {
+            luaL_argerror(L, arg,
+                          "opts.io must be \"mmap\", \"uring\" or \"pread\"");
         }
-    } break;
+    }
+    lua_pop(L, 1);
+    return flags[opt];
+}
 
-    case 1: // crockford
-        tbl = CROCKFORD_DECODE_TABLE;
-        break;
+/**
+ * @brief Push nil and the error of a file function that is not a decoding
+ * error.
+ *
+ * @return int 2
+ */
+static int file_error(lua_State *L, const char *op, ptrdiff_t rv)
+{
+    lua_pushnil(L);
+    if (rv == B32_EINVAL) {
+        // the format and the flags have been checked by the binding
+        lua_errno_new_with_message(L, EINVAL, op,
+                                   "input and output are the same file");
+    } else {
+        lua_errno_new(L, errno, op);
     }
+    return 2;
+}
 
-    // Calculate maximum output size (5 bits per character -> 8 bits per
-    // byte) size_t dstlen      = (len * 5 + 7) / 8;
-    luaL_buffinit(L, &b);
+static int encode_file_lua(lua_State *L)
+{
+    const char *inpath  = luaL_checkstring(L, 1);
+    const char *outpath = luaL_checkstring(L, 2);
+    int fmt             = checkformat(L, 3);
+    int flags           = optio(L, 4);
+    ptrdiff_t rv        = b32_encode_file(inpath, outpath, fmt, flags);
 
-    for (size_t i = 0; i < len; i++) {
-        uint8_t c  = src[i];
-        uint8_t dc = tbl[c];
+    if (rv < 0) {
+        return file_error(L, "base32.encode_file", rv);
+    }
+    lua_pushinteger(L, (lua_Integer)rv);
+    return 1;
+}
 
-        // In Crockford's Base32, '-' is allowed for readability
-        if (c == '-' && tbl == CROCKFORD_DECODE_TABLE) {
-            continue;
-        }
+static int decode_file_lua(lua_State *L)
+{
+    const char *inpath  = luaL_checkstring(L, 1);
+    const char *outpath = luaL_checkstring(L, 2);
+    int fmt             = checkformat(L, 3);
+    int flags           = optio(L, 4);
+    size_t pos          = 0;
+    int c               = 0;
+    ptrdiff_t rv        = 0;
 
-        // Check if character is valid
-        if (dc > 31) {
-            char errmsg[256] = {0};
-            snprintf(errmsg, sizeof(errmsg),
-                     "Illegal character in Base32 string: '%c' (0x%02X) at "
-                     "position %d",
-                     c, c, (int)(i + 1));
-            lua_pushnil(L);
-            errno = EILSEQ;
-            lua_errno_new_with_message(L, errno, "base32.decode", errmsg);
-            return 2;
-        }
+    rv = b32_decode_file(inpath, outpath, fmt, flags, &pos, &c);
+    if (rv == B32_ESYS || rv == B32_EINVAL) {
+        return file_error(L, "base32.decode_file", rv);
+    } else if (rv < 0) {
+        return decode_error(L, "base32.decode_file", rv, (uint8_t)c, pos, 0);
+    }
+    lua_pushinteger(L, (lua_Integer)rv);
+    return 1;
+}
 
-        // Add 5 bits to buffer
-        acc = (acc << 5) | dc;
-        nbits += 5;
-
-        // Extract 5 bytes when we have 40 bits
-        if (nbits >= 40) {
-            // Extract 5 bytes (40 bits)
-            char buf[5] = {
-                (acc >> 32) & 0xFF, (acc >> 24) & 0xFF, (acc >> 16) & 0xFF,
-                (acc >> 8) & 0xFF,  acc & 0xFF,
-            };
-            luaL_addlstring(&b, buf, 5);
-            acc >>= 40;
-            nbits -= 40;
-        }
+/**
+ * @brief Check if the argument at index `arg` is an open Lua file handle and
+ * return its FILE pointer.
+ *
+ * @param L Lua state
+ * @param arg Argument index
+ * @return FILE* File pointer
+ */
+static FILE *checkfile(lua_State *L, int arg)
+{
+#if LUA_VERSION_NUM >= 502
+    luaL_Stream *p = luaL_checkudata(L, arg, LUA_FILEHANDLE);
+    if (!p->closef) {
+        luaL_argerror(L, arg, "attempt to use a closed file");
     }
+    return p->f;
+#else
+    // Lua 5.1 and LuaJIT store the FILE pointer first in the userdata
+    FILE **pf = luaL_checkudata(L, arg, LUA_FILEHANDLE);
+    if (!*pf) {
+        luaL_argerror(L, arg, "attempt to use a closed file");
+    }
+    return *pf;
+#endif
+}
 
-    // Handle remaining bits (less than 40 bits)
-    while (nbits >= 8) {
-        nbits -= 8;
-        luaL_addchar(&b, (acc >> nbits) & 0xFF);
+static int encode_stream_lua(lua_State *L)
+{
+    FILE *in       = checkfile(L, 1);
+    FILE *out      = checkfile(L, 2);
+    int fmt        = checkformat(L, 3);
+    lua_Integer bs = luaL_optinteger(L, 4, 0);
+    ptrdiff_t rv   = 0;
+
+    luaL_argcheck(L, bs >= 0 && bs <= B32_STREAM_MAX_BUFSIZE, 4,
+                  "buffer size must be between 0 and 1 GiB");
+    rv = b32_encode_stream(in, out, fmt, (size_t)bs);
+    if (rv < 0) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "base32.encode_stream");
+        return 2;
     }
+    lua_pushinteger(L, (lua_Integer)rv);
+    return 1;
+}
 
-    // Push result as Lua string
-    luaL_pushresult(&b);
+static int decode_stream_lua(lua_State *L)
+{
+    FILE *in       = checkfile(L, 1);
+    FILE *out      = checkfile(L, 2);
+    int fmt        = checkformat(L, 3);
+    lua_Integer bs = luaL_optinteger(L, 4, 0);
+    size_t pos     = 0;
+    int c          = 0;
+    ptrdiff_t rv   = 0;
+
+    luaL_argcheck(L, bs >= 0 && bs <= B32_STREAM_MAX_BUFSIZE, 4,
+                  "buffer size must be between 0 and 1 GiB");
+    rv = b32_decode_stream(in, out, fmt, (size_t)bs, &pos, &c);
+    if (rv == B32_ESYS) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "base32.decode_stream");
+        return 2;
+    } else if (rv < 0) {
+        return decode_error(L, "base32.decode_stream", rv, (uint8_t)c, pos, 0);
+    }
+    lua_pushinteger(L, (lua_Integer)rv);
     return 1;
 }
 
-// RFC 4648 Base32 encoding/decoding
-// https://datatracker.ietf.org/doc/html/rfc4648#section-6
-static const char RFC_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+static int encode_async_lua(lua_State *L)
+{
+    return async_lua(L, "base32.encode_async", 0);
+}
 
-// Crockford's Base32 alphabet (excluding I, L, O, U)
-static const char CROCKFORD_ALPHABET[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+static int decode_async_lua(lua_State *L)
+{
+    return async_lua(L, "base32.decode_async", 1);
+}
 
-static int encode_lua(lua_State *L)
+static int tostring_lua(lua_State *L)
 {
-    size_t len               = 0;
-    const uint8_t *src       = checklbytes(L, 1, &len);
-    const uint8_t *head      = src;
-    const uint8_t *tail      = head + len;
-    const char *const opts[] = {"rfc", "crockford", NULL};
-    int opt                  = luaL_checkoption(L, 2, "rfc", opts);
-    const char *tbl          = NULL;
-    size_t outlen            = 0;
-    luaL_Buffer b            = {0};
+    luaL_getmetafield(L, 1, "__name");
+    lua_pushfstring(L, "%s: %p", lua_tostring(L, -1), lua_touserdata(L, 1));
+    return 1;
+}
 
-    // If the input string is empty, return empty string
-    if (len == 0) {
+static const luaL_Reg future_mmethods[] = {
+    {"__gc",       future_gc_lua},
+    {"__tostring", tostring_lua },
+    {NULL,         NULL         }
+};
+
+static const luaL_Reg future_methods[] = {
+    {"fd",     future_fd_lua    },
+    {"ready",  future_ready_lua },
+    {"result", future_result_lua},
+    {"cancel", future_cancel_lua},
+    {NULL,     NULL             }
+};
+
+#define BASE32_ENCODER_MT "base32.encoder"
+
+// Streaming encoder created by base32.encoder
+typedef struct {
+    b32_encoder_t enc;
+    int closed;
+} encoder_t;
+
+static encoder_t *checkencoder(lua_State *L)
+{
+    encoder_t *e = luaL_checkudata(L, 1, BASE32_ENCODER_MT);
+    if (e->closed) {
+        luaL_error(L, "attempt to use a closed " BASE32_ENCODER_MT);
+    }
+    return e;
+}
+
+static int encoder_update_lua(lua_State *L)
+{
+    encoder_t *e       = checkencoder(L);
+    size_t len         = 0;
+    const uint8_t *src = checklbytes(L, 2, &len);
+    size_t outlen      = b32_encoder_outlen(&e->enc, len);
+    luaL_Buffer b      = {0};
+    char *dst          = NULL;
+
+    if (outlen == 0) {
+        // not enough bytes for a quantum yet
+        b32_encoder_update(&e->enc, NULL, 0, src, len);
         lua_pushliteral(L, "");
         return 1;
     }
 
-    // select lookup table based on option
-    switch (opt) {
-    case 0: // RFC 4648 Base32
-        tbl = RFC_ALPHABET;
-        break;
-    case 1: // crockford
-        tbl = CROCKFORD_ALPHABET;
-        break;
+    dst = prepresult(L, &b, outlen);
+    b32_encoder_update(&e->enc, dst, outlen, src, len);
+    pushresult(L, &b, dst, outlen);
+    return 1;
+}
+
+static int encoder_finish_lua(lua_State *L)
+{
+    encoder_t *e = checkencoder(L);
+    char dst[8]  = {0};
+    ptrdiff_t rv = b32_encoder_final(&e->enc, dst, sizeof(dst));
+
+    lua_pushlstring(L, dst, (size_t)rv);
+    return 1;
+}
+
+static int encoder_export_lua(lua_State *L)
+{
+    encoder_t *e                 = checkencoder(L);
+    char state[B32_STATE_MAXLEN] = {0};
+
+    lua_pushlstring(L, state, b32_encoder_export(&e->enc, state));
+    lua_pushinteger(L, (lua_Integer)e->enc.pos);
+    return 2;
+}
+
+static int encoder_close_lua(lua_State *L)
+{
+    encoder_t *e = luaL_checkudata(L, 1, BASE32_ENCODER_MT);
+
+    // do not keep the buffered bytes around
+    b32_encoder_init(&e->enc, e->enc.fmt);
+    e->closed = 1;
+    return 0;
+}
+
+static const luaL_Reg encoder_mmethods[] = {
+    {"__close",    encoder_close_lua},
+    {"__tostring", tostring_lua     },
+    {NULL,         NULL             }
+};
+
+static const luaL_Reg encoder_methods[] = {
+    {"update", encoder_update_lua},
+    {"finish", encoder_finish_lua},
+    {"export", encoder_export_lua},
+    {"close",  encoder_close_lua },
+    {NULL,     NULL              }
+};
+
+/**
+ * @brief Return the serialized stream state in the `state` field of the
+ * options table at index 2, or NULL if there is none.
+ *
+ * @param L Lua state
+ * @param len Receives the length of the state
+ * @return const char* Serialized state
+ */
+static const char *optstate(lua_State *L, size_t *len)
+{
+    const char *state = NULL;
+
+    if (lua_isnoneornil(L, 2)) {
+        return NULL;
+    }
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_getfield(L, 2, "state");
+    if (!lua_isnil(L, -1)) {
+        if (lua_type(L, -1) != LUA_TSTRING) {
+            luaL_argerror(L, 2, "opts.state must be a string");
+        }
+        // the string is kept alive by the options table
+        state = lua_tolstring(L, -1, len);
+    }
+    lua_pop(L, 1);
+    return state;
+}
+
+/**
+ * @brief Push nil and an error object for a stream state that cannot be
+ * restored.
+ *
+ * @param L Lua state
+ * @param op Name of the operation
+ * @param msg Error message
+ * @return int Number of return values (2)
+ */
+static int state_error(lua_State *L, const char *op, const char *msg)
+{
+    errno = EINVAL;
+    lua_pushnil(L);
+    lua_errno_new_with_message(L, errno, op, msg);
+    return 2;
+}
+
+static int encoder_lua(lua_State *L)
+{
+    int fmt           = lua_isnoneornil(L, 1) ? -1 : checkformat(L, 1);
+    size_t len        = 0;
+    const char *state = optstate(L, &len);
+    encoder_t *e      = lua_newuserdata(L, sizeof(encoder_t));
+
+    *e = (encoder_t){0};
+    if (!state) {
+        b32_encoder_init(&e->enc, fmt < 0 ? B32_RFC : fmt);
+    } else if (b32_encoder_import(&e->enc, state, len) != 0) {
+        return state_error(L, "base32.encoder", "malformed encoder state");
+    } else if (fmt >= 0 && fmt != e->enc.fmt) {
+        return state_error(L, "base32.encoder",
+                           "encoder state is for another format");
+    }
+    luaL_getmetatable(L, BASE32_ENCODER_MT);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+#define BASE32_DECODER_MT "base32.decoder"
+
+// Streaming decoder created by base32.decoder
+typedef struct {
+    b32_decoder_t dec;
+    int closed;
+} decoder_t;
+
+static decoder_t *checkdecoder(lua_State *L)
+{
+    decoder_t *d = luaL_checkudata(L, 1, BASE32_DECODER_MT);
+    if (d->closed) {
+        luaL_error(L, "attempt to use a closed " BASE32_DECODER_MT);
+    }
+    return d;
+}
+
+static int decoder_update_lua(lua_State *L)
+{
+    decoder_t *d    = checkdecoder(L);
+    size_t len      = 0;
+    const char *src = (const char *)checklbytes(L, 2, &len);
+    size_t base     = d->dec.pos;
+    size_t outlen   = b32_decoder_outlen(&d->dec, len);
+    size_t pos      = 0;
+    luaL_Buffer b   = {0};
+    char *dst       = NULL;
+    ptrdiff_t rv    = 0;
+
+    dst = prepresult(L, &b, outlen);
+    rv  = b32_decoder_update(&d->dec, dst, outlen, src, len, &pos);
+    if (rv < 0) {
+        b32_decoder_init(&d->dec, d->dec.fmt);
+        // the position is an offset in the whole stream; only misplaced
+        // padding characters can be in a previous chunk
+        return decode_error(L, BASE32_DECODER_MT, rv,
+                            pos >= base ? src[pos - base] : '=', pos, 0);
+    }
+    pushresult(L, &b, dst, (size_t)rv);
+    return 1;
+}
+
+static int decoder_finish_lua(lua_State *L)
+{
+    decoder_t *d = checkdecoder(L);
+    char dst[4]  = {0};
+    ptrdiff_t rv = b32_decoder_final(&d->dec, dst, sizeof(dst));
+
+    if (rv < 0) {
+        b32_decoder_init(&d->dec, d->dec.fmt);
+        return decode_error(L, BASE32_DECODER_MT, rv, 0, 0, 0);
+    }
+    lua_pushlstring(L, dst, (size_t)rv);
+    return 1;
+}
+
+static int decoder_export_lua(lua_State *L)
+{
+    decoder_t *d                 = checkdecoder(L);
+    char state[B32_STATE_MAXLEN] = {0};
+
+    lua_pushlstring(L, state, b32_decoder_export(&d->dec, state));
+    lua_pushinteger(L, (lua_Integer)d->dec.pos);
+    return 2;
+}
+
+static int decoder_close_lua(lua_State *L)
+{
+    decoder_t *d = luaL_checkudata(L, 1, BASE32_DECODER_MT);
+
+    // do not keep the buffered bits around
+    b32_decoder_init(&d->dec, d->dec.fmt);
+    d->closed = 1;
+    return 0;
+}
+
+static const luaL_Reg decoder_mmethods[] = {
+    {"__close",    decoder_close_lua},
+    {"__tostring", tostring_lua     },
+    {NULL,         NULL             }
+};
+
+static const luaL_Reg decoder_methods[] = {
+    {"update", decoder_update_lua},
+    {"finish", decoder_finish_lua},
+    {"export", decoder_export_lua},
+    {"close",  decoder_close_lua },
+    {NULL,     NULL              }
+};
+
+static int decoder_lua(lua_State *L)
+{
+    int fmt           = lua_isnoneornil(L, 1) ? -1 : checkformat(L, 1);
+    size_t len        = 0;
+    const char *state = optstate(L, &len);
+    decoder_t *d      = lua_newuserdata(L, sizeof(decoder_t));
+
+    *d = (decoder_t){0};
+    if (!state) {
+        b32_decoder_init(&d->dec, fmt < 0 ? B32_RFC : fmt);
+    } else if (b32_decoder_import(&d->dec, state, len) != 0) {
+        return state_error(L, "base32.decoder", "malformed decoder state");
+    } else if (fmt >= 0 && fmt != d->dec.fmt) {
+        return state_error(L, "base32.decoder",
+                           "decoder state is for another format");
+    }
+    luaL_getmetatable(L, BASE32_DECODER_MT);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+static int set_yield_lua(lua_State *L)
+{
+    settings_t *cfg = settings(L);
+    lua_Integer n   = luaL_optinteger(L, 1, (lua_Integer)cfg->slice);
+
+    luaL_argcheck(L, n >= 0, 1, "slice size must be a non-negative integer");
+#if LUA_VERSION_NUM < 502
+    // a C function cannot continue after a yield without the continuations
+    // of Lua 5.2
+    luaL_argcheck(L, n == 0, 1, "yielding requires Lua 5.2 or later");
+#endif
+    // return the previous setting
+    lua_pushinteger(L, (lua_Integer)cfg->slice);
+    cfg->slice = (size_t)n;
+    return 1;
+}
+
+static int set_slow_hook_lua(lua_State *L)
+{
+    settings_t *cfg = settings(L);
+    lua_Integer ns  = luaL_optinteger(L, 1, 0);
+
+    luaL_argcheck(L, ns >= 0, 1, "threshold must be a non-negative integer");
+    if (!lua_isnoneornil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+    }
+    lua_settop(L, 2);
+
+    // return the previous settings
+    if (cfg->hooked) {
+        lua_pushinteger(L, (lua_Integer)cfg->slow_ns);
+        lua_pushlightuserdata(L, cfg);
+        lua_rawget(L, LUA_REGISTRYINDEX);
+    } else {
+        lua_pushnil(L);
+        lua_pushnil(L);
+    }
+
+    lua_pushlightuserdata(L, cfg);
+    lua_pushvalue(L, 2);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+    cfg->hooked  = !lua_isnil(L, 2);
+    cfg->slow_ns = (uint64_t)ns;
+    return 2;
+}
+
+static int set_threads_lua(lua_State *L)
+{
+    size_t threshold = 0;
+    int nthr         = b32_get_threads(&threshold);
+    lua_Integer n    = luaL_optinteger(L, 1, nthr);
+    lua_Integer t    = luaL_optinteger(L, 2, (lua_Integer)threshold);
+
+    luaL_argcheck(L, n >= 1 && n <= B32_MAX_THREADS, 1,
+                  "number of threads must be between 1 and 256");
+    luaL_argcheck(L, t >= 0, 2, "threshold must be a non-negative integer");
+    b32_set_threads((int)n, (size_t)t);
+
+    // return the previous settings
+    lua_pushinteger(L, nthr);
+    lua_pushinteger(L, (lua_Integer)threshold);
+    return 2;
+}
+
+// Push a threshold, with SIZE_MAX as math.huge.
+static inline void pushthreshold(lua_State *L, size_t v)
+{
+    if (v == SIZE_MAX) {
+        lua_pushnumber(L, HUGE_VAL);
+    } else {
+        lua_pushinteger(L, (lua_Integer)v);
+    }
+}
+
+static void pushtuning(lua_State *L, const b32_tuning_t *t)
+{
+    lua_createtable(L, 0, 4);
+    pushthreshold(L, t->encode_block);
+    lua_setfield(L, -2, "encode_block");
+    pushthreshold(L, t->decode_block);
+    lua_setfield(L, -2, "decode_block");
+    pushthreshold(L, t->parallel);
+    lua_setfield(L, -2, "parallel");
+    pushthreshold(L, t->nontemporal);
+    lua_setfield(L, -2, "nontemporal");
+}
+
+/**
+ * @brief Update `*v` with the field `name` of the table at index 1 if it is
+ * not nil; math.huge is SIZE_MAX.
+ */
+static void optthreshold(lua_State *L, const char *name, size_t *v)
+{
+    lua_getfield(L, 1, name);
+    if (lua_type(L, -1) == LUA_TNUMBER && lua_tonumber(L, -1) == HUGE_VAL) {
+        *v = SIZE_MAX;
+    } else if (!lua_isnil(L, -1)) {
+        lua_Number n = lua_tonumber(L, -1);
+
+        if (!lua_isnumber(L, -1) || n < 0 || n != floor(n)) {
+            luaL_argerror(L, 1,
+                          lua_pushfstring(L,
+                                          "%s must be a non-negative integer",
+                                          name));
+        }
+        *v = (size_t)n;
+    }
+    lua_pop(L, 1);
+}
+
+static int set_tuning_lua(lua_State *L)
+{
+    b32_tuning_t prev = {0};
+    b32_tuning_t t    = {0};
+
+    b32_get_tuning(&prev);
+    t = prev;
+    if (!lua_isnoneornil(L, 1)) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        optthreshold(L, "encode_block", &t.encode_block);
+        optthreshold(L, "decode_block", &t.decode_block);
+        optthreshold(L, "parallel", &t.parallel);
+        optthreshold(L, "nontemporal", &t.nontemporal);
+        b32_set_tuning(&t);
+    }
+    // return the previous settings
+    pushtuning(L, &prev);
+    return 1;
+}
+
+static int calibrate_lua(lua_State *L)
+{
+    const char *path = luaL_optstring(L, 1, NULL);
+    b32_tuning_t t   = {0};
+
+    if (b32_calibrate(&t) != 0 || (path && b32_save_tuning(path, &t) != 0)) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "base32.calibrate");
+        return 2;
+    }
+    pushtuning(L, &t);
+    return 1;
+}
+
+/**
+ * @brief Load the thresholds saved by base32.calibrate() into the file named
+ * by the BASE32_TUNING environment variable, once per process. A missing or
+ * malformed file leaves the defaults.
+ */
+static void load_tuning(void)
+{
+    static int loaded = 0;
+    const char *path  = getenv("BASE32_TUNING");
+    b32_tuning_t t    = {0};
+
+    if (__atomic_exchange_n(&loaded, 1, __ATOMIC_RELAXED) || !path ||
+        !*path) {
+        return;
+    }
+    b32_get_tuning(&t);
+    if (b32_load_tuning(path, &t) == 0) {
+        b32_set_tuning(&t);
+    }
+}
+
+static int set_stats_lua(lua_State *L)
+{
+    int enabled = __atomic_load_n(&StatsEnabled, __ATOMIC_RELAXED);
+
+    if (!lua_isnoneornil(L, 1)) {
+        luaL_checktype(L, 1, LUA_TBOOLEAN);
+#if !defined(BASE32_NOSTATS)
+        __atomic_store_n(&StatsEnabled, lua_toboolean(L, 1), __ATOMIC_RELAXED);
+#endif
+    }
+    // return the previous setting
+    lua_pushboolean(L, enabled);
+    return 1;
+}
+
+/**
+ * @brief Sum the copies of the counters of a direction and format into `sum`.
+ */
+static void stats_sum(stats_t *sum, int decode, int fmt)
+{
+    uint64_t *dst = (uint64_t *)sum;
+
+    *sum = (stats_t){0};
+    for (int i = 0; i < STATS_NSHARDS; i++) {
+        // the counters may be updated concurrently by other threads
+        const uint64_t *src = (const uint64_t *)&Stats[i][decode][fmt];
+        for (size_t j = 0; j < sizeof(stats_t) / sizeof(uint64_t); j++) {
+            dst[j] += __atomic_load_n(&src[j], __ATOMIC_RELAXED);
+        }
     }
+}
+
+/**
+ * @brief Push a list of the non-empty log2 buckets of `counts`, and of
+ * `ns` if not NULL, as tables {min = , max = , calls = [, ns = ]}.
+ */
+static void pushbuckets(lua_State *L, const uint64_t *counts,
+                        const uint64_t *ns)
+{
+    int n = 0;
 
-    luaL_buffinit(L, &b);
-
-    // Process 5 bytes at a time (40 bits -> 8 characters)
-    while ((tail - head) >= 5) {
-        // Load 5 bytes (40 bits)
-        uint64_t acc = ((uint64_t)head[0] << 32) | ((uint64_t)head[1] << 24) |
-                       ((uint64_t)head[2] << 16) | ((uint64_t)head[3] << 8) |
-                       (uint64_t)head[4];
-        // Extract 8 characters (5 bits each)
-        char buf[8] = {tbl[(acc >> 35) & 0x1F], tbl[(acc >> 30) & 0x1F],
-                       tbl[(acc >> 25) & 0x1F], tbl[(acc >> 20) & 0x1F],
-                       tbl[(acc >> 15) & 0x1F], tbl[(acc >> 10) & 0x1F],
-                       tbl[(acc >> 5) & 0x1F],  tbl[acc & 0x1F]};
-        luaL_addlstring(&b, buf, 8);
-        outlen += 8; // Increment output length by 8 characters
-        head += 5;   // Move source pointer forward by 5 bytes
-    }
-
-    // Handle remaining bytes (1-4 bytes)
-    if (head < tail) {
-        uint32_t acc = 0;
-        int nbits    = 0;
-
-        // Load remaining bytes into accumulator
-        while (head < tail) {
-            acc = (acc << 8) | *head++;
-            nbits += 8;
+    lua_newtable(L);
+    for (int b = 0; b < STATS_NBUCKETS; b++) {
+        if (counts[b] == 0) {
+            continue;
         }
-        // Extract all complete 5-bit groups
-        while (nbits >= 5) {
-            nbits -= 5;
-            luaL_addchar(&b, tbl[(acc >> nbits) & 0x1F]);
-            outlen++;
+        lua_createtable(L, 0, 4);
+        lua_pushinteger(L, b ? (lua_Integer)1 << (b - 1) : 0);
+        lua_setfield(L, -2, "min");
+        if (b == STATS_NBUCKETS - 1) {
+            lua_pushnumber(L, HUGE_VAL);
+        } else {
+            lua_pushinteger(L, b ? ((lua_Integer)1 << b) - 1 : 0);
         }
-        // Handle remaining bits (if any)
-        if (nbits > 0) {
-            luaL_addchar(&b, tbl[(acc << (5 - nbits)) & 0x1F]);
-            outlen++;
+        lua_setfield(L, -2, "max");
+        lua_pushinteger(L, (lua_Integer)counts[b]);
+        lua_setfield(L, -2, "calls");
+        if (ns) {
+            lua_pushinteger(L, (lua_Integer)ns[b]);
+            lua_setfield(L, -2, "ns");
         }
+        lua_rawseti(L, -2, ++n);
     }
+}
 
-    // Add padding for RFC Base32 format
-    if (tbl == RFC_ALPHABET && outlen % 8 != 0) {
-        // Calculate current length from the data we've written
-        static const char PAD[8] = "========";
-        size_t padding_len       = 8 - (outlen % 8);
-        // Add padding characters
-        luaL_addlstring(&b, PAD, padding_len);
+static void pushstats(lua_State *L, const stats_t *s)
+{
+    static const char *const ERRORS[] = {"length", "padding", "illegal"};
+    lua_Integer calls                 = 0;
+
+    for (int b = 0; b < STATS_NBUCKETS; b++) {
+        calls += (lua_Integer)s->calls[b];
     }
+    lua_createtable(L, 0, 6);
+    lua_pushinteger(L, calls);
+    lua_setfield(L, -2, "calls");
+    lua_pushinteger(L, (lua_Integer)s->inbytes);
+    lua_setfield(L, -2, "in_bytes");
+    lua_pushinteger(L, (lua_Integer)s->outbytes);
+    lua_setfield(L, -2, "out_bytes");
+    lua_createtable(L, 0, 3);
+    for (int i = 0; i < 3; i++) {
+        lua_pushinteger(L, (lua_Integer)s->errors[i]);
+        lua_setfield(L, -2, ERRORS[i]);
+    }
+    lua_setfield(L, -2, "errors");
+    pushbuckets(L, s->calls, s->ns);
+    lua_setfield(L, -2, "sizes");
+    pushbuckets(L, s->latency, NULL);
+    lua_setfield(L, -2, "latency");
+}
 
-    // Null terminate and push result
-    luaL_pushresult(&b);
+static int stats_lua(lua_State *L)
+{
+    static const char *const OPS[]     = {"encode", "decode"};
+    static const char *const FORMATS[] = {"rfc", "crockford"};
+    stats_t sum;
+
+    lua_createtable(L, 0, 3);
+    lua_pushboolean(L, __atomic_load_n(&StatsEnabled, __ATOMIC_RELAXED));
+    lua_setfield(L, -2, "enabled");
+    for (int op = 0; op < 2; op++) {
+        lua_createtable(L, 0, 2);
+        for (int fmt = 0; fmt < 2; fmt++) {
+            stats_sum(&sum, op, fmt);
+            pushstats(L, &sum);
+            lua_setfield(L, -2, FORMATS[fmt]);
+        }
+        lua_setfield(L, -2, OPS[op]);
+    }
     return 1;
 }
 
+static int stats_reset_lua(lua_State *L)
+{
+    uint64_t *v = (uint64_t *)Stats;
+
+    (void)L;
+    // the counters may be updated concurrently by other threads
+    for (size_t i = 0; i < sizeof(Stats) / sizeof(uint64_t); i++) {
+        __atomic_store_n(&v[i], 0, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+// C API published in the registry for other C modules
+static const lua_base32_capi_t CAPI = {
+    .version        = LUA_BASE32_CAPI_VERSION,
+    .encoded_len    = b32_encoded_len,
+    .decoded_maxlen = b32_decoded_maxlen,
+    .encode         = b32_encode,
+    .decode         = b32_decode,
+    .validate       = b32_validate,
+};
+
+/**
+ * @brief Create the metatable `tname` with the metamethods `mmethods`, and
+ * the methods `methods` in its __index table.
+ *
+ * @param L Lua state
+ * @param tname Name of the metatable
+ * @param mmethods Metamethods
+ * @param methods Methods
+ */
+static void createmt(lua_State *L, const char *tname, const luaL_Reg *mmethods,
+                     const luaL_Reg *methods)
+{
+    if (luaL_newmetatable(L, tname)) {
+        // Lua 5.1 and 5.2 do not set the name used by tostring_lua
+        lua_pushstring(L, tname);
+        lua_setfield(L, -2, "__name");
+        for (const luaL_Reg *ptr = mmethods; ptr->name; ptr++) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+        }
+        lua_newtable(L);
+        for (const luaL_Reg *ptr = methods; ptr->name; ptr++) {
+            lua_pushcfunction(L, ptr->func);
+            lua_setfield(L, -2, ptr->name);
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+}
+
 LUALIB_API int luaopen_base32(lua_State *L)
 {
     // Load errno library for error handling
     lua_errno_loadlib(L);
+    // Load the calibrated thresholds
+    load_tuning();
+    // Publish the C API
+    lua_pushlightuserdata(L, (void *)&CAPI);
+    lua_setfield(L, LUA_REGISTRYINDEX, LUA_BASE32_CAPI);
+    // Create the metatables
+    createmt(L, BASE32_FUTURE_MT, future_mmethods, future_methods);
+    createmt(L, BASE32_ENCODER_MT, encoder_mmethods, encoder_methods);
+    createmt(L, BASE32_DECODER_MT, decoder_mmethods, decoder_methods);
     // Export the base32 functions
-    lua_createtable(L, 0, 2);
-    lua_pushcfunction(L, encode_lua);
-    lua_setfield(L, -2, "encode");
-    lua_pushcfunction(L, decode_lua);
-    lua_setfield(L, -2, "decode");
+    lua_createtable(L, 0, 22);
+    // encode, decode, set_yield and set_slow_hook share the settings of this
+    // state
+    *(settings_t *)lua_newuserdata(L, sizeof(settings_t)) = (settings_t){0};
+    lua_pushvalue(L, -1);
+    lua_pushcclosure(L, encode_lua, 1);
+    lua_setfield(L, -3, "encode");
+    lua_pushvalue(L, -1);
+    lua_pushcclosure(L, decode_lua, 1);
+    lua_setfield(L, -3, "decode");
+    lua_pushvalue(L, -1);
+    lua_pushcclosure(L, set_yield_lua, 1);
+    lua_setfield(L, -3, "set_yield");
+    lua_pushcclosure(L, set_slow_hook_lua, 1);
+    lua_setfield(L, -2, "set_slow_hook");
+    lua_pushcfunction(L, encode_batch_lua);
+    lua_setfield(L, -2, "encode_batch");
+    lua_pushcfunction(L, decode_batch_lua);
+    lua_setfield(L, -2, "decode_batch");
+    lua_pushcfunction(L, encode_many_lua);
+    lua_setfield(L, -2, "encode_many");
+    lua_pushcfunction(L, decode_many_lua);
+    lua_setfield(L, -2, "decode_many");
+    lua_pushcfunction(L, encoder_lua);
+    lua_setfield(L, -2, "encoder");
+    lua_pushcfunction(L, decoder_lua);
+    lua_setfield(L, -2, "decoder");
+    lua_pushcfunction(L, encode_file_lua);
+    lua_setfield(L, -2, "encode_file");
+    lua_pushcfunction(L, decode_file_lua);
+    lua_setfield(L, -2, "decode_file");
+    lua_pushcfunction(L, encode_stream_lua);
+    lua_setfield(L, -2, "encode_stream");
+    lua_pushcfunction(L, decode_stream_lua);
+    lua_setfield(L, -2, "decode_stream");
+    lua_pushcfunction(L, encode_async_lua);
+    lua_setfield(L, -2, "encode_async");
+    lua_pushcfunction(L, decode_async_lua);
+    lua_setfield(L, -2, "decode_async");
+    lua_pushcfunction(L, set_threads_lua);
+    lua_setfield(L, -2, "set_threads");
+    lua_pushcfunction(L, set_tuning_lua);
+    lua_setfield(L, -2, "set_tuning");
+    lua_pushcfunction(L, calibrate_lua);
+    lua_setfield(L, -2, "calibrate");
+    lua_pushcfunction(L, set_stats_lua);
+    lua_setfield(L, -2, "set_stats");
+    lua_pushcfunction(L, stats_lua);
+    lua_setfield(L, -2, "stats");
+    lua_pushcfunction(L, stats_reset_lua);
+    lua_setfield(L, -2, "stats_reset");
     return 1;
 }
@@ -427,5 +427,1196 @@ test("test_comprehensive_round_trips", function()
     end
 end)
 
+test("test_set_threads", function()
+    -- default settings
+    local nthr, threshold = base32.set_threads()
+    assert_eq(nthr, 1, "default number of threads")
+    assert_eq(threshold, 4 * 1024 * 1024, "default parallel threshold")
+
+    -- serial results for comparison
+    local data = {}
+    for i = 1, 4099 do
+        data[i] = string.char((i * 7) % 256)
+    end
+    data = table.concat(data)
+    local rfc = base32.encode(data)
+    local crockford = base32.encode(data, "crockford")
+
+    -- force the parallel path for every input
+    local prev_nthr, prev_threshold = base32.set_threads(4, 0)
+    assert_eq(prev_nthr, nthr, "previous number of threads")
+    assert_eq(prev_threshold, threshold, "previous parallel threshold")
+    local ok, err = pcall(function()
+        for _, len in ipairs({
+            1,
+            5,
+            39,
+            40,
+            41,
+            4095,
+            4099,
+        }) do
+            local s = data:sub(1, len)
+            local enc = base32.encode(s)
+            assert_eq(enc, base32.encode(s, "rfc"), "parallel encode")
+            assert_eq(base32.decode(enc), s, "parallel RFC round trip")
+            enc = base32.encode(s, "crockford")
+            assert_eq(base32.decode(enc, "crockford"), s,
+                      "parallel Crockford round trip")
+        end
+        assert_eq(base32.encode(data), rfc, "parallel RFC encode")
+        assert_eq(base32.encode(data, "crockford"), crockford,
+                  "parallel Crockford encode")
+        assert_eq(base32.decode(rfc), data, "parallel RFC decode")
+        assert_eq(base32.decode(crockford, "crockford"), data,
+                  "parallel Crockford decode")
+
+        -- the first illegal character is reported across chunks
+        local bad = rfc:sub(1, 3000) .. "1" .. rfc:sub(3002, 6000) .. "8" ..
+                        rfc:sub(6002)
+        local res, e = base32.decode(bad)
+        assert(not res, "should reject illegal character")
+        assert(tostring(e):match("at position 3001"),
+               "error should report the first illegal character")
+    end)
+    base32.set_threads(nthr, threshold)
+    assert(ok, err)
+
+    -- invalid arguments
+    assert(not pcall(base32.set_threads, 0), "should reject 0 threads")
+    assert(not pcall(base32.set_threads, 1, -1),
+           "should reject negative threshold")
+end)
+
+test("test_tuning", function()
+    -- default settings
+    local tuning = base32.set_tuning()
+    assert_eq(tuning.encode_block, 64, "default encode block threshold")
+    assert_eq(tuning.decode_block, 64, "default decode block threshold")
+    assert_eq(tuning.parallel, 4 * 1024 * 1024, "default parallel threshold")
+    assert_eq(tuning.nontemporal, 32 * 1024 * 1024,
+              "default non-temporal threshold")
+
+    local data = {}
+    for i = 1, 1000 do
+        data[i] = string.char((i * 13) % 256)
+    end
+    data = table.concat(data)
+
+    -- the scalar kernel, the block kernel and the non-temporal stores
+    -- produce the same results, for tiny and larger inputs
+    local ok, err = pcall(function()
+        for _, fmt in ipairs({
+            "rfc",
+            "crockford",
+        }) do
+            for _, len in ipairs({
+                0,
+                1,
+                7,
+                8,
+                9,
+                13,
+                45,
+                63,
+                64,
+                65,
+                66,
+                1000,
+            }) do
+                local s = data:sub(1, len)
+                base32.set_tuning({
+                    encode_block = math.huge,
+                    decode_block = math.huge,
+                    nontemporal = math.huge,
+                })
+                local enc = base32.encode(s, fmt)
+                base32.set_tuning({
+                    encode_block = 0,
+                    decode_block = 0,
+                })
+                assert_eq(base32.encode(s, fmt), enc, "block encode")
+                assert_eq(base32.decode(enc, fmt), s, "block decode")
+                base32.set_tuning({
+                    nontemporal = 0,
+                })
+                assert_eq(base32.encode(s, fmt), enc, "non-temporal encode")
+            end
+        end
+        assert_eq(base32.decode(base32.encode(data)), data, "block round trip")
+        -- the chunks of the parallel path use the non-temporal stores too
+        local nthr, threshold = base32.set_threads(4, 0)
+        local enc = base32.encode(data)
+        base32.set_threads(nthr, threshold)
+        assert_eq(base32.decode(enc), data, "parallel non-temporal encode")
+
+        local hyphenated = base32.encode(data, "crockford"):gsub("(....)",
+                                                                 "%1-")
+        assert_eq(base32.decode(hyphenated, "crockford"), data,
+                  "block decode with hyphens")
+
+        -- the first illegal character is reported by both kernels
+        local bad = base32.encode(data):sub(1, 100) .. "1" ..
+                        base32.encode(data):sub(102)
+        for _, n in ipairs({
+            0,
+            math.huge,
+        }) do
+            base32.set_tuning({
+                decode_block = n,
+            })
+            local res, e = base32.decode(bad)
+            assert(not res, "should reject illegal character")
+            assert(tostring(e):match("at position 101"),
+                   "error should report the illegal character")
+        end
+    end)
+    local prev = base32.set_tuning(tuning)
+    assert(ok, err)
+    assert_eq(prev.encode_block, 0, "previous encode block threshold")
+    assert_eq(prev.decode_block, math.huge, "previous decode block threshold")
+    assert_eq(prev.nontemporal, 0, "previous non-temporal threshold")
+
+    -- calibration sets the thresholds and saves them
+    local path = os.tmpname()
+    local t = assert(base32.calibrate(path))
+    local cur = base32.set_tuning(tuning)
+    for _, k in ipairs({
+        "encode_block",
+        "decode_block",
+        "parallel",
+        "nontemporal",
+    }) do
+        assert(t[k] >= 0, k)
+        assert_eq(cur[k], t[k], "calibrated " .. k)
+    end
+    local f = assert(io.open(path))
+    local saved = f:read("*a")
+    f:close()
+    os.remove(path)
+    assert(saved:match("\nencode_block %d+\n"), "saved encode_block")
+    assert(saved:match("\ndecode_block %d+\n"), "saved decode_block")
+    assert(saved:match("\nparallel %d+\n"), "saved parallel")
+    assert(saved:match("\nnontemporal %d+\n"), "saved nontemporal")
+    local res, e = base32.calibrate("/nonexistent/base32-tuning")
+    assert(not res and e, "should report an unwritable path")
+    assert_eq(base32.set_tuning().parallel, tuning.parallel,
+              "thresholds are restored")
+
+    -- invalid arguments
+    assert(not pcall(base32.set_tuning, 1), "should reject non-table")
+    assert(not pcall(base32.set_tuning, {
+        encode_block = -1,
+    }), "should reject negative threshold")
+    assert(not pcall(base32.set_tuning, {
+        parallel = 1.5,
+    }), "should reject fractional threshold")
+end)
+
+test("test_stats", function()
+    -- disabled by default
+    assert_eq(base32.set_stats(), false, "disabled by default")
+    base32.stats_reset()
+    base32.encode("foobar")
+    assert_eq(base32.stats().encode.rfc.calls, 0, "not counted")
+
+    assert_eq(base32.set_stats(true), false, "previous setting")
+    local ok, err = pcall(function()
+        base32.stats_reset()
+        assert_eq(base32.encode("foobar"), "MZXW6YTBOI======", "encode")
+        assert_eq(base32.decode("MZXW6YQ="), "foob", "decode")
+        assert(not base32.decode("MZXW6YT"), "length error")
+        assert(not base32.decode("MZXW6Y=="), "padding error")
+        assert(not base32.decode("MZXW6YT!"), "illegal character")
+        base32.decode(base32.encode(string.rep("x", 1000), "crockford"),
+                      "crockford")
+
+        local st = base32.stats()
+        assert_eq(st.enabled, true, "enabled")
+        local enc = st.encode.rfc
+        assert_eq(enc.calls, 1, "encode calls")
+        assert_eq(enc.in_bytes, 6, "encode input bytes")
+        assert_eq(enc.out_bytes, 16, "encode output bytes")
+        assert_eq(#enc.sizes, 1, "one size bucket")
+        assert_eq(enc.sizes[1].min, 4, "size bucket min")
+        assert_eq(enc.sizes[1].max, 7, "size bucket max")
+        assert_eq(enc.sizes[1].calls, 1, "size bucket calls")
+        assert(enc.sizes[1].ns >= 0, "size bucket time")
+        local n = 0
+        for _, b in ipairs(enc.latency) do
+            n = n + b.calls
+        end
+        assert_eq(n, 1, "latency calls")
+
+        local dec = st.decode.rfc
+        assert_eq(dec.calls, 4, "decode calls")
+        assert_eq(dec.in_bytes, 31, "decode input bytes")
+        assert_eq(dec.out_bytes, 4, "decode output bytes")
+        assert_eq(dec.errors.length, 1, "length errors")
+        assert_eq(dec.errors.padding, 1, "padding errors")
+        assert_eq(dec.errors.illegal, 1, "illegal characters")
+        assert_eq(st.encode.crockford.calls, 1, "crockford encode calls")
+        assert_eq(st.decode.crockford.out_bytes, 1000, "crockford output")
+        assert_eq(st.decode.crockford.sizes[1].min, 1024,
+                  "crockford size bucket")
+
+        -- a yielding call is counted once
+        if _VERSION ~= "Lua 5.1" then
+            local prev = base32.set_yield(64)
+            local co = coroutine.wrap(function()
+                return base32.decode(base32.encode(string.rep("y", 500)))
+            end)
+            base32.stats_reset()
+            while co() == nil do
+            end
+            base32.set_yield(prev)
+            st = base32.stats()
+            assert_eq(st.decode.rfc.calls, 1, "yielding decode calls")
+            assert_eq(st.decode.rfc.out_bytes, 500, "yielding decode output")
+            assert_eq(st.encode.rfc.calls, 1, "yielding encode calls")
+        end
+
+        base32.stats_reset()
+        assert_eq(base32.stats().decode.rfc.calls, 0, "reset")
+    end)
+    base32.set_stats(false)
+    assert(ok, err)
+    assert(not pcall(base32.set_stats, 1), "should reject non-boolean")
+end)
+
+test("test_slow_hook", function()
+    local calls = {}
+    local function hook(op, format, inlen, ns)
+        calls[#calls + 1] = {
+            op = op,
+            format = format,
+            inlen = inlen,
+            ns = ns,
+        }
+        -- calls made by the hook are not passed to it
+        base32.encode("nested")
+    end
+
+    local prev_ns, prev_fn = base32.set_slow_hook(0, hook)
+    assert_eq(prev_ns, nil, "no previous threshold")
+    assert_eq(prev_fn, nil, "no previous hook")
+    local ok, err = pcall(function()
+        assert_eq(base32.encode("foobar"), "MZXW6YTBOI======", "encode")
+        assert(not base32.decode("MZXW6YT!"), "decode error")
+        assert_eq(base32.decode("", "crockford"), "", "empty decode")
+        assert_eq(#calls, 3, "every call is passed to the hook")
+        assert_eq(calls[1].op, "encode", "op")
+        assert_eq(calls[1].format, "rfc", "format")
+        assert_eq(calls[1].inlen, 6, "input length")
+        assert(math.type == nil or math.type(calls[1].ns) == "integer",
+               "elapsed time is an integer")
+        assert(calls[1].ns >= 0, "elapsed time")
+        assert_eq(calls[2].op, "decode", "decode op")
+        assert_eq(calls[3].format, "crockford", "decode format")
+
+        -- a yielding call is passed once
+        if _VERSION ~= "Lua 5.1" then
+            local prev = base32.set_yield(64)
+            local co = coroutine.wrap(function()
+                return base32.encode(string.rep("y", 500))
+            end)
+            calls = {}
+            while co() == nil do
+            end
+            base32.set_yield(prev)
+            assert_eq(#calls, 1, "yielding call")
+            assert_eq(calls[1].inlen, 500, "yielding call input length")
+        end
+
+        -- a hook that raises an error is removed, and the result is kept
+        base32.set_slow_hook(0, function()
+            error("hook error")
+        end)
+        assert_eq(base32.encode("foo"), "MZXW6===", "result of a hook error")
+        assert_eq(base32.set_slow_hook(), nil, "hook removed after an error")
+        base32.set_slow_hook(0, hook)
+
+        -- calls faster than the threshold are not passed
+        local ns, fn = base32.set_slow_hook(1e12, hook)
+        assert_eq(ns, 0, "previous threshold")
+        assert_eq(type(fn), "function", "previous hook")
+        calls = {}
+        base32.encode("foobar")
+        assert_eq(#calls, 0, "fast call")
+    end)
+    local ns, fn = base32.set_slow_hook()
+    assert(ok, err)
+    assert_eq(ns, 1e12, "previous threshold")
+    assert_eq(fn, hook, "previous hook")
+    assert_eq(base32.set_slow_hook(), nil, "removed")
+
+    assert(not pcall(base32.set_slow_hook, -1, hook),
+           "should reject negative threshold")
+    assert(not pcall(base32.set_slow_hook, 0, 1), "should reject non-function")
+end)
+
+test("test_batch", function()
+    local list = {
+        "",
+        "f",
+        "foobar",
+        string.rep("0123456789", 100),
+    }
+    -- mixed-size items, large enough in total to run on the worker threads
+    for i = 1, 2000 do
+        list[#list + 1] = string.rep(string.char(i % 256), i % 101)
+    end
+
+    for _, format in ipairs({
+        "rfc",
+        "crockford",
+    }) do
+        for _, nthr in ipairs({
+            1,
+            4,
+        }) do
+            local prev_nthr, prev_threshold = base32.set_threads(nthr)
+            local encoded = base32.encode_batch(list, format)
+            local decoded = base32.decode_batch(encoded, format)
+            base32.set_threads(prev_nthr, prev_threshold)
+            assert_eq(#encoded, #list, "encode_batch result length")
+            assert_eq(#decoded, #list, "decode_batch result length")
+            for i, s in ipairs(list) do
+                assert_eq(encoded[i], base32.encode(s, format),
+                          string.format("encode_batch item %d", i))
+                assert_eq(decoded[i], s,
+                          string.format("decode_batch item %d", i))
+            end
+        end
+    end
+
+    -- empty list
+    assert_eq(#base32.encode_batch({}), 0, "empty encode_batch")
+
+    -- the first failing item is reported
+    local res, err = base32.decode_batch({
+        "MZXW6YTB",
+        "MZXW6",
+        "MZXW6YT8",
+    })
+    assert(not res, "should fail")
+    assert(tostring(err):match("item #2: .*multiple of 8"),
+           "error should mention the failing item")
+    res, err = base32.decode_batch({
+        "CSQPYRK1E8",
+        "CSQPYRKUE8",
+    }, "crockford")
+    assert(not res, "should fail")
+    assert(tostring(err):match("item #2: Illegal character.*position 8"),
+           "error should mention the illegal character")
+
+    -- non-string item
+    local ok
+    ok, err = pcall(base32.encode_batch, {
+        "foo",
+        1,
+    })
+    assert(not ok, "should reject non-string item")
+    assert(err:match("string expected at index 2"),
+           "error should mention the index")
+end)
+
+test("test_many", function()
+    -- same-length inputs such as UUIDs and SHA-1 digests
+    for _, len in ipairs({
+        1,
+        5,
+        16,
+        20,
+        32,
+    }) do
+        local list = {}
+        for i = 1, 100 do
+            local s = {}
+            for j = 1, len do
+                s[j] = string.char((i * 31 + j * 7) % 256)
+            end
+            list[i] = table.concat(s)
+        end
+
+        for _, format in ipairs({
+            "rfc",
+            "crockford",
+        }) do
+            local encoded = base32.encode_many(list, format)
+            local decoded = base32.decode_many(encoded, format)
+            assert_eq(#encoded, #list, "encode_many result length")
+            assert_eq(#decoded, #list, "decode_many result length")
+            for i, s in ipairs(list) do
+                assert_eq(encoded[i], base32.encode(s, format),
+                          string.format("encode_many %d bytes item %d", len, i))
+                assert_eq(decoded[i], s,
+                          string.format("decode_many %d bytes item %d", len, i))
+            end
+        end
+    end
+
+    -- mixed lengths, hyphens and aliases fall back to the scalar kernel
+    local list = {}
+    for i = 1, 20 do
+        list[i] = i % 3 == 0 and "CS-QP-YRK1E8" or "csqpyrkie8"
+    end
+    for _, s in ipairs(base32.decode_many(list, "crockford")) do
+        assert_eq(s, "foobar", "decode_many crockford")
+    end
+
+    -- errors are reported as by decode_batch
+    list = {}
+    for i = 1, 20 do
+        list[i] = "MZXW6YTB"
+    end
+    list[11] = "MZXW6YT8"
+    local res, err = base32.decode_many(list)
+    assert(not res, "should fail")
+    assert(tostring(err):match("item #11: Illegal character.*position 8"),
+           "error should mention the failing item")
+end)
+
+test("test_async", function()
+    local data = string.rep("0123456789abcdefghijklmnopqrstuvwxyz", 100000)
+    for _, format in ipairs({
+        "rfc",
+        "crockford",
+    }) do
+        local encoded = base32.encode(data, format)
+        local f = base32.encode_async(data, format)
+        assert(tostring(f):match("^base32.future: "), "tostring")
+        assert(type(f:fd()) == "number" and f:fd() >= 0,
+               "fd should be a descriptor")
+        while not f:ready() do
+        end
+        assert_eq(f:result(), encoded, "encode_async " .. format)
+        -- result is cached
+        assert_eq(f:result(), encoded, "encode_async result again")
+
+        -- result() waits for the conversion
+        f = base32.decode_async(encoded, format)
+        assert_eq(f:result(), data, "decode_async " .. format)
+        assert(f:ready(), "should be ready after result")
+    end
+
+    assert_eq(base32.encode_async(""):result(), "", "empty input")
+    assert_eq(base32.decode_async("CS-QP-YRK1E8", "crockford"):result(),
+              "foobar", "hyphens")
+
+    -- errors
+    local f, err = base32.decode_async("MZXW6Y")
+    assert(not f, "should fail")
+    assert(tostring(err):match("multiple of 8"), "length error")
+    local res
+    res, err = base32.decode_async("MZXW6YT8"):result()
+    assert(not res, "should fail")
+    assert(tostring(err):match("Illegal character.*position 8"),
+           "illegal character error")
+
+    -- canceled conversions either fail or complete
+    f = base32.encode_async(string.rep(data, 8))
+    f:cancel()
+    res, err = f:result()
+    assert(res or tostring(err):match("canceled"), "cancel")
+end)
+
+test("test_async_fork", function()
+    -- fork() is called through the FFI, which is only available on LuaJIT
+    local ok, ffi = pcall(require, "ffi")
+    if not ok then
+        return
+    end
+    -- the test may be loaded more than once in the same state
+    pcall(ffi.cdef, [[
+int fork(void);
+int waitpid(int pid, int *status, int options);
+void _exit(int status);
+]])
+    local data = string.rep("0123456789abcdefghijklmnopqrstuvwxyz", 100000)
+    local encoded = base32.encode(data)
+    -- start the workers before forking
+    assert_eq(base32.encode_async(data):result(), encoded, "before fork")
+
+    local pid = ffi.C.fork()
+    assert(pid >= 0, "fork")
+    if pid == 0 then
+        -- the workers of the parent do not exist in the child, so the pool
+        -- must start its own
+        local done, res = pcall(function()
+            local f = base32.encode_async(data)
+            local deadline = os.time() + 10
+            while not f:ready() and os.time() < deadline do
+            end
+            return f:ready() and f:result() == encoded
+        end)
+        ffi.C._exit(done and res and 0 or 1)
+    end
+    local status = ffi.new("int[1]")
+    assert_eq(ffi.C.waitpid(pid, status, 0), pid, "waitpid")
+    assert_eq(status[0], 0, "future should complete in the child")
+end)
+
+test("test_set_yield", function()
+    local data = string.rep("0123456789abcdefghijklmnopqrstuvwxyz", 1000)
+    assert_eq(base32.set_yield(), 0, "yielding is disabled by default")
+    if _VERSION == "Lua 5.1" then
+        -- Lua 5.1 and LuaJIT cannot continue a C function after a yield
+        local ok, err = pcall(base32.set_yield, 1000)
+        assert(not ok and err:match("requires Lua 5.2"), "should raise")
+        assert_eq(base32.set_yield(0), 0, "disabling is accepted")
+        return
+    end
+    assert_eq(base32.set_yield(1000), 0, "previous setting")
+
+    local function run(fn, ...)
+        local co = coroutine.create(fn)
+        local nyield = 0
+        local ok, res, err = coroutine.resume(co, ...)
+        while coroutine.status(co) == "suspended" do
+            nyield = nyield + 1
+            ok, res, err = coroutine.resume(co, "ignored")
+        end
+        assert(ok, res)
+        return res, err, nyield
+    end
+
+    for _, format in ipairs({
+        "rfc",
+        "crockford",
+    }) do
+        local encoded = base32.encode(data, format)
+        local res, _, nyield = run(base32.encode, data, format)
+        assert_eq(res, encoded, "encode in coroutine " .. format)
+        assert_eq(nyield, 35, "encode yields")
+
+        res, _, nyield = run(base32.decode, encoded, format)
+        assert_eq(res, data, "decode in coroutine " .. format)
+        assert_eq(nyield, 57, "decode yields")
+    end
+
+    -- hyphens across slices
+    local hyphenated = base32.encode(data, "crockford"):gsub("....", "%0-")
+    assert_eq(run(base32.decode, hyphenated, "crockford"), data, "hyphens")
+
+    -- errors are the same as without yielding, including an illegal
+    -- character in a later slice
+    local illegal = base32.encode(data):sub(1, 4999) .. "!" ..
+                        base32.encode(data):sub(5001)
+    for _, s in ipairs({
+        base32.encode(data):sub(1, -2),
+        "MZXW6===" .. base32.encode(data):sub(9),
+        illegal,
+    }) do
+        local _, expected = base32.decode(s)
+        local res, err = run(base32.decode, s)
+        assert(not res, "should fail")
+        assert_eq(tostring(err):match("%[.+"),
+                  tostring(expected):match("%[.+"), "decode error")
+    end
+    local _, err = run(base32.decode, illegal)
+    assert(tostring(err):match("at position 5000"),
+           "error should report the position in a later slice")
+
+    -- the main thread never yields
+    assert_eq(base32.encode(data), base32.encode(data, "rfc"), "main thread")
+    assert_eq(base32.set_yield(0), 1000, "disable")
+end)
+
+test("test_encoder", function()
+    local data = {}
+    for i = 1, 1000 do
+        data[i] = string.char((i * 37) % 256)
+    end
+    data = table.concat(data)
+
+    for _, format in ipairs({
+        "rfc",
+        "crockford",
+    }) do
+        local enc = base32.encoder(format)
+        assert(tostring(enc):match("^base32.encoder: "), "tostring")
+        -- split into chunks of every size from 1 to 12 bytes
+        for size = 1, 12 do
+            local out = {}
+            local pos = 1
+            while pos <= #data do
+                out[#out + 1] = enc:update(data:sub(pos, pos + size - 1))
+                pos = pos + size
+            end
+            out[#out + 1] = enc:finish()
+            assert_eq(table.concat(out), base32.encode(data, format),
+                      string.format("%s chunks of %d bytes", format, size))
+        end
+
+        -- every tail length; finish() resets the encoder
+        for len = 0, 10 do
+            local s = data:sub(1, len)
+            assert_eq(enc:update(s) .. enc:finish(), base32.encode(s, format),
+                      string.format("%s tail of %d bytes", format, len))
+        end
+    end
+
+    local enc = base32.encoder()
+    assert_eq(enc:update("f"), "", "incomplete quantum")
+    enc:close()
+    local ok, err = pcall(enc.update, enc, "oo")
+    assert(not ok and err:match("closed"), "closed encoder")
+
+    if _VERSION == "Lua 5.4" then
+        -- to-be-closed variable
+        enc = assert(load([[
+            local enc <close> = (...).encoder()
+            enc:update("foo")
+            return enc
+        ]]))(base32)
+        assert(not pcall(enc.update, enc, ""), "closed at the end of scope")
+    end
+end)
+
+test("test_decoder", function()
+    local data = {}
+    for i = 1, 1000 do
+        data[i] = string.char((i * 37) % 256)
+    end
+    data = table.concat(data)
+
+    local function decode_chunks(dec, s, size)
+        local out = {}
+        for pos = 1, #s, size do
+            local res, err = dec:update(s:sub(pos, pos + size - 1))
+            if not res then
+                return nil, err
+            end
+            out[#out + 1] = res
+        end
+        local res, err = dec:finish()
+        if not res then
+            return nil, err
+        end
+        out[#out + 1] = res
+        return table.concat(out)
+    end
+
+    for _, format in ipairs({
+        "rfc",
+        "crockford",
+    }) do
+        local dec = base32.decoder(format)
+        assert(tostring(dec):match("^base32.decoder: "), "tostring")
+        for len = 995, 1000 do
+            local encoded = base32.encode(data:sub(1, len), format)
+            if format == "crockford" then
+                encoded = encoded:gsub("....", "%0-")
+            end
+            -- split into chunks of every size from 1 to 13 characters
+            for size = 1, 13 do
+                assert_eq(decode_chunks(dec, encoded, size), data:sub(1, len),
+                          string.format("%s length %d chunks of %d", format,
+                                        len, size))
+            end
+        end
+    end
+
+    -- padding split across chunks
+    local dec = base32.decoder()
+    assert_eq(dec:update("MZXW6="), "", "held back")
+    assert_eq(dec:update("=="), "", "padding")
+    assert_eq(dec:finish(), "foo", "padded quantum")
+
+    -- errors report positions in the whole stream
+    local encoded = base32.encode(data)
+    local s = encoded:sub(1, 999) .. "!" .. encoded:sub(1001)
+    local _, expected = base32.decode(s)
+    local res, err = decode_chunks(dec, s, 16)
+    assert(not res, "should fail")
+    assert(tostring(err):match("position 1000"), "absolute position")
+    assert_eq(tostring(err):match("%(.+"), tostring(expected):match("%(.+"),
+              "same error as decode")
+    for _, v in ipairs({
+        {
+            "MZXW6===MZXW6===",
+            "position 6",
+        },
+        {
+            "MZXW6==!",
+            "position 6",
+        },
+        {
+            "MZXW6YT",
+            "multiple of 8",
+        },
+        {
+            "MZX=====",
+            "padding length",
+        },
+    }) do
+        res, err = decode_chunks(dec, v[1], 3)
+        assert(not res, "should fail")
+        assert(tostring(err):match(v[2]), v[2])
+    end
+    -- the decoder is reset after an error
+    assert_eq(decode_chunks(dec, "MZXW6YQ=", 3), "foob", "reset")
+end)
+
+test("test_stream_state", function()
+    local data = string.rep("0123456789abcdefghijklmnopqrstuvwxyz", 10)
+
+    for _, format in ipairs({
+        "rfc",
+        "crockford",
+    }) do
+        -- restart an encoder at every offset
+        local encoded = base32.encode(data, format)
+        for cut = 0, 12 do
+            local enc = base32.encoder(format)
+            local head = enc:update(data:sub(1, cut))
+            local state, pos = enc:export()
+            assert_eq(pos, cut, "encoder position")
+            enc = assert(base32.encoder(nil, {
+                state = state,
+            }))
+            assert_eq(head .. enc:update(data:sub(cut + 1)) .. enc:finish(),
+                      encoded, string.format("%s encoder cut %d", format, cut))
+        end
+
+        -- restart a decoder at every offset, including inside the padding
+        encoded = base32.encode(data:sub(1, 13), format)
+        if format == "crockford" then
+            encoded = encoded:gsub("...", "%0-")
+        end
+        for cut = 0, #encoded do
+            local dec = base32.decoder(format)
+            local head = assert(dec:update(encoded:sub(1, cut)))
+            local state, pos = dec:export()
+            assert_eq(pos, cut, "decoder position")
+            dec = assert(base32.decoder(format, {
+                state = state,
+            }))
+            assert_eq(head .. assert(dec:update(encoded:sub(cut + 1))) ..
+                          assert(dec:finish()), data:sub(1, 13),
+                      string.format("%s decoder cut %d", format, cut))
+        end
+    end
+
+    -- errors after a restart keep their absolute position
+    local dec = base32.decoder()
+    dec:update("MZXW6=")
+    dec = base32.decoder(nil, {
+        state = dec:export(),
+    })
+    local res, err = dec:update("=A")
+    assert(not res and tostring(err):match("position 6"), "padding position")
+
+    -- malformed states and format mismatches
+    local state = base32.decoder("crockford"):export()
+    -- an encoder position that disagrees with the buffered bytes
+    local enc = base32.encoder("crockford")
+    enc:update("ab")
+    local estate = enc:export()
+    estate = estate:sub(1, -2) .. string.char(estate:byte(-1) + 1)
+    -- a padded RFC 4648 state relabeled as a Crockford state
+    dec = base32.decoder("rfc")
+    dec:update("MZXW6=")
+    local dstate = dec:export()
+    dstate = dstate:sub(1, 2) .. string.char(1) .. dstate:sub(4)
+    for _, v in ipairs({
+        {
+            base32.decoder,
+            "crockford",
+            "",
+        },
+        {
+            base32.decoder,
+            "crockford",
+            state .. "x",
+        },
+        {
+            base32.encoder,
+            "crockford",
+            state,
+        },
+        {
+            base32.decoder,
+            "rfc",
+            state,
+        },
+        {
+            base32.encoder,
+            "crockford",
+            estate,
+        },
+        {
+            base32.decoder,
+            "crockford",
+            dstate,
+        },
+    }) do
+        res, err = v[1](v[2], {
+            state = v[3],
+        })
+        assert(not res and tostring(err):match("state"), "malformed state")
+    end
+end)
+
+test("test_file", function()
+    local function readfile(path)
+        local f = assert(io.open(path, "rb"))
+        local s = f:read("*a")
+        f:close()
+        return s
+    end
+    local function writefile(path, s)
+        local f = assert(io.open(path, "wb"))
+        f:write(s)
+        f:close()
+    end
+
+    local data = {}
+    for i = 1, 100000 do
+        data[i] = string.char((i * 131) % 256)
+    end
+    data = table.concat(data)
+    local inpath = os.tmpname()
+    local outpath = os.tmpname()
+
+    -- a large input spans several blocks of the pipeline
+    local large = string.rep(data, 20)
+
+    for _, opts in ipairs({
+        {},
+        {
+            io = "uring",
+        },
+        {
+            io = "pread",
+        },
+    }) do
+        local mode = opts.io or "mmap"
+        for _, nthr in ipairs({
+            1,
+            4,
+        }) do
+            base32.set_threads(nthr, 1024)
+            for _, format in ipairs({
+                "rfc",
+                "crockford",
+            }) do
+                for _, s in ipairs({
+                    "",
+                    "f",
+                    data,
+                    large,
+                }) do
+                    local encoded = base32.encode(s, format)
+                    writefile(inpath, s)
+                    assert_eq(base32.encode_file(inpath, outpath, format, opts),
+                              #encoded, "encode_file result " .. mode)
+                    assert_eq(readfile(outpath), encoded,
+                              "encode_file " .. format .. " " .. mode)
+                    assert_eq(base32.decode_file(outpath, inpath, format, opts),
+                              #s, "decode_file result " .. mode)
+                    assert_eq(readfile(inpath), s,
+                              "decode_file " .. format .. " " .. mode)
+                end
+            end
+
+            -- hyphens are not counted in the output size
+            writefile(inpath,
+                      (base32.encode(data, "crockford"):gsub("...", "%0-")))
+            assert_eq(base32.decode_file(inpath, outpath, "crockford", opts),
+                      #data, "decode_file hyphens " .. mode)
+            assert_eq(readfile(outpath), data, "decode_file hyphens " .. mode)
+        end
+        base32.set_threads(1, 4194304)
+
+        -- errors
+        local encoded = base32.encode(large)
+        writefile(inpath, encoded:sub(1, 999999) .. "!" ..
+                      encoded:sub(1000001))
+        writefile(outpath, "precious")
+        local res, err = base32.decode_file(inpath, outpath, nil, opts)
+        assert(not res, "should fail")
+        assert(tostring(err):match("'!' %(0x21%) at position 1000000"),
+               "illegal character " .. mode)
+        assert_eq(readfile(outpath), "", "output is left empty " .. mode)
+        writefile(inpath, encoded:sub(2))
+        writefile(outpath, "precious")
+        res, err = base32.decode_file(inpath, outpath, nil, opts)
+        assert(not res and tostring(err):match("multiple of 8"),
+               "length " .. mode)
+        assert_eq(readfile(outpath), "", "output is left empty " .. mode)
+        -- padding at the end of a 640 KiB block of the pipeline
+        base32.set_threads(4, 1024)
+        writefile(inpath, base32.encode(string.rep("x", 409596)) ..
+                      base32.encode("foo"))
+        writefile(outpath, "precious")
+        res, err = base32.decode_file(inpath, outpath, nil, opts)
+        assert(not res, "padding in the middle should fail " .. mode)
+        assert(mode == "mmap" or tostring(err):match("at position 655355"),
+               "padding in the middle " .. mode)
+        assert_eq(readfile(outpath), "", "output is left empty " .. mode)
+        base32.set_threads(1, 4194304)
+
+        -- the output must not be the input, by the same path or a hard link
+        local linkpath = inpath .. ".link"
+        os.remove(linkpath)
+        os.execute(string.format("ln '%s' '%s'", inpath, linkpath))
+        for _, path in ipairs({
+            inpath,
+            linkpath,
+        }) do
+            local f = io.open(path, "rb")
+            if f then
+                f:close()
+                writefile(inpath, encoded)
+                res, err = base32.encode_file(inpath, path, nil, opts)
+                assert(not res and tostring(err):match("same file"),
+                       "encode into the input " .. mode)
+                res, err = base32.decode_file(inpath, path, nil, opts)
+                assert(not res and tostring(err):match("same file"),
+                       "decode into the input " .. mode)
+                assert(readfile(inpath) == encoded,
+                       "input is left unchanged " .. mode)
+            end
+        end
+        os.remove(linkpath)
+
+        os.remove(inpath)
+        res, err = base32.encode_file(inpath, outpath, nil, opts)
+        assert(not res and err, "missing input " .. mode)
+    end
+    os.remove(outpath)
+
+    assert(not pcall(base32.encode_file, inpath, outpath, nil, {
+        io = "aio",
+    }), "unknown io")
+
+    -- an unknown format leaves the output of the C functions alone; the
+    -- binding rejects it before, so they are called through the FFI, which
+    -- is only available on LuaJIT
+    local ok, ffi = pcall(require, "ffi")
+    if not ok then
+        return
+    end
+    local C = require("base32.ffi").C
+    -- the test may be loaded more than once in the same state
+    pcall(ffi.cdef, [[
+ptrdiff_t b32_encode_file(const char *inpath, const char *outpath, int fmt,
+                          int flags);
+ptrdiff_t b32_decode_file(const char *inpath, const char *outpath, int fmt,
+                          int flags, size_t *errpos, int *errc);
+]])
+    writefile(inpath, base32.encode(data))
+    for _, flags in ipairs({
+        0,
+        2, -- B32_PIPELINE
+    }) do
+        writefile(outpath, "precious data")
+        assert_eq(tonumber(C.b32_encode_file(inpath, outpath, 7, flags)), -1,
+                  "encode_file EINVAL")
+        assert_eq(tonumber(C.b32_decode_file(inpath, outpath, 7, flags, nil,
+                                             nil)), -1, "decode_file EINVAL")
+        assert_eq(readfile(outpath), "precious data",
+                  "output is left unchanged with an unknown format")
+    end
+    os.remove(inpath)
+    os.remove(outpath)
+end)
+
+test("test_stream", function()
+    local data = {}
+    for i = 1, 100000 do
+        data[i] = string.char((i * 131) % 256)
+    end
+    data = table.concat(data)
+
+    local function convert(fn, s, ...)
+        local inf = io.tmpfile()
+        local outf = io.tmpfile()
+        inf:write(s)
+        inf:seek("set")
+        local n, err = fn(inf, outf, ...)
+        outf:seek("set")
+        local res = outf:read("*a")
+        inf:close()
+        outf:close()
+        return n, err, res
+    end
+
+    for _, nthr in ipairs({
+        1,
+        4,
+    }) do
+        base32.set_threads(nthr)
+        for _, format in ipairs({
+            "rfc",
+            "crockford",
+        }) do
+            for _, bufsize in ipairs({
+                1,
+                41,
+                1000,
+            }) do
+                local encoded = base32.encode(data, format)
+                local n, err, res = convert(base32.encode_stream, data, format,
+                                            bufsize)
+                assert(n, err)
+                assert_eq(n, #encoded, "encode_stream result")
+                assert_eq(res, encoded, "encode_stream " .. format)
+
+                n, err, res = convert(base32.decode_stream, encoded, format,
+                                      bufsize)
+                assert(n, err)
+                assert_eq(n, #data, "decode_stream result")
+                assert_eq(res, data, "decode_stream " .. format)
+            end
+            local n, err, res = convert(base32.encode_stream, "", format)
+            assert_eq(n, 0, "empty stream")
+            assert_eq(res, "", "empty stream")
+        end
+    end
+    base32.set_threads(1)
+
+    -- errors report positions in the whole stream
+    local encoded = base32.encode(data)
+    local n, err = convert(base32.decode_stream,
+                           encoded:sub(1, 99999) .. "!" .. encoded:sub(100001))
+    assert(not n, "should fail")
+    assert(tostring(err):match("'!' %(0x21%) at position 100000"),
+           "illegal character")
+    n, err = convert(base32.decode_stream, encoded:sub(2))
+    assert(not n and tostring(err):match("multiple of 8"), "length")
+
+    -- the buffer size is limited to 1 GiB
+    for _, fn in ipairs({
+        base32.encode_stream,
+        base32.decode_stream,
+    }) do
+        local ok, msg = pcall(convert, fn, "", "rfc", 1024 * 1024 * 1024 + 1)
+        assert(not ok and msg:match("1 GiB"), "buffer size too large")
+        ok, msg = pcall(convert, fn, "", "rfc", -1)
+        assert(not ok and msg:match("1 GiB"), "negative buffer size")
+    end
+
+    local f = io.tmpfile()
+    f:close()
+    assert(not pcall(base32.encode_stream, f, io.stdout), "closed file")
+end)
+
+test("test_capi", function()
+    -- The C API for other C modules is published in the registry
+    local capi = debug.getregistry()["base32.capi"]
+    assert_eq(type(capi), "userdata", "C API should be published")
+
+    -- Read it as a C module does through include/lua_base32.h; the FFI is
+    -- only available on LuaJIT
+    local ok, ffi = pcall(require, "ffi")
+    if not ok then
+        return
+    end
+    local f = assert(io.open("include/lua_base32.h"))
+    local version = tonumber(f:read("*a"):match(
+                                 "#define LUA_BASE32_CAPI_VERSION%s+(%d+)"))
+    f:close()
+    -- the test may be loaded more than once in the same state
+    pcall(ffi.cdef, [[
+typedef struct {
+    int version;
+    size_t (*encoded_len)(size_t srclen, int fmt);
+    size_t (*decoded_maxlen)(size_t srclen);
+    ptrdiff_t (*encode)(char *dst, size_t dstlen, const void *src,
+                        size_t srclen, int fmt, int flags);
+    ptrdiff_t (*decode)(void *dst, size_t dstlen, const char *src,
+                        size_t srclen, int fmt, int flags, size_t *errpos);
+    ptrdiff_t (*validate)(const char *src, size_t srclen, int fmt,
+                          size_t *errpos);
+} lua_base32_capi_t;
+]])
+    local api = ffi.cast("const lua_base32_capi_t *", capi)
+    assert_eq(api.version, version, "C API version")
+    for _, fn in ipairs({
+        "encoded_len",
+        "decoded_maxlen",
+        "encode",
+        "decode",
+        "validate",
+    }) do
+        assert(api[fn] ~= nil, fn .. " should be set")
+    end
+
+    -- round trip a vector of RFC 4648 through the function pointers
+    local src = "foobar"
+    local n = tonumber(api.encoded_len(#src, 0))
+    assert_eq(n, 16, "C API encoded_len")
+    local enc = ffi.new("char[?]", n)
+    assert_eq(tonumber(api.encode(enc, n, src, #src, 0, 0)), n,
+              "C API encode length")
+    assert_eq(ffi.string(enc, n), "MZXW6YTBOI======", "C API encode")
+    assert_eq(tonumber(api.validate(enc, n, 0, nil)), #src, "C API validate")
+    local m = tonumber(api.decoded_maxlen(n))
+    assert(m >= #src, "C API decoded_maxlen")
+    local dec = ffi.new("char[?]", m)
+    assert_eq(tonumber(api.decode(dec, m, enc, n, 0, 0, nil)), #src,
+              "C API decode length")
+    assert_eq(ffi.string(dec, #src), src, "C API decode")
+
+    -- errors are reported with the position of the illegal character
+    local errpos = ffi.new("size_t[1]")
+    assert_eq(tonumber(api.validate("MZXW6!AAMZXW6===", 16, 0, errpos)), -5,
+              "C API validate illegal")
+    assert_eq(tonumber(errpos[0]), 5, "C API errpos")
+end)
+
+test("test_ffi", function()
+    -- The FFI binding is only available on LuaJIT
+    local ok, ffi = pcall(require, "ffi")
+    if not ok then
+        return
+    end
+    local b32ffi = require("base32.ffi")
+
+    -- encode into a cdata buffer
+    local src = "foobar"
+    local n = b32ffi.encoded_len(#src)
+    local buf = ffi.new("char[?]", n)
+    assert_eq(b32ffi.encode(buf, n, src, #src), n, "ffi encode length")
+    assert_eq(ffi.string(buf, n), base32.encode(src), "ffi encode")
+
+    n = b32ffi.encoded_len(#src, b32ffi.CROCKFORD)
+    buf = ffi.new("char[?]", n)
+    assert_eq(b32ffi.encode(buf, n, src, #src, b32ffi.CROCKFORD), n,
+              "ffi crockford encode length")
+    assert_eq(ffi.string(buf, n), "CSQPYRK1E8", "ffi crockford encode")
+
+    -- too small output buffer
+    assert_eq(b32ffi.encode(buf, 1, src, #src), b32ffi.ENOBUFS,
+              "ffi encode ENOBUFS")
+
+    -- decode into a cdata buffer
+    local enc = "MZXW6YTBOI======"
+    local out = ffi.new("uint8_t[?]", b32ffi.decoded_maxlen(#enc))
+    n = b32ffi.decode(out, b32ffi.decoded_maxlen(#enc), enc, #enc)
+    assert_eq(ffi.string(out, n), "foobar", "ffi decode")
+
+    -- decode errors
+    local pos = ffi.new("size_t[1]")
+    assert_eq(b32ffi.decode(out, 16, "MZXW6YT", 7), b32ffi.ELENGTH,
+              "ffi decode ELENGTH")
+    assert_eq(b32ffi.decode(out, 16, "MZXW6Y==", 8), b32ffi.EPADDING,
+              "ffi decode EPADDING")
+    assert_eq(b32ffi.decode(out, 16, "MZXW6YT8", 8, b32ffi.RFC, pos),
+              b32ffi.EILSEQ, "ffi decode EILSEQ")
+    assert_eq(tonumber(pos[0]), 7, "ffi decode error position")
+
+    -- validate
+    assert_eq(b32ffi.validate(enc, #enc), 6, "ffi validate")
+    assert_eq(b32ffi.validate("CS-QP-YRK1E8", 12, b32ffi.CROCKFORD), 6,
+              "ffi validate crockford")
+    assert_eq(b32ffi.validate("CSQPYRKUE8", 10, b32ffi.CROCKFORD, pos),
+              b32ffi.EILSEQ, "ffi validate EILSEQ")
+    assert_eq(tonumber(pos[0]), 7, "ffi validate error position")
+end)
+
 -- Run all tests
 run_tests()
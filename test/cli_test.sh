@@ -0,0 +1,146 @@
+#!/bin/sh
+#
+# Tests of the command-line tool; run by make test-cli. If the coreutils
+# base32 command is installed, the outputs are also compared with it.
+#
+set -u
+
+CLI=${CLI:-./base32}
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+NPASS=0
+NFAIL=0
+
+# check NAME EXPECTED COMMAND...: the output of COMMAND must be EXPECTED
+check() {
+    name=$1
+    expected=$2
+    shift 2
+    if actual=$("$@" 2>/dev/null) && [ "$actual" = "$expected" ]; then
+        NPASS=$((NPASS + 1))
+    else
+        NFAIL=$((NFAIL + 1))
+        echo "FAIL: $name: expected '$expected', got '$actual'"
+    fi
+}
+
+# fails NAME COMMAND...: COMMAND must exit with a non-zero status
+fails() {
+    name=$1
+    shift
+    if "$@" >/dev/null 2>&1; then
+        NFAIL=$((NFAIL + 1))
+        echo "FAIL: $name: succeeded"
+    else
+        NPASS=$((NPASS + 1))
+    fi
+}
+
+encode() {
+    input=$1
+    shift
+    printf '%s' "$input" | "$CLI" "$@"
+}
+
+decode() {
+    input=$1
+    shift
+    printf "$input" | "$CLI" -d "$@"
+}
+
+check "encode" "MZXW6YTBOI======" encode "foobar"
+check "encode empty" "" encode ""
+check "decode" "foobar" decode 'MZXW6YTBOI======\n'
+check "decode wrapped" "foobar" decode 'MZXW\n6YTB\nOI======\n'
+# concatenated encoded files are decoded at once, as with coreutils
+check "decode concatenated" "foofoo" decode 'MZXW6===\nMZXW6===\n'
+check "decode concatenated unpadded" "foofoob" decode 'MZXW6===MZXW6YQ='
+fails "decode after padding" decode 'MZXW6===MZX\n'
+fails "decode bad padding" decode 'MZXW6=\n'
+fails "decode illegal character" decode 'MZXW6!==\n'
+# lowercase letters are not in the RFC 4648 alphabet of coreutils
+fails "decode lowercase" decode 'MZXW6YTBoi======\n'
+check "decode lowercase ignoring case" "foobar" decode 'mzxw6ytboi======\n' \
+    --ignore-case
+check "decode lowercase ignoring garbage" "foo" decode 'MZxyXW6===\n' -i
+check "decode lowercase crockford" "foobar" decode 'csqpyrk1e8\n' \
+    --format=crockford
+
+# round trip across the 2.5 MiB blocks of the tool
+head -c 3000000 /dev/urandom > "$TMPDIR/in"
+for args in "" "--threads=4" "--format=crockford" "-w 0"; do
+    # shellcheck disable=SC2086
+    "$CLI" $args "$TMPDIR/in" > "$TMPDIR/enc" &&
+        "$CLI" -d $args "$TMPDIR/enc" > "$TMPDIR/out"
+    if cmp -s "$TMPDIR/in" "$TMPDIR/out"; then
+        NPASS=$((NPASS + 1))
+    else
+        NFAIL=$((NFAIL + 1))
+        echo "FAIL: round trip $args"
+    fi
+done
+
+# a padded string that ends across the first 2.5 MiB block, then another
+head -c 1638397 "$TMPDIR/in" > "$TMPDIR/in2"
+for args in "-w 0" "--threads=4"; do
+    # shellcheck disable=SC2086
+    ("$CLI" $args "$TMPDIR/in2"; printf 'foo' | "$CLI") |
+        "$CLI" -d $args > "$TMPDIR/out"
+    (cat "$TMPDIR/in2"; printf 'foo') > "$TMPDIR/in3"
+    if cmp -s "$TMPDIR/in3" "$TMPDIR/out"; then
+        NPASS=$((NPASS + 1))
+    else
+        NFAIL=$((NFAIL + 1))
+        echo "FAIL: concatenated round trip $args"
+    fi
+done
+
+# the wrapped lines of a full block are decoded by the worker threads, which
+# are started on the first parallel call and then stay
+if [ -d /proc/self/task ]; then
+    "$CLI" "$TMPDIR/in" > "$TMPDIR/enc"
+    mkfifo "$TMPDIR/fifo"
+    "$CLI" -d --threads=4 < "$TMPDIR/fifo" > "$TMPDIR/out" &
+    pid=$!
+    exec 3> "$TMPDIR/fifo"
+    # more than a block, but no end of file yet
+    head -c 3000000 "$TMPDIR/enc" >&3
+    nthr=1
+    for i in 1 2 3 4 5 6 7 8 9 10; do
+        nthr=$(ls "/proc/$pid/task" 2>/dev/null | wc -l)
+        [ "$nthr" -gt 1 ] && break
+        sleep 1
+    done
+    tail -c +3000001 "$TMPDIR/enc" >&3
+    exec 3>&-
+    if wait "$pid" && [ "$nthr" -gt 1 ] &&
+        cmp -s "$TMPDIR/in" "$TMPDIR/out"; then
+        NPASS=$((NPASS + 1))
+    else
+        NFAIL=$((NFAIL + 1))
+        echo "FAIL: decode wrapped input with threads ($nthr threads)"
+    fi
+fi
+
+if command -v base32 >/dev/null 2>&1 &&
+    base32 --version 2>/dev/null | grep -q coreutils; then
+    (cat "$TMPDIR/in"; printf 'foo') > "$TMPDIR/in2"
+    for args in "" "-w 0" "-w 7"; do
+        # shellcheck disable=SC2086
+        base32 $args "$TMPDIR/in2" > "$TMPDIR/want"
+        "$CLI" $args "$TMPDIR/in2" > "$TMPDIR/got"
+        (base32 "$TMPDIR/in"; base32 "$TMPDIR/in2") |
+            "$CLI" -d > "$TMPDIR/out"
+        (cat "$TMPDIR/in" "$TMPDIR/in2") > "$TMPDIR/in3"
+        if cmp -s "$TMPDIR/want" "$TMPDIR/got" &&
+            cmp -s "$TMPDIR/in3" "$TMPDIR/out"; then
+            NPASS=$((NPASS + 1))
+        else
+            NFAIL=$((NFAIL + 1))
+            echo "FAIL: coreutils $args"
+        fi
+    done
+fi
+
+echo "Passed $NPASS, Failed $NFAIL"
+[ "$NFAIL" -eq 0 ]